@@ -1,12 +1,17 @@
 #pragma once
 #include <cassert>
 #include <string>
+#include <string_view>
+#include <iterator>
+#include <vector>
 
 namespace slurp
 {
+	// The characters of a token in the source.
+	// The row and column of a token are found from its offset with a line_index.
 	struct TokenData
 	{
-		unsigned offset, length, row, column;
+		unsigned offset, length;
 	};
 
 	/*
@@ -42,44 +47,80 @@ namespace slurp
 		n: Node
 
 		The layout of a token (without text content) is as follows:
-		Node (8 bytes)
+		0: TokenData
+		n: Node (8 bytes)
+
+		A Stack with reference_text stores every token without its text,
+		and the text is found in the source from the offset and length in the TokenData.
 
 		This scheme makes it very efficient and an LR parser to enerate the AST as the parser
 		is effectively writing to the end of a vector<char> at all times.
+
+		A node can also have a child table (see stack_options), which is the offset from the node
+		to each of its children in order, between the last child and the node:
+
+		Child 0
+		...
+		Child n
+		Offsets of children 0 to n (4 bytes each)
+		Node
+
+		so that operator[] is constant time. The table is marked by the top bit of numberOfChildren,
+		and a tree without tables has the same layout as before.
 	*/
+	class child_range;
+
 	class Node
 	{
 	private:
 		friend class Stack;
+		friend class compact_tree;
 
 		unsigned length; // The total length of this node in bytes
 
 		unsigned short numberOfChildren;
+
+		static const unsigned short child_table_flag = 0x8000;
 	public:
 		typedef unsigned size_type;
 
+		// The maximum number of children of a node.
+		static const unsigned short max_children = child_table_flag - 1;
+
 		Node(short kind, unsigned short children, size_type length) :
-			length(length), Kind(kind), numberOfChildren(children)
+			length(length), numberOfChildren(children), Kind(kind)
 		{
 		}
 
-		unsigned short size() const { return numberOfChildren; }
+		unsigned short size() const { return numberOfChildren & ~child_table_flag; }
+
+		// The number of bytes of the subtree in the Stack, which ends at this node.
+		size_type Length() const { return length; }
 
 		bool operator==(int kind) const
 		{
 			return Kind == kind;
 		}
 
+		// Whether the node has a child table, making operator[] constant time.
+		bool HasChildTable() const { return (numberOfChildren & child_table_flag) != 0; }
+
 		const Node& operator[](unsigned short index) const
 		{
-			assert(index < numberOfChildren);
+			assert(index < size());
+
+			if (HasChildTable())
+				return *(const Node*)((const char*)this - ChildTable()[index]);
 
 			const Node* c = FirstChild();
-			for (int i = index+1; i < numberOfChildren; ++i)
+			for (int i = index+1; i < size(); ++i)
 				c = c->NextChild();
 			return *c;
 		}
 
+		// The children in order, which takes linear time in the number of children.
+		child_range children() const;
+
 		short Kind;
 
 		const Node* NextChild() const
@@ -92,14 +133,15 @@ namespace slurp
 			return (Node*)((char*)this - length);
 		}
 
+		// The child before this node, which is the last child.
 		const Node* FirstChild() const
 		{
-			return this - 1;
+			return (const Node*)((const char*)this - TableSize()) - 1;
 		}
 
 		Node* FirstChild()
 		{
-			return this - 1;
+			return (Node*)((char*)this - TableSize()) - 1;
 		}
 
 		bool IsToken() const { return numberOfChildren == 0; }
@@ -111,22 +153,135 @@ namespace slurp
 			return (TokenData*)data();
 		}
 
-		typedef unsigned size_type;
-
 		//size_type TextLength() const { return IsToken() ? length - sizeof(Node) - sizeof(TokenData) -1 : 0; }
 
 		//const char* Text() const { return IsToken() ? (const char*)(GetToken() + 1) : ""; }
 
-		const wchar_t* WText() const { return IsToken() ? (const wchar_t*)(GetToken() + 1) : L""; }
+		// Whether the text of the token was copied into the tree (see Stack).
+		bool HasText() const { return IsToken() && length > sizeof(Node) + sizeof(TokenData); }
 
-		size_type WTextLength() const { return IsToken() ? (length - sizeof(Node) - sizeof(TokenData))/sizeof(wchar_t) - 1 : 0; }
+		const wchar_t* WText() const { return HasText() ? (const wchar_t*)(GetToken() + 1) : L""; }
+
+		size_type WTextLength() const { return HasText() ? (length - sizeof(Node) - sizeof(TokenData))/sizeof(wchar_t) - 1 : 0; }
+
+		// The copied text of the token, without allocating a string.
+		std::wstring_view WTextView() const { return std::wstring_view(WText(), WTextLength()); }
 
 		std::wstring Str() const {
 			return std::wstring(WText());
 		}
 
+		// The text of the token in the source that was parsed, for example
+		// std::string_view from a const char* or std::u32string_view from a const char32_t*.
+		// This uses the offset and length of the token, so works whether or not the text was copied,
+		// provided that the tokenizer sets the offset, as dfa_tokenizer does.
+		template<typename Ch>
+		std::basic_string_view<Ch> Text(const Ch* source) const
+		{
+			return IsToken() ? std::basic_string_view<Ch>(source + GetToken()->offset, GetToken()->length) : std::basic_string_view<Ch>();
+		}
+
 	private:
 		const void* data() const { return (const char*)(this) - length + sizeof(Node); }
+
+		size_type TableSize() const { return HasChildTable() ? size() * sizeof(unsigned) : 0; }
+
+		const unsigned* ChildTable() const { return (const unsigned*)this - size(); }
+	};
+
+	/*
+		The children of a node in order, as a forward range:
+
+			for (const Node& child : node.children())
+				...
+
+		Without a child table, the children are found once when the range is constructed,
+		by walking back from the last child.
+	*/
+	class child_range
+	{
+	public:
+		explicit child_range(const Node& parent) : parent(parent), list(nullptr)
+		{
+			if (!parent.HasChildTable() && !parent.IsToken())
+			{
+				const Node** out = fixed;
+				if (parent.size() > fixed_size)
+				{
+					more.resize(parent.size());
+					out = more.data();
+				}
+
+				const Node* c = parent.FirstChild();
+				for (int i = parent.size() - 1; i >= 0; --i, c = c->NextChild())
+					out[i] = c;
+				list = out;
+			}
+		}
+
+		// The range refers to itself, so cannot be copied.
+		child_range(const child_range&) = delete;
+		child_range& operator=(const child_range&) = delete;
+
+		unsigned short size() const { return parent.size(); }
+
+		const Node& operator[](unsigned short index) const
+		{
+			assert(index < size());
+			return list ? *list[index] : parent[index];
+		}
+
+		class iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef Node value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const Node* pointer;
+			typedef const Node& reference;
+
+			iterator(const child_range& range, unsigned short index) : range(&range), index(index) {}
+
+			const Node& operator*() const { return (*range)[index]; }
+			const Node* operator->() const { return &(*range)[index]; }
+
+			iterator& operator++()
+			{
+				++index;
+				return *this;
+			}
+
+			iterator operator++(int)
+			{
+				iterator result = *this;
+				++index;
+				return result;
+			}
+
+			bool operator==(const iterator& other) const { return index == other.index; }
+			bool operator!=(const iterator& other) const { return index != other.index; }
+
+		private:
+			const child_range* range;
+			unsigned short index;
+		};
+
+		iterator begin() const { return iterator(*this, 0); }
+		iterator end() const { return iterator(*this, size()); }
+
+	private:
+		const Node& parent;
+
+		// The children of a node without a child table
+		static const int fixed_size = 8;
+		const Node* fixed[fixed_size];
+		std::vector<const Node*> more;
+		const Node* const* list;
 	};
 
+	inline child_range Node::children() const
+	{
+		return child_range(*this);
+	}
+
 }
\ No newline at end of file
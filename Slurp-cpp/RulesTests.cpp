@@ -103,6 +103,8 @@ namespace ExprTests
 	static_assert(ts_contains<tok_int, Expr_reachable>::value, "");
 	static_assert(!ts_contains<Expr::rule, Expr_reachable>::value, "");
 	static_assert(ts_size<Expr_reachable>::value == 4, "");
+	static_assert(ts_size<reachable_symbols<Expr, typeset<eof>>::type>::value == 5, "");
+	static_assert(ts_size<reachable_terminals<Expr>::type>::value == 3, "");
 
 	typedef parser_construction<Expr> parser1;
 	static_assert(ts_contains<Expr, parser1::symbols>::value, "");
@@ -120,8 +122,25 @@ namespace ExprTests
 	static_assert(!is_empty<Expr>::value, "");
 	typedef first<Expr>::type e_first;
 
-	// Currently fails because first doesn't handle recursive rules (bug)
 	static_assert(ts_size<e_first>::value == 2, "");
+
+	// The flattened grammar
+	typedef parser1::grammar g1;
+	static_assert(g1::number_of_terminals == 4, "");
+	static_assert(g1::number_of_symbols == 6, "");
+	static_assert(g1::number_of_productions == 3, "");
+	static_assert(g1::symbol<eof>::value == 0, "");
+	static_assert(g1::symbol<parser1::start>::value == g1::root, "");
+	static_assert(g1::productions[0].lhs == g1::root, "");
+	static_assert(g1::productions[0].length == 2, "");
+	static_assert(g1::rhs[g1::productions[0].rhs] == g1::symbol<Expr>::value, "");
+	static_assert(g1::productions[1].kind == 1 && g1::productions[1].length == 3, "");
+	static_assert(g1::productions[2].kind == 2 && g1::productions[2].length == 1, "");
+	static_assert(g1::kinds[g1::symbol<tok_int>::value] == 123, "");
+
+	typedef grammar_follow<g1, Expr>::type e_follow;
+	static_assert(ts_equal<e_follow, typeset<tok_close, eof>>::value, "");
+	static_assert(ts_equal<grammar_first<g1, parser1::start>::type, e_first>::value, "");
 }
 
 namespace RecursiveRules
@@ -149,7 +168,6 @@ namespace RecursiveRules
 
 	static_assert(is_empty<Expr>::value, "");
 
-	// Fix recursive first()
 	static_assert(ts_contains<tok_a, first<Expr>::type>::value, "");
 
 	static_assert(ts_contains<tok_a, first<tok_a>::type > ::value, "");
@@ -243,3 +261,104 @@ namespace RecusiveTests
 	static_assert(front_recursive<Expr5>::value, "Expr is front-recursive");
 	static_assert(!front_recursive<Expr6>::value, "Expr is front-recursive");
 };
+
+namespace BitsetTests
+{
+	typedef ExprTests::parser1 parser1;
+	typedef parser1::symbol_bits<parser1::terminals> terminal_bits;
+	typedef parser1::symbol_bits<parser1::nonterminals> nonterminal_bits;
+
+	static_assert(ts_size<terminal_bits>::value == 4, "");
+	static_assert(ts_size<nonterminal_bits>::value == 2, "");
+	static_assert(ts_contains<eof, terminal_bits>::value, "");
+	static_assert(ts_contains<ExprTests::tok_int, terminal_bits>::value, "");
+	static_assert(!ts_contains<ExprTests::Expr, terminal_bits>::value, "");
+	static_assert(ts_contains<ExprTests::Expr, nonterminal_bits>::value, "");
+
+	typedef parser1::symbol_bits<parser1::symbols> symbol_bits;
+	static_assert(std::is_same<ts_union<terminal_bits, nonterminal_bits>::type, symbol_bits>::value, "");
+	static_assert(std::is_same<ts_where<symbol_bits, is_terminal>::type, terminal_bits>::value, "");
+	static_assert(std::is_same<ts_except<symbol_bits, is_terminal>::type, nonterminal_bits>::value, "");
+	static_assert(ts_equal<ts_from_bits<terminal_bits>::type, parser1::terminals>::value, "");
+
+	typedef parser1::symbol_bits<ExprTests::e_first> e_first_bits;
+	static_assert(ts_subset<e_first_bits, terminal_bits>::value, "");
+	static_assert(ts_equal<e_first_bits, ExprTests::e_first>::value, "");
+}
+
+namespace FixpointTests
+{
+	enum tokens { comma, x, y };
+
+	typedef Token<comma, Ch<','>> tok_comma;
+	typedef Token<x, Ch<'x'>> tok_x;
+	typedef Token<y, Ch<'y'>> tok_y;
+
+	// Left recursion
+	struct List
+	{
+		typedef Rules<
+			Rule<1, List, tok_comma, tok_x>,
+			tok_x
+		> rule;
+	};
+
+	typedef flat_grammar<List> list_grammar;
+	static_assert(ts_equal<first<List>::type, typeset<tok_x>>::value, "");
+	static_assert(ts_equal<grammar_follow<list_grammar, List>::type, typeset<tok_comma, eof>>::value, "");
+	static_assert(!is_empty<List>::value, "");
+
+	// Nullable only through mutual recursion with a nullable alternative
+	struct B;
+
+	struct A
+	{
+		typedef Rules<
+			Rule<1, B, tok_x>,
+			Rule<2, B>
+		> rule;
+	};
+
+	struct B
+	{
+		typedef Rules<
+			Rule<3, A, tok_y>,
+			Rule<4>
+		> rule;
+	};
+
+	typedef flat_grammar<A> ab_grammar;
+	static_assert(is_empty<A>::value, "");
+	static_assert(is_empty<B>::value, "");
+	static_assert(ts_equal<first<A>::type, typeset<tok_x, tok_y>>::value, "");
+	static_assert(ts_equal<first<B>::type, typeset<tok_x, tok_y>>::value, "");
+	static_assert(ts_equal<grammar_follow<ab_grammar, B>::type, typeset<tok_x, tok_y, eof>>::value, "");
+	static_assert(ts_equal<grammar_follow<ab_grammar, A>::type, typeset<tok_y, eof>>::value, "");
+
+	// Every symbol refers to every other symbol, which is exponential
+	// if each recursive context is explored separately.
+	const int dense_size = 12;
+
+	template<int N>
+	struct Dense
+	{
+		template<typename Sequence>
+		struct alternatives;
+
+		template<std::size_t... I>
+		struct alternatives<std::index_sequence<I...>>
+		{
+			typedef Rules<Token<N, Ch<'a' + N>>, Rule<100 + N, Dense<I>, Dense<N>>...> type;
+		};
+
+		typedef typename alternatives<std::make_index_sequence<dense_size>>::type rule;
+	};
+
+	typedef flat_grammar<Dense<0>> dense_grammar;
+	static_assert(dense_grammar::number_of_nonterminals == dense_size, "");
+	static_assert(dense_grammar::number_of_productions == dense_size * (dense_size + 1), "");
+	static_assert(ts_size<first<Dense<0>>::type>::value == dense_size, "");
+	static_assert(ts_size<grammar_follow<dense_grammar, Dense<0>>::type>::value == dense_size + 1, "");
+	static_assert(ts_size<grammar_follow<dense_grammar, Dense<5>>::type>::value == dense_size, "");
+	static_assert(!is_empty<Dense<3>>::value, "");
+}
@@ -6,6 +6,11 @@
 #include "slurp.hpp"
 #include "prettyprint.hpp"
 
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <random>
+#include <tuple>
 #include <sstream>
 
 namespace slurp
@@ -103,6 +108,8 @@ void TestStack()
 		assert(top.IsToken());
 		assert(top.WTextLength() == 5);
 		assert(top.Str() == L"hello");
+		assert(top.WTextView() == L"hello");
+		assert(top.HasText());
 	}
 
 	stack.Reduce(2, 1);
@@ -132,6 +139,105 @@ void TestStack()
 		assert(top[1].Kind == 2);
 		assert(top[2].Kind == 3);
 	}
+
+	// Tokens that reference the source instead of copying it
+	Stack references(reference_text);
+	const char source[] = "hello world";
+	TokenData w = { 6, 5 };
+	references.Shift(1, w, source + 6, source + 11);
+	assert(!references.Root().HasText());
+	assert(references.Root().Text(source) == "world");
+	assert(references.Root().Str().empty());
+
+	references.Shift(4, w, 0);  // A node with no children has no text
+	assert(references.Root().Text(source).empty());
+
+	references.Reduce(2, 2);
+	[[maybe_unused]] const char32_t wide[] = U"hello world";
+	assert(references.Root()[0].Text(source) == "world");
+	assert(references.Root()[0].Text(wide) == U"world");
+	assert(references.Top() == 2 * (sizeof(TokenData) + sizeof(Node)) + sizeof(Node));
+
+	// Children in order, with and without a child table and node starts
+	for (int flags = 0; flags < 4; ++flags)
+	{
+		stack_options options;
+		options.child_table = flags & 1;
+		options.node_starts = flags & 2;
+		Stack list(options);
+		for (int i = 0; i < 20; ++i)
+			list.Shift(i, d, world, world + i % 6);
+		list.Reduce(100, 20);
+		list.Shift(101, d, hello, hello + 5);
+		list.Reduce(102, 2);
+
+		const Node& root = list.Root();
+		assert(root.HasChildTable() == options.child_table);
+		assert(root.size() == 2);
+		assert(root[0].Kind == 100 && root[1].Kind == 101);
+		assert(root[1].Str() == L"hello");
+
+		int k = 0;
+		for ([[maybe_unused]] const Node& child : root[0].children())
+		{
+			assert(child.Kind == k && &child == &root[0][k]);
+			assert(child.WTextLength() == (Node::size_type)(k % 6));
+			++k;
+		}
+		assert(k == 20);
+
+		auto children = root.children();
+		assert(std::distance(children.begin(), children.end()) == 2);
+		assert(children.begin()->Kind == 100);
+
+		if (options.node_starts)
+		{
+			assert(list.NodeStarts().size() == 1 && list.NodeStarts()[0] == 0);
+
+			// Unwinding removes the starts of the nodes after the position
+			auto top = list.Top();
+			list.Shift(103, d, hello, hello + 1);
+			list.Shift(104, d, hello, hello + 2);
+			assert(list.NodeStarts().size() == 3 && list.NodeStarts()[1] == top);
+			list.Unwind(top);
+			assert(list.NodeStarts().size() == 1);
+		}
+		else
+			assert(list.NodeStarts().empty());
+	}
+
+	// Each storage gives the same tree, when the stack is copied or moved, and when it outgrows its reservation
+	std::pmr::monotonic_buffer_resource arena;
+	for (stack_storage storage : { heap_storage, resource_storage, mapped_storage })
+	{
+		stack_options options;
+		options.storage = storage;
+		options.resource = &arena;
+		options.reserve = 4096;
+
+		Stack left(options);
+		for (int i = 0; i < 1000; ++i)
+		{
+			left.Shift(i % 100, d, hello, hello + 5);
+			if (i > 0) left.Reduce(7, 2);
+		}
+
+		Stack copy = left;
+		Stack moved = std::move(left);
+		copy.ShrinkToFit();
+		for (const Stack* s : { &copy, &moved })
+		{
+			const Node* n = &s->Root();
+			for (int i = 999; i > 0; --i, n = &(*n)[0])
+				assert(n->Kind == 7 && (*n)[1].Kind == i % 100 && (*n)[1].Str() == L"hello");
+			assert(n->Kind == 0);
+		}
+
+		// A copy only reserves what it copied, so grows when it is appended to
+		copy.Shift(100, d, hello, hello + 5);
+		copy.Reduce(8, 2);
+		assert(copy.Root().Kind == 8 && copy.Root()[0].Kind == 7 && copy.Root()[1].Str() == L"hello");
+	}
 }
 
 struct Statement
@@ -378,6 +484,1309 @@ namespace RD
 	}
 }
 
+namespace LR
+{
+	using namespace slurp;
+
+	// A path in the temporary directory, for the tests that write files.
+	std::string TempPath(const std::string& name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	// Whether two parse trees have the same shape, kinds and token text.
+	bool SameTree(const Node& a, const Node& b)
+	{
+		if (a.Kind != b.Kind || a.size() != b.size() || a.Str() != b.Str())
+			return false;
+		for (unsigned short i = 0; i < a.size(); ++i)
+			if (!SameTree(a[i], b[i]))
+				return false;
+		return true;
+	}
+
+	// Whether a tree of packed nodes is the same as a tree.
+	bool SameTree(const Node& a, packed_node b)
+	{
+		if (a.Kind != b.Kind || a.size() != b.size())
+			return false;
+		if (a.IsToken())
+			return a.GetToken()->offset == b.GetToken()->offset && a.GetToken()->length == b.GetToken()->length;
+
+		const Node* c = a.FirstChild();
+		packed_node d = b.FirstChild();
+		for (int i = 0; i < a.size(); ++i)
+		{
+			if (!SameTree(*c, d))
+				return false;
+			if (i + 1 < a.size())
+			{
+				c = c->NextChild();
+				d = d.NextChild();
+			}
+		}
+		return d.begin() == b.begin();
+	}
+
+	// Whether a compact tree is the same as a tree.
+	bool SameTree(const Node& a, const compact_node& b)
+	{
+		if (a.Kind != b.Kind || a.size() != b.size() || a.Str() != b.Str())
+			return false;
+		if (a.IsToken())
+			return a.GetToken()->offset == b.GetToken()->offset && a.GetToken()->length == b.GetToken()->length;
+
+		const compact_node* c = b.FirstChild();
+		for (const Node& child : a.children())
+		{
+			if (!SameTree(child, *c))
+				return false;
+			c = c->NextSibling();
+		}
+		return c == b.NextSibling();
+	}
+
+	typedef Token<'d', Ch<'d'>> Digit;
+	typedef Token<'+', Ch<'+'>> Plus;
+	typedef Token<'(', Ch<'('>> Open;
+	typedef Token<')', Ch<')'>> Close;
+
+	struct List
+	{
+		typedef Rules<
+			Rule<'e'>,
+			Rule<'l', Plus, List>
+		> rule;
+	};
+
+	struct Expr;
+
+	struct Primary
+	{
+		typedef Rules<
+			Digit,
+			Rule<'b', Open, Expr, Close>,
+			Rule<'L', Open, Open, List, Close, Close>
+		> rule;
+	};
+
+	struct Expr
+	{
+		typedef Rules<
+			Primary,
+			Rule<'+', Primary, Plus, Expr>
+		> rule;
+	};
+
+	template<typename Grammar>
+	void CompareWithRecursiveDescent(const std::string& input)
+	{
+		null_tokenizer tok;
+		auto p = recursive_descent<Grammar>(tok, input.begin(), input.end());
+		auto q = direct_lr<Grammar>(tok, input.begin(), input.end());
+		auto r = lr_parse<Grammar>(tok, input.begin(), input.end());
+
+		stack_options options;
+		options.child_table = true;
+		options.node_starts = true;
+		auto t = direct_lr<Grammar>(tok, input.begin(), input.end(), options);
+
+		assert(bool(p) == bool(q));
+		assert(bool(p) == bool(r));
+		assert(bool(p) == bool(t));
+		assert(!p || SameTree(p.root(), q.root()));
+		assert(!p || SameTree(p.root(), r.root()));
+		assert(!p || SameTree(p.root(), t.root()));
+	}
+
+	void TestDirectLR()
+	{
+		null_tokenizer tok;
+
+		std::string input = "dd";
+		auto p = direct_lr<RD::Integer>(tok, input.begin(), input.end());
+		assert(p);
+		assert(p.root() == 'i');
+		assert(p.root().size() == 2);
+		assert(p.root()[0] == 'd');
+		assert(p.root()[1] == 'd');
+
+		input = "ddx";
+		p = direct_lr<RD::Integer>(tok, input.begin(), input.end());
+		assert(!p);
+
+		CompareWithRecursiveDescent<RD::Integer>("d");
+		CompareWithRecursiveDescent<RD::Integer>("ddd");
+		CompareWithRecursiveDescent<List>("");
+		CompareWithRecursiveDescent<List>("+++");
+		CompareWithRecursiveDescent<Expr>("d+(d+d)+((++))");
+		CompareWithRecursiveDescent<Expr>("(d+(d))");
+		CompareWithRecursiveDescent<Expr>("d+");
+		CompareWithRecursiveDescent<Expr>("(d");
+
+		// A long input does not use the C++ stack
+		input = std::string(100000, 'd');
+		p = direct_lr<RD::Integer>(tok, input.begin(), input.end());
+		assert(p);
+		assert(p.root() == 'i');
+	}
+
+	void TestLRParser()
+	{
+		std::string input = "dd";
+		lr_parser<lalr_tables<RD::Integer>, null_tokenizer, std::string::const_iterator> parser;
+		auto p = parser.parse(input.begin(), input.end());
+		assert(p);
+		assert(p.root() == 'i');
+		assert(p.root().size() == 2);
+		assert(p.root()[0] == 'd');
+		assert(p.root()[1] == 'd');
+
+		// The parser can be reused
+		input = "ddx";
+		p = parser.parse(input.begin(), input.end());
+		assert(!p);
+
+		input = "d";
+		p = parser.parse(input.begin(), input.end());
+		assert(p);
+		assert(p.root() == 'd');
+
+		// Deeply nested input
+		input = std::string(100000, '(') + "d" + std::string(100000, ')');
+		p = lr_parse<Expr>(null_tokenizer(), input.begin(), input.end());
+		assert(p);
+		assert(p.root() == 'b');
+
+		input.pop_back();
+		p = lr_parse<Expr>(null_tokenizer(), input.begin(), input.end());
+		assert(!p);
+	}
+
+	typedef Token<'a', Ch<'a'>> TokenA;
+	typedef Token<'b', Ch<'b'>> TokenB;
+
+	// Each level is parsed twice by the level outside it, when that ends in b
+	struct Nested
+	{
+		typedef Rules<
+			Digit,
+			Rule<'a', Open, Nested, Close, TokenA>,
+			Rule<'b', Open, Nested, Close, TokenB>
+		> rule;
+	};
+
+	template<typename Grammar>
+	void CompareWithPackrat(const std::string& input)
+	{
+		auto p = recursive_descent<Grammar>(null_tokenizer(), input.begin(), input.end());
+		auto q = recursive_descent_packrat<Grammar>(null_tokenizer(), input.begin(), input.end());
+		assert(bool(p) == bool(q));
+		assert(!p || SameTree(p.root(), q.root()));
+	}
+
+	void TestPackrat()
+	{
+		CompareWithPackrat<RD::Integer>("d");
+		CompareWithPackrat<RD::Integer>("dddd");
+		CompareWithPackrat<RD::Integer>("ddx");
+		CompareWithPackrat<List>("+++");
+		CompareWithPackrat<Expr>("d+(d+d)+((++))");
+		CompareWithPackrat<Expr>("(d+(d))");
+		CompareWithPackrat<Expr>("d+");
+
+		std::string input = "d";
+		for (int i = 0; i < 12; ++i)
+			input = "(" + input + (i % 3 ? ")b" : ")a");
+		CompareWithPackrat<Nested>(input);
+		CompareWithPackrat<Nested>(input + "a");
+
+		// Each level is parsed once
+		input = "d";
+		for (int i = 0; i < 200; ++i)
+			input = "(" + input + ")b";
+		packrat_statistics statistics;
+		auto p = recursive_descent_packrat<Nested>(null_tokenizer(), input.begin(), input.end(), stack_options(), default_packrat_bytes, &statistics);
+		assert(p && p.root() == 'b');
+		assert(statistics.misses == 201 && statistics.hits == 200 && statistics.flushes == 0);
+
+		// A small memo is flushed, and the outer levels that do not fit are parsed again
+		input = "d";
+		for (int i = 0; i < 40; ++i)
+			input = "(" + input + ")b";
+		p = recursive_descent_packrat<Nested>(null_tokenizer(), input.begin(), input.end());
+		auto q = recursive_descent_packrat<Nested>(null_tokenizer(), input.begin(), input.end(), stack_options(), 3000, &statistics);
+		assert(q && SameTree(p.root(), q.root()));
+		assert(statistics.flushes > 0 && statistics.hits > 0);
+	}
+
+	// Evaluates Expr, where d is 1, a bracket is its contents, and a list is 10 per +.
+	struct ExprActions
+	{
+		typedef unsigned value_type;
+
+		template<typename It>
+		unsigned token(short kind, const TokenData&, It, It)
+		{
+			return kind == 'd';
+		}
+
+		unsigned reduce(short kind, const unsigned* children, [[maybe_unused]] unsigned short size)
+		{
+			switch (kind)
+			{
+			case '+': return children[0] + children[2];
+			case 'b': return children[1];
+			case 'L': return children[2];
+			case 'l': return 10 + children[1];
+			default:
+				assert(kind == 'e' && size == 0);
+				return 0;
+			}
+		}
+	};
+
+	// The value of ExprActions from a tree.
+	unsigned Evaluate(const Node& n)
+	{
+		switch (n.Kind)
+		{
+		case 'd': return 1;
+		case '+': return Evaluate(n[0]) + Evaluate(n[2]);
+		case 'b': return Evaluate(n[1]);
+		case 'L': return Evaluate(n[2]);
+		case 'l': return 10 + Evaluate(n[1]);
+		default: return 0;
+		}
+	}
+
+	// Actions that are overloaded on the kind, so need a parser that knows the kinds at compile time.
+	struct CountActions
+	{
+		typedef int value_type;
+
+		template<typename It>
+		int token(short, const TokenData&, It, It) { return 1; }
+
+		template<short Kind>
+		int reduce(rule_kind<Kind>, const int* children, unsigned short)
+		{
+			static_assert(Kind == 'i', "RD::Integer only has rule i");
+			return children[0] + children[1] + 100;
+		}
+	};
+
+	void TestParseActions()
+	{
+		ExprActions actions;
+		compressed_tables compressed((lalr_tables<Expr>()));
+		lr_parser<compressed_tables, null_tokenizer, std::string::const_iterator> parser(compressed);
+
+		for (std::string input : { "d", "d+(d+d)+((++))", "(d+(d))", "((++++))+d", "((", "d+", "(d" })
+		{
+			auto p = lr_parse<Expr>(null_tokenizer(), input.begin(), input.end());
+			[[maybe_unused]] auto q = lr_parse_actions<Expr>(actions, null_tokenizer(), input.begin(), input.end());
+			[[maybe_unused]] auto r = direct_lr_actions<Expr>(actions, null_tokenizer(), input.begin(), input.end());
+			[[maybe_unused]] auto s = recursive_descent_actions<Expr>(actions, null_tokenizer(), input.begin(), input.end());
+			[[maybe_unused]] auto t = parser.parse_actions(actions, input.begin(), input.end());
+
+			assert(bool(p) == bool(q) && bool(p) == bool(r) && bool(p) == bool(s) && bool(p) == bool(t));
+			if (p)
+			{
+				assert(q.value == Evaluate(p.root()) && q.value > 0);
+				assert(r.value == q.value && s.value == q.value && t.value == q.value);
+			}
+			else
+				assert(q.syntaxError.offset == p.syntaxError.offset && r.syntaxError.offset == p.syntaxError.offset);
+		}
+
+		CountActions count;
+		std::string input = "ddd";
+		[[maybe_unused]] auto c = direct_lr_actions<RD::Integer>(count, null_tokenizer(), input.begin(), input.end());
+		assert(c && c.value == 203);
+		c = recursive_descent_actions<RD::Integer>(count, null_tokenizer(), input.begin(), input.end());
+		assert(c.value == 203);
+
+		// A deep input only needs the values of the unfinished rules
+		input = std::string(100000, '(') + "d" + std::string(100000, ')');
+		[[maybe_unused]] auto deep = lr_parse_actions<Expr>(actions, null_tokenizer(), input.begin(), input.end());
+		assert(deep.value == 1);
+		deep = direct_lr_actions<Expr>(actions, null_tokenizer(), input.begin(), input.end());
+		assert(deep.value == 1);
+	}
+
+	void TestTreeFile()
+	{
+		std::string input = "d+(d+d)+((++))";
+		auto parse = [&] { return lr_parse<Expr>(null_tokenizer(), input.begin(), input.end()); };
+		auto p = parse();
+		assert(p);
+
+		std::uint64_t fingerprint = tables_fingerprint<lalr_tables<Expr>>();
+		std::uint64_t hash = content_hash(input.data(), input.size());
+		assert(fingerprint != tables_fingerprint<lalr_tables<RD::Integer>>());
+		assert(hash != content_hash(input.data(), input.size() - 1));
+
+		std::string path = TempPath("slurp-test-tree.bin");
+		[[maybe_unused]] bool written = write_tree_file(p, path, fingerprint, hash, input.size());
+		assert(written);
+		{
+			auto q = open_tree_file(path, fingerprint, hash, input.size());
+			assert(q);
+			assert(SameTree(p.root(), q.root()));
+			assert(q.tree().text_mode() == copy_text);
+
+			// A copy of a mapped tree is on the heap
+			auto r = q;
+			q = parse_result();
+			assert(SameTree(p.root(), r.root()));
+		}
+
+		// Files from a different grammar or input are rejected
+		assert(!open_tree_file(path, fingerprint + 1, hash, input.size()));
+		assert(!open_tree_file(path, fingerprint, hash + 1, input.size()));
+		assert(!open_tree_file(path, fingerprint, hash, input.size() + 1));
+
+		// So is a file whose root does not cover the tree
+		{
+			std::FILE* f = std::fopen(path.c_str(), "r+b");
+			Node root(0, 0, 0);
+			std::fseek(f, -(long)sizeof(Node), SEEK_END);
+			[[maybe_unused]] std::size_t read = std::fread(&root, sizeof(Node), 1, f);
+			assert(read == 1);
+			root = Node(root.Kind, root.size(), root.Length() - 4);
+			std::fseek(f, -(long)sizeof(Node), SEEK_END);
+			std::fwrite(&root, sizeof(Node), 1, f);
+			std::fclose(f);
+			assert(!open_tree_file(path, fingerprint, hash, input.size()));
+		}
+
+		// And a file whose root is intact but whose first child overlaps its sibling
+		written = write_tree_file(p, path, fingerprint, hash, input.size());
+		assert(written);
+		{
+			std::FILE* f = std::fopen(path.c_str(), "r+b");
+			Node child(0, 0, 0);
+			std::fseek(f, -2 * (long)sizeof(Node), SEEK_END);
+			[[maybe_unused]] std::size_t read = std::fread(&child, sizeof(Node), 1, f);
+			assert(read == 1);
+			child = Node(child.Kind, child.size(), child.Length() + sizeof(Node));
+			std::fseek(f, -2 * (long)sizeof(Node), SEEK_END);
+			std::fwrite(&child, sizeof(Node), 1, f);
+			std::fclose(f);
+			assert(!open_tree_file(path, fingerprint, hash, input.size()));
+		}
+
+		// A tree is opened with the options that it was built with
+		{
+			stack_options options(reference_text);
+			options.child_table = true;
+			lr_parser<lalr_tables<Expr>, null_tokenizer, std::string::const_iterator> parser(lalr_tables<Expr>(), null_tokenizer(), options);
+			auto t = parser.parse(input.begin(), input.end());
+			written = write_tree_file(t, path, fingerprint, hash, input.size());
+			assert(written);
+
+			auto q = open_tree_file(path, fingerprint, hash, input.size());
+			assert(q && SameTree(t.root(), q.root()));
+			assert(q.tree().text_mode() == reference_text && q.tree().get_options().child_table);
+		}
+
+		// A packed tree
+		{
+			stack_options options;
+			options.encoding = packed_nodes;
+			lr_parser<lalr_tables<Expr>, null_tokenizer, std::string::const_iterator> parser(lalr_tables<Expr>(), null_tokenizer(), options);
+			auto t = parser.parse(input.begin(), input.end());
+			written = write_tree_file(t, path, fingerprint, hash, input.size());
+			assert(written);
+
+			auto q = open_tree_file(path, fingerprint, hash, input.size());
+			auto fixed = direct_lr<Expr>(null_tokenizer(), input.begin(), input.end(), reference_text);
+			assert(q && q.tree().get_options().encoding == packed_nodes && q.tree().text_mode() == reference_text);
+			assert(SameTree(fixed.root(), q.packed_root()));
+
+			// The first byte of the tree is the offset of the first token.
+			// Move it past the input, then make it run off the start of the tree.
+			for (int offset : { 0x7f, 0x80 })
+			{
+				q = parse_result();
+				std::FILE* f = std::fopen(path.c_str(), "r+b");
+				std::fseek(f, -(long)t.tree().Top(), SEEK_END);
+				std::fputc(offset, f);
+				std::fclose(f);
+				assert(!open_tree_file(path, fingerprint, hash, input.size()));
+			}
+		}
+
+		// Failed parses are not written
+		std::string bad = "d+";
+		written = write_tree_file(lr_parse<Expr>(null_tokenizer(), bad.begin(), bad.end()), path, fingerprint, hash, input.size());
+		assert(!written);
+
+		// Invalid files are rejected
+		{
+			std::FILE* f = std::fopen(path.c_str(), "wb");
+			std::fputs("not a tree file", f);
+			std::fclose(f);
+			assert(!open_tree_file(path, fingerprint, hash, input.size()));
+		}
+		std::remove(path.c_str());
+		assert(!open_tree_file(path, fingerprint, hash, input.size()));
+
+		// The cache parses the input the first time only
+		tree_cache cache(std::filesystem::temp_directory_path().string(), fingerprint);
+		std::remove(cache.path(hash).c_str());
+		bool hit = true;
+		auto q = cache.parse(input.data(), input.size(), parse, &hit);
+		assert(!hit);
+		assert(q && SameTree(p.root(), q.root()));
+
+		q = cache.parse(input.data(), input.size(), [&] { assert(false); return parse_result(); }, &hit);
+		assert(hit);
+		assert(q && SameTree(p.root(), q.root()));
+		std::remove(cache.path(hash).c_str());
+	}
+
+	void TestCompactTree()
+	{
+		std::string input = "d+(d+d)+((++))";
+		auto p = lr_parse<Expr>(null_tokenizer(), input.begin(), input.end());
+		assert(p);
+		compact_tree tree(p.root());
+		assert(SameTree(p.root(), tree.root()));
+		assert(tree.size() == p.tree().Top());
+
+		// Next() visits the nodes in preorder
+		std::vector<short> preorder;
+		auto visit = [&](const Node& n, auto& visit) -> void {
+			preorder.push_back(n.Kind);
+			for (const Node& child : n.children())
+				visit(child, visit);
+		};
+		visit(p.root(), visit);
+		std::size_t i = 0;
+		for (const compact_node* n = &tree.root(); n != tree.end(); n = n->Next(), ++i)
+			assert(i < preorder.size() && n->Kind == preorder[i]);
+		assert(i == preorder.size());
+
+		// Child tables are not copied, and tokens can reference the source
+		stack_options options(reference_text);
+		options.child_table = true;
+		auto q = direct_lr<Expr>(null_tokenizer(), input.begin(), input.end(), options);
+		compact_tree referenced(q.root());
+		assert(SameTree(q.root(), referenced.root()));
+		assert(referenced.size() < q.tree().Top());
+		assert(!referenced.root()[0].HasText());
+
+		// A subtree
+		compact_tree subtree(p.root()[2]);
+		assert(SameTree(p.root()[2], subtree.root()));
+		assert(subtree.root().children().size() == 3);
+		assert(subtree.root()[2].Kind == p.root()[2][2].Kind);
+
+		// Deep trees are copied without recursion
+		input = std::string(100000, '(') + "d" + std::string(100000, ')');
+		p = lr_parse<Expr>(null_tokenizer(), input.begin(), input.end());
+		compact_tree deep(p.root());
+		i = 0;
+		[[maybe_unused]] const compact_node* last = nullptr;
+		for (const compact_node* n = &deep.root(); n != deep.end(); n = n->Next(), ++i)
+			last = n;
+		assert(i == 300001);
+		assert(deep.root() == 'b' && *last == ')');
+	}
+
+	void TestTreeCursor()
+	{
+		std::string input = "d+(d+d)+((++))";
+		auto p = lr_parse<Expr>(null_tokenizer(), input.begin(), input.end());
+		assert(p);
+
+		// The same nodes and depths as a recursive walk
+		std::vector<std::pair<const Node*, std::size_t>> preorder, postorder;
+		auto visit = [&](const Node& n, std::size_t depth, auto& visit) -> void {
+			preorder.push_back(std::make_pair(&n, depth));
+			for (const Node& child : n.children())
+				visit(child, depth + 1, visit);
+			postorder.push_back(std::make_pair(&n, depth));
+		};
+		visit(p.root(), 0, visit);
+
+		tree_cursor cursor;
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			std::size_t entered = 0, left = 0;
+			[[maybe_unused]] bool complete = walk_tree(cursor, p.root(),
+				[&](const Node& n, std::size_t depth) {
+					[[maybe_unused]] bool same = preorder[entered++] == std::make_pair(&n, depth);
+					assert(same);
+					return walk_children;
+				},
+				[&](const Node& n, std::size_t depth) {
+					[[maybe_unused]] bool same = postorder[left++] == std::make_pair(&n, depth);
+					assert(same);
+				});
+			assert(complete && entered == preorder.size() && left == postorder.size());
+		}
+
+		// The path from the root
+		cursor.reset(p.root());
+		while (cursor.MoveNext() && !cursor.node().IsToken())
+			;
+		assert(cursor.path_size() == cursor.depth() + 1 && &cursor.path_node(0) == &p.root());
+
+		// Pruning and stopping
+		std::size_t entered = 0, left = 0;
+		walk_tree(p.root(), [&](const Node& n, std::size_t) { ++entered; return n == 'b' || n == 'L' ? skip_children : walk_children; },
+			[&](const Node&, std::size_t) { ++left; });
+		assert(entered == left && entered == 7);
+
+		entered = 0;
+		assert(!walk_tree(p.root(), [&](const Node& n, std::size_t) { ++entered; return n == 'b' ? stop_walk : walk_children; }));
+		assert(entered == 5);
+
+		// A tree whose depth is the length of the input
+		input = std::string(1000000, 'd');
+		p = lr_parse<RD::Integer>(null_tokenizer(), input.begin(), input.end());
+		assert(p);
+		std::size_t nodes = 0, depth = 0;
+		walk_tree(cursor, p.root(), [&](const Node&, std::size_t d) { ++nodes; depth = std::max(depth, d); return walk_children; },
+			[](const Node&, std::size_t) {});
+		assert(nodes == 1999999 && depth == 999999);
+
+		// DumpTree walks with a cursor
+		std::ostringstream out;
+		auto old = std::cout.rdbuf(out.rdbuf());
+		Stack stack(reference_text);
+		for (unsigned i = 0; i < 3; ++i)
+			stack.Shift('d', TokenData{ i, 1 }, 1);
+		stack.Reduce('i', 2);
+		stack.Reduce('i', 2);
+		stack.DumpTree();
+		std::cout.rdbuf(old);
+		assert(out.str() == "105:\n  100: @0+1\n  105:\n    100: @1+1\n    100: @2+1\n");
+	}
+
+	void TestPackedNodes()
+	{
+		// Varints of each length
+		for (std::uint32_t v : { 0u, 1u, 127u, 128u, 16383u, 16384u, 1u << 28, 0xffffffffu })
+		{
+			char buffer[8];
+			char* end = helpers::write_back_varint(buffer, v);
+			assert((std::size_t)(end - buffer) == helpers::back_varint_size(v));
+			const char* p = end;
+			[[maybe_unused]] std::uint32_t value = helpers::read_back_varint(p);
+			assert(value == v && p == buffer);
+		}
+
+		// The same trees as with fixed nodes, with and without node starts
+		std::string input = "d+(d+d)+((++))";
+		auto q = direct_lr<Expr>(null_tokenizer(), input.begin(), input.end(), reference_text);
+		auto r = lr_parse<Expr>(null_tokenizer(), input.begin(), input.end());
+		for (bool node_starts : { false, true })
+		{
+			stack_options options;
+			options.encoding = packed_nodes;
+			options.node_starts = node_starts;
+			lr_parser<lalr_tables<Expr>, null_tokenizer, std::string::const_iterator> parser(lalr_tables<Expr>(), null_tokenizer(), options);
+			auto p = parser.parse(input.begin(), input.end());
+			assert(p && SameTree(q.root(), p.packed_root()));
+			assert(p.tree().Top() < r.tree().Top() / 4);
+		}
+
+		// Large fields, negative kinds and many children
+		stack_options options;
+		options.encoding = packed_nodes;
+		Stack packed(options), fixed(reference_text);
+		for (unsigned i = 0; i < 300; ++i)
+		{
+			TokenData td = { i << 22, i * 1000 };
+			packed.Shift(-(short)i, td, i);
+			fixed.Shift(-(short)i, td, i);
+		}
+		packed.Reduce(1000, 300);
+		fixed.Reduce(1000, 300);
+		assert(packed.text_mode() == reference_text);
+		assert(SameTree(fixed.Root(), packed.PackedRoot()));
+
+		[[maybe_unused]] packed_node root = packed.PackedRoot();
+		assert(root.size() == 300 && root.begin() == packed.Data());
+		assert(root[299].Kind == -299);
+		assert(root[299].GetToken()->offset == 299u << 22 && root[299].GetToken()->length == 299);
+
+		// DumpTree is the same as for fixed nodes
+		std::ostringstream out;
+		auto old = std::cout.rdbuf(out.rdbuf());
+		packed.DumpTree();
+		std::string dump = out.str();
+		out.str("");
+		fixed.DumpTree();
+		std::cout.rdbuf(old);
+		assert(dump == out.str());
+	}
+
+	// The offsets of the tokens of a subtree, in order.
+	std::vector<unsigned> TokenOffsets(const Node& root)
+	{
+		std::vector<unsigned> offsets;
+		walk_tree(root, [&](const Node& n, std::size_t) {
+			if (n.IsToken()) offsets.push_back(n.GetToken()->offset);
+			return walk_children;
+		});
+		return offsets;
+	}
+
+	void TestParallelFold()
+	{
+		// A list of 1000 items of 1 to 3 tokens
+		Stack stack(reference_text);
+		unsigned offset = 0;
+		for (int i = 0; i < 1000; ++i)
+		{
+			for (int j = 0; j <= i % 3; ++j, ++offset)
+				stack.Shift('t', TokenData{ offset, 1 }, 1);
+			stack.Reduce('i', (unsigned short)(1 + i % 3));
+		}
+		stack.Reduce('l', 1000);
+		parse_result list(std::move(stack));
+		std::vector<unsigned> expected = TokenOffsets(list.root());
+		assert(expected.size() == offset);
+
+		auto fold = [](const Node& n) { return TokenOffsets(n); };
+		auto combine = [](const Node&, std::vector<std::vector<unsigned>>&& children) {
+			std::vector<unsigned> result;
+			for (auto& c : children)
+				result.insert(result.end(), c.begin(), c.end());
+			return result;
+		};
+
+		thread_pool pool(4);
+		assert(pool.size() == 4);
+		for (std::size_t threshold : { 0, 64, 1024, 1 << 20 })
+		{
+			auto offsets = list.parallel_fold(pool, fold, combine, threshold);
+			assert(offsets == expected);
+		}
+
+		// Without any threads apart from the caller
+		thread_pool single(1);
+		auto offsets = list.parallel_fold(single, fold, combine, 64);
+		assert(offsets == expected);
+
+		std::atomic<unsigned> tokens(0);
+		list.parallel_for_each_subtree(pool, [&](const Node& n) { tokens += (unsigned)TokenOffsets(n).size(); }, 64);
+		assert(tokens == offset);
+
+		// A deep tree stops splitting at max_split_depth
+		std::string input(100000, 'd');
+		auto deep = lr_parse<RD::Integer>(null_tokenizer(), input.begin(), input.end());
+		[[maybe_unused]] std::size_t count = deep.parallel_fold(pool,
+			[](const Node& n) { return TokenOffsets(n).size(); },
+			[](const Node&, std::vector<std::size_t>&& children) { return children[0] + children[1]; },
+			0);
+		assert(count == input.size());
+
+		// Exceptions are passed to the caller
+		[[maybe_unused]] bool thrown = false;
+		try
+		{
+			list.parallel_fold(pool, [&](const Node& n) {
+				auto offsets = TokenOffsets(n);
+				if (std::find(offsets.begin(), offsets.end(), 500u) != offsets.end()) throw parse_error();
+				return 0;
+			}, [](const Node&, std::vector<int>&&) { return 0; }, 64);
+		}
+		catch (parse_error&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	namespace Lexer
+	{
+		typedef Range<'0', '9'> DigitChar;
+
+		struct Integer
+		{
+			typedef Rules<DigitChar, Seq<Integer, DigitChar>> rule;
+		};
+
+		typedef Token<'i', Integer> Int;
+		typedef Token<'+', Ch<'+'>> Add;
+		typedef Token<'*', Ch<'*'>> Mul;
+		typedef Token<'(', Ch<'('>> Open;
+		typedef Token<')', Ch<')'>> Close;
+
+		struct Sum;
+
+		struct Product
+		{
+			typedef Rules<
+				Int,
+				Rule<'b', Open, Sum, Close>,
+				Rule<'*', Product, Mul, Int>
+			> rule;
+		};
+
+		struct Sum
+		{
+			typedef Rules<
+				Product,
+				Rule<'+', Sum, Add, Product>
+			> rule;
+		};
+
+		typedef typeset<Rules<Ch<' '>, Ch<'\n'>>> Whitespace;
+		typedef grammar_tokenizer<Sum, Whitespace> tokenizer;
+	}
+
+	void TestDFATokenizer()
+	{
+		std::string input = "12 + (34*5)";
+		auto p = lr_parse<Lexer::Sum>(Lexer::tokenizer(), input.begin(), input.end());
+		assert(p);
+		assert(p.root() == '+');
+		assert(p.root()[0] == 'i');
+		assert(p.root()[0].Str() == L"12");
+		assert(p.root()[2] == 'b');
+		assert(p.root()[2][1] == '*');
+		assert(p.root()[2][1][0].Str() == L"34");
+
+		[[maybe_unused]] const TokenData* token = p.root()[2][1][2].GetToken();
+		assert(token->offset == 9);
+		assert(token->length == 1);
+		assert(line_index(input.data(), input.size()).position(token->offset) == source_position(1, 10));
+
+		input = "1\n  +\n2";
+		p = lr_parse<Lexer::Sum>(Lexer::tokenizer(), input.begin(), input.end());
+		assert(p);
+		token = p.root()[2].GetToken();
+		assert(line_index(input.data(), input.size()).position(token->offset) == source_position(3, 1));
+
+		// A character that is not a token is a syntax error
+		input = "1 + x";
+		p = lr_parse<Lexer::Sum>(Lexer::tokenizer(), input.begin(), input.end());
+		assert(!p);
+		assert(p.syntaxError.offset == 4);
+
+		// Tokens are matched one at a time
+		token_position<std::string::const_iterator> pos(input.cbegin(), input.cend());
+		Lexer::tokenizer tok;
+		tok.MoveNext(pos);
+		assert(pos.kind == 'i');
+		tok.MoveNext(pos);
+		assert(pos.kind == '+');
+		tok.MoveNext(pos);
+		assert(pos.kind == lexer_error);
+		assert(pos.size() == 1);
+		tok.MoveNext(pos);
+		assert(pos.kind == -1);
+
+		// The tree can reference the input instead of copying the tokens
+		input = "12 + (34*5)";
+		lr_parser<lalr_tables<Lexer::Sum>, Lexer::tokenizer, const char*> parser(lalr_tables<Lexer::Sum>(), Lexer::tokenizer(), reference_text);
+		p = parser.parse(input.data(), input.data() + input.size());
+		assert(p);
+		assert(!p.root()[0].HasText());
+		assert(p.root()[0].Text(input.data()) == "12");
+		assert(p.root()[2][1][0].Text(input.data()) == "34");
+
+		p = direct_lr<Lexer::Sum>(Lexer::tokenizer(), input.begin(), input.end(), reference_text);
+		assert(p.root()[2][1][2].Text(input.data()) == "5");
+	}
+
+	namespace Runs
+	{
+		typedef Rules<Range<'a', 'z'>, Ch<'_'>> Letter;
+
+		struct Identifier
+		{
+			typedef Rules<Letter, Seq<Identifier, Letter>, Seq<Identifier, Range<'0', '9'>>> rule;
+		};
+
+		struct Spaces
+		{
+			typedef Rules<Ch<' '>, Seq<Spaces, Ch<' '>>> rule;
+		};
+
+		typedef typeset<Token<'x', Identifier>, Token<'i', Lexer::Integer>, Token<';', Ch<';'>>> tokens;
+		typedef dfa_tokenizer<tokens, typeset<Spaces>> tokenizer;
+
+		// The kinds and lengths of the tokens.
+		template<typename It>
+		std::vector<std::pair<int, int>> Tokens(It a, It b)
+		{
+			std::vector<std::pair<int, int>> result;
+			token_position<It> pos(a, b);
+			tokenizer tok;
+			for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+				result.push_back(std::make_pair(pos.kind, (int)pos.size()));
+			return result;
+		}
+	}
+
+	void TestLexerRuns()
+	{
+		// Runs of every length up to 100, which cross the 16 and 32 byte blocks
+		std::string input;
+		for (int n = 1; n <= 100; ++n)
+		{
+			input += std::string(n, 'a') + "_9" + std::string(n % 7, ' ') + ";";
+			input += std::string(n, '1') + std::string(n, ' ') + ";" + std::string(n, ' ');
+		}
+		input += "end123";
+
+		std::deque<char> copy(input.begin(), input.end());
+		auto expected = Runs::Tokens(copy.cbegin(), copy.cend());
+		assert(expected.size() == 401);
+		assert(expected.back() == std::make_pair((int)'x', 6));
+
+		lexer_simd original = get_lexer_simd();
+		for (lexer_simd simd : { lexer_scalar, lexer_sse2, lexer_avx2 })
+		{
+			set_lexer_simd(simd);
+			assert(Runs::Tokens(input.data(), input.data() + input.size()) == expected);
+			assert(Runs::Tokens(input.cbegin(), input.cend()) == expected);
+		}
+		set_lexer_simd(original);
+	}
+
+	namespace Pathological
+	{
+		struct As
+		{
+			typedef Rules<Ch<'a'>, Seq<As, Ch<'a'>>> rule;
+		};
+
+		// a, and a+b, which makes maximal munch quadratic on aaaa...
+		typedef typeset<Token<'a', Ch<'a'>>, Token<'b', Seq<As, Ch<'b'>>>, Token<'c', Seq<Ch<'c'>, Ch<'c'>, Ch<'c'>>>> tokens;
+
+		template<typename Tokenizer, typename It>
+		std::vector<std::pair<int, int>> Tokens(Tokenizer& tok, It a, It b)
+		{
+			std::vector<std::pair<int, int>> result;
+			token_position<It> pos(a, b);
+			for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+				result.push_back(std::make_pair(pos.kind, (int)pos.size()));
+			return result;
+		}
+	}
+
+	void TestLinearTokenizer()
+	{
+		using namespace Pathological;
+		dfa_tokenizer<tokens> quadratic;
+		linear_tokenizer<tokens> linear;
+
+		std::string input(1000, 'a');
+		auto expected = Tokens(quadratic, input.begin(), input.end());
+		assert(expected.size() == 1000);
+		assert(Tokens(linear, input.begin(), input.end()) == expected);
+
+		// The tokenizer is reused on different inputs, including ones that fail in the middle
+		std::mt19937 rng;
+		for (int i = 0; i < 200; ++i)
+		{
+			input.clear();
+			for (int j = rng() % 200; j > 0; --j)
+				input += "aaaaaaaaaaaaaaaaabcc "[rng() % 21];
+
+			expected = Tokens(quadratic, input.data(), input.data() + input.size());
+			assert(Tokens(linear, input.data(), input.data() + input.size()) == expected);
+
+			std::deque<char> copy(input.begin(), input.end());
+			assert(Tokens(linear, copy.begin(), copy.end()) == expected);
+		}
+	}
+
+	namespace Chunked
+	{
+		typedef std::tuple<int, std::string, unsigned> token;
+
+		// The kind, text and offset of the tokens.
+		template<typename TokenSet, typename Skip>
+		std::vector<token> Tokens(const std::string& input)
+		{
+			std::vector<token> result;
+			token_position<const char*> pos(input.data(), input.data() + input.size());
+			dfa_tokenizer<TokenSet, Skip> tok;
+			for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+				result.push_back(token(pos.kind, std::string(pos.begin(), pos.end()), pos.data.offset));
+			return result;
+		}
+
+		// The tokens, where the input is fed in random chunks of up to max_chunk characters.
+		template<typename Tokenizer>
+		std::vector<token> Tokens(Tokenizer& tok, const std::string& input, std::mt19937& rng, int max_chunk)
+		{
+			std::vector<token> result;
+			token_position<const char*> pos;
+			auto add = [&] {
+				assert(pos.size() == pos.data.length);
+				result.push_back(token(pos.kind, std::string(pos.begin(), pos.end()), pos.data.offset));
+			};
+
+			for (std::size_t i = 0; i < input.size();)
+			{
+				// A copy of the chunk, so that nothing points into the input
+				std::string chunk = input.substr(i, rng() % (max_chunk + 1));
+				i += chunk.size();
+				tok.feed(chunk.data(), chunk.size());
+				while (tok.MoveNext(pos))
+					add();
+				tok.feed(nullptr, 0);
+			}
+			tok.finish();
+			while (tok.MoveNext(pos) && pos.kind != -1)
+				add();
+			return result;
+		}
+	}
+
+	void TestChunkedTokenizer()
+	{
+		std::mt19937 rng;
+		for (int i = 0; i < 200; ++i)
+		{
+			std::string input;
+			for (int j = rng() % 100; j > 0; --j)
+				input += std::string(1 + rng() % 3 * (rng() % 20), "ab_19;   \n!"[rng() % 11]);  // Including some long runs
+
+			auto expected = Chunked::Tokens<Runs::tokens, typeset<Runs::Spaces>>(input);
+			for (int max_chunk : { 1, 3, 16, 1000 })
+			{
+				chunked_tokenizer<Runs::tokens, typeset<Runs::Spaces>> tok;
+				auto tokens = Chunked::Tokens(tok, input, rng, max_chunk);
+				assert(tokens == expected);
+			}
+
+			// Longest matches that fail after the end of a chunk
+			input.clear();
+			for (int j = rng() % 300; j > 0; --j)
+				input += "aaaaaaaaabcc"[rng() % 12];
+
+			expected = Chunked::Tokens<Pathological::tokens, ts_empty>(input);
+			for (int max_chunk : { 1, 3, 16, 1000 })
+			{
+				chunked_tokenizer<Pathological::tokens> tok;
+				auto tokens = Chunked::Tokens(tok, input, rng, max_chunk);
+				assert(tokens == expected);
+			}
+		}
+
+		// Only tokens that span chunks are copied
+		chunked_tokenizer<Runs::tokens, typeset<Runs::Spaces>> tok;
+		token_position<const char*> pos;
+		const char* chunk1 = "abc 123 de", *chunk2 = "f;";
+		[[maybe_unused]] bool more;
+		tok.feed(chunk1, 10);
+		more = tok.MoveNext(pos);
+		assert(more && pos.kind == 'x' && pos.begin() == chunk1 && pos.size() == 3);
+		more = tok.MoveNext(pos);
+		assert(more && pos.kind == 'i' && pos.begin() == chunk1 + 4);
+		more = tok.MoveNext(pos);
+		assert(!more);
+		assert(tok.bytes_copied() == 0);
+		tok.feed(chunk2, 2);
+		more = tok.MoveNext(pos);
+		assert(more && pos.kind == 'x' && std::string(pos.begin(), pos.end()) == "def" && pos.data.offset == 8);
+		assert(tok.bytes_copied() == 3);
+		more = tok.MoveNext(pos);
+		assert(!more);  // The ; could be longer
+		tok.finish();
+		more = tok.MoveNext(pos);
+		assert(more && pos.kind == ';' && pos.begin() == chunk2 + 1);
+		more = tok.MoveNext(pos);
+		assert(more && pos.kind == -1);
+	}
+
+	void TestLineIndex()
+	{
+		// Empty input, and offsets at the ends of lines
+		line_index empty("", 0);
+		assert(empty.number_of_lines() == 1 && empty.position(0) == source_position(1, 1));
+
+		std::string input = "ab\n\ncd\r\n";
+		line_index lines(input.data(), input.size());
+		assert(lines.number_of_lines() == 4);
+		assert(lines.line_start(2) == 3 && lines.line_start(4) == 8);
+		assert(lines.position(2) == source_position(1, 3));
+		assert(lines.position(3) == source_position(2, 1));
+		assert(lines.position(6) == source_position(3, 3));  // The \r
+		assert(lines.position(8) == source_position(4, 1));
+
+		// Tabs and UTF-8
+		input = "\tx\n a\tb\n\xc3\xa9\xe2\x82\xacz";
+		line_index tabs(input.data(), input.size(), 4);
+		assert(tabs.position(1) == source_position(1, 5));
+		assert(tabs.position(5) == source_position(2, 3));
+		assert(tabs.position(6) == source_position(2, 5));
+		assert(tabs.position(13) == source_position(3, 3));
+		assert(line_index(input.data(), input.size()).position(6) == source_position(2, 4));
+
+		// The same line starts with each instruction set, where the newlines cross the 16 and 32 byte blocks
+		std::mt19937 rng;
+		input.clear();
+		for (int i = 0; i < 1000; ++i)
+			input += std::string(rng() % 40, 'a') + "\n";
+
+		std::vector<std::size_t> expected;
+		for (std::size_t i = 0; i < input.size(); ++i)
+			if (input[i] == '\n') expected.push_back(i + 1);
+
+		lexer_simd original = get_lexer_simd();
+		for (lexer_simd simd : { lexer_scalar, lexer_sse2, lexer_avx2 })
+		{
+			set_lexer_simd(simd);
+			for (std::size_t start : { 0, 1, 7, 31 })
+			{
+				std::vector<std::size_t> starts;
+				scan_newlines(input.data() + start, input.data() + input.size(), starts);
+				std::vector<std::size_t> shifted;
+				for (std::size_t e : expected)
+					if (e > start) shifted.push_back(e - start);
+				assert(starts == shifted);
+			}
+		}
+		set_lexer_simd(original);
+
+		// Agrees with counting the characters
+		line_index random(input.data(), input.size());
+		unsigned row = 1, column = 1;
+		for (std::size_t i = 0; i <= input.size(); ++i)
+		{
+			assert(random.position(i) == source_position(row, column));
+			if (i < input.size() && input[i] == '\n')
+				++row, column = 1;
+			else
+				++column;
+		}
+	}
+}
+
+namespace Runtime
+{
+	using namespace slurp;
+
+	// The grammar LR::Expr, constructed at runtime.
+	runtime_grammar::symbol ExprGrammar(runtime_grammar& g)
+	{
+		auto digit = g.token('d'), plus = g.token('+'), open = g.token('('), close = g.token(')');
+
+		auto list = g.declare();
+		g.define(list, g.rules({ g.rule('e', {}), g.rule('l', { plus, list }) }));
+
+		auto expr = g.declare();
+		auto primary = g.declare();
+		g.define(primary, g.rules({
+			digit,
+			g.rule('b', { open, expr, close }),
+			g.rule('L', { open, open, list, close, close }) }));
+		g.define(expr, g.rules({ primary, g.rule('+', { primary, plus, expr }) }));
+		return expr;
+	}
+
+	template<typename Tables>
+	void CompareWithLR(const Tables& tables, const std::string& input)
+	{
+		lr_parser<Tables, null_tokenizer, std::string::const_iterator> parser(tables);
+		auto p = parser.parse(input.begin(), input.end());
+		auto q = lr_parse<LR::Expr>(null_tokenizer(), input.begin(), input.end());
+
+		assert(bool(p) == bool(q));
+		assert(!p || LR::SameTree(p.root(), q.root()));
+	}
+
+	template<typename Tables>
+	void TestTables(const Tables& tables)
+	{
+		CompareWithLR(tables, "d+(d+d)+((++))");
+		CompareWithLR(tables, "((d))");
+		CompareWithLR(tables, "(());");
+		CompareWithLR(tables, "d+");
+	}
+
+	void TestRuntimeGrammar()
+	{
+		runtime_grammar g;
+		auto expr = ExprGrammar(g);
+
+		runtime_flat_grammar flat = g.flatten(expr);
+		[[maybe_unused]] typedef lalr_tables<LR::Expr> tables;
+		assert(flat.number_of_symbols == tables::number_of_symbols);
+		assert(flat.number_of_terminals == tables::number_of_terminals);
+		assert(flat.number_of_productions() == tables::number_of_rules);
+
+		runtime_tables rt(flat);
+		assert(rt.conflicts == 0);
+		assert(rt.number_of_states == tables::number_of_states);
+		TestTables(rt.view());
+
+		// Tables are written to a file and mapped
+		std::string path = LR::TempPath("slurp-test-tables.bin");
+		std::remove(path.c_str());
+
+		bool rebuilt = false;
+		{
+			mapped_tables file = load_tables(g, expr, path, &rebuilt);
+			assert(rebuilt);
+			assert(file.mapped());
+			assert(file.header().grammar_hash == flat.hash());
+			TestTables(file.view());
+		}
+
+		// The second load uses the file
+		{
+			mapped_tables file = load_tables(g, expr, path, &rebuilt);
+			assert(!rebuilt);
+			assert(file.mapped());
+			TestTables(file.view());
+		}
+
+		// A different grammar rebuilds the file
+		{
+			runtime_grammar g2;
+			auto digit = g2.token('d');
+			auto integer = g2.declare();
+			g2.define(integer, g2.rules({ digit, g2.rule('i', { digit, integer }) }));
+
+			mapped_tables file = load_tables(g2, integer, path, &rebuilt);
+			assert(rebuilt);
+			std::string input = "ddd";
+			auto p = lr_parser<lr_table_view, null_tokenizer, std::string::const_iterator>(file.view()).parse(input.begin(), input.end());
+			assert(p);
+			assert(p.root() == 'i');
+		}
+
+		// Invalid files are rejected
+		{
+			std::FILE* f = std::fopen(path.c_str(), "wb");
+			std::fputs("not a table file", f);
+			std::fclose(f);
+			mapped_tables file;
+			assert(!file.open(path));
+		}
+
+		std::remove(path.c_str());
+
+		// Tables that would make the parser read outside them are rejected
+		std::vector<char> image = table_file_image(rt);
+		{
+			mapped_tables tables;
+			assert(tables.assign(image));
+		}
+
+		[[maybe_unused]] auto corrupt = [&](auto change) {
+			std::vector<char> copy = image;
+			table_file_header& h = *(table_file_header*)copy.data();
+			lr_action* actions = (lr_action*)(copy.data() + sizeof h);
+			lr_rule* rules = (lr_rule*)(actions + h.number_of_states * h.number_of_symbols);
+			change(h, actions, rules);
+			mapped_tables tables;
+			return !tables.assign(copy);
+		};
+		assert(corrupt([](table_file_header& h, lr_action*, lr_rule*) { h.byte_order = 0x04030201; }));
+		assert(corrupt([](table_file_header& h, lr_action*, lr_rule*) { h.number_of_states = 0; }));
+		assert(corrupt([](table_file_header& h, lr_action*, lr_rule*) { h.number_of_terminals = h.number_of_symbols + 1; }));
+		assert(corrupt([](table_file_header& h, lr_action*, lr_rule*) { h.number_of_states = h.number_of_symbols = 0x7fffffff; }));
+		assert(corrupt([](table_file_header& h, lr_action* actions, lr_rule*) {
+			for (int x = 0; x < h.number_of_terminals; ++x)
+				if (actions[x].action == lr_shift) actions[x].value = h.number_of_states;
+		}));
+		assert(corrupt([](table_file_header& h, lr_action*, lr_rule* rules) { rules[h.number_of_rules - 1].symbol = 0; }));
+		assert(corrupt([](table_file_header& h, lr_action*, lr_rule* rules) { rules[h.number_of_rules - 1].length = 1000; }));
+	}
+
+	// Checks that compressed tables have the same actions, apart from default reductions and fused shifts.
+	template<typename Tables>
+	void CheckCompression(const Tables& dense, const compressed_tables& compressed)
+	{
+		for (int s = 0; s < dense.number_of_states; ++s)
+		{
+			for (int x = 0; x < dense.number_of_symbols; ++x)
+			{
+				lr_action a = dense.action(s, x), b = compressed.action(s, x);
+				if (a.action == lr_error)
+					assert(b.action == lr_error || b.action == lr_reduce || x >= dense.number_of_terminals);
+				else if (b.action == lr_shift_reduce)
+					assert(a.action == lr_shift && compressed.action(a.state(), 0).action == lr_reduce && compressed.action(a.state(), 0).rule() == b.rule());
+				else
+					assert(a == b);
+			}
+		}
+	}
+
+	void TestCompressedTables()
+	{
+		runtime_grammar g;
+		runtime_tables dense(g.flatten(ExprGrammar(g)));
+		compressed_tables compressed(dense);
+		CheckCompression(dense, compressed);
+		assert(compressed.fused_shifts > 0);
+		assert(compressed.size() < dense.actions.size() * sizeof(lr_action));
+		TestTables(compressed.view());
+
+		typedef lalr_tables<LR::Expr> tables;
+		compressed_tables compressed2((tables()));
+		CheckCompression(tables(), compressed2);
+		TestTables(compressed2.view());
+	}
+
+	// The tokens of LR::Runs, constructed at runtime.
+	void RunsLexer(runtime_lexer& lx)
+	{
+		auto letter = lx.rules({ lx.range('a', 'z'), lx.ch('_') });
+		lx.token('x', lx.seq({ letter, lx.star(lx.rules({ letter, lx.range('0', '9') })) }));
+		lx.token('i', lx.plus(lx.range('0', '9')));
+		lx.token(';', lx.ch(';'));
+		lx.skip(lx.plus(lx.ch(' ')));
+	}
+
+	void TestLazyTokenizer()
+	{
+		runtime_lexer lx;
+		RunsLexer(lx);
+
+		std::mt19937 rng;
+		std::string input;
+		for (int i = 0; i < 2000; ++i)
+			input += "ab_19; x!"[rng() % 9];
+
+		lazy_tokenizer tok(lx);
+		LR::Runs::tokenizer expected_tok;
+		auto expected = LR::Pathological::Tokens(expected_tok, input.begin(), input.end());
+		assert(LR::Pathological::Tokens(tok, input.begin(), input.end()) == expected);
+		assert(tok.flushes() == 0);
+
+		// States are reused
+		[[maybe_unused]] int states = tok.number_of_states();
+		assert(LR::Pathological::Tokens(tok, input.begin(), input.end()) == expected);
+		assert(tok.number_of_states() == states);
+
+		// A small state table is flushed, but gives the same tokens
+		lazy_tokenizer small(lx, 2);
+		assert(LR::Pathological::Tokens(small, input.begin(), input.end()) == expected);
+		assert(small.flushes() > 0);
+		assert(small.number_of_states() <= 2);
+
+		// Keywords win over identifiers, and wide characters have classes
+		runtime_lexer keywords;
+		auto letter = keywords.range('a', 'z');
+		keywords.token('f', keywords.seq({ keywords.ch('f'), keywords.ch('o'), keywords.ch('r') }));
+		keywords.token('x', keywords.plus(letter));
+		keywords.token('g', keywords.plus(keywords.range(0x3b1, 0x3c9)));
+
+		std::wstring text = L"for format \x3b1\x3b2" L"fo";
+		lazy_tokenizer keyword_tok(keywords);
+		auto tokens = LR::Pathological::Tokens(keyword_tok, text.begin(), text.end());
+		std::vector<std::pair<int, int>> expected_tokens = { { 'f', 3 }, { lexer_error, 1 }, { 'x', 6 }, { lexer_error, 1 }, { 'g', 2 }, { 'x', 2 } };
+		assert(tokens == expected_tokens);
+	}
+
+}
+
 struct Test
 {
 	typedef Test member;
@@ -387,7 +1796,7 @@ template<typename T>
 struct foo
 {
 	static void parse() {
-		return foo<T::member>::parse();
+		return foo<typename T::member>::parse();
 	}
 };
 
@@ -399,6 +1808,23 @@ int main()
 	ManualTableExample::examplelr();
 	TestStack();
 	PrintStuff();
+	LR::TestDirectLR();
+	LR::TestLRParser();
+	LR::TestParseActions();
+	LR::TestTreeFile();
+	LR::TestCompactTree();
+	LR::TestTreeCursor();
+	LR::TestPackedNodes();
+	LR::TestParallelFold();
+	LR::TestDFATokenizer();
+	LR::TestLexerRuns();
+	LR::TestLinearTokenizer();
+	LR::TestChunkedTokenizer();
+	LR::TestLineIndex();
+	Runtime::TestRuntimeGrammar();
+	Runtime::TestCompressedTables();
+	Runtime::TestLazyTokenizer();
+	LR::TestPackrat();
 	RD::TestRecursiveDescent();
 	std::cout << "Hello CMake." << std::endl;
 	return 0;
@@ -1,9 +1,27 @@
 #include "Stack.hpp"
+#include "tree_cursor.hpp"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <utility>
 
-slurp::Stack::Stack()
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define SLURP_MMAP
+#include <sys/mman.h>
+#endif
+
+slurp::Stack::Stack(const stack_options& options) : options(options), data(options)
+{
+	if (options.encoding == packed_nodes)
+		this->options.text = reference_text;
+}
+
+slurp::Stack::Stack(stack_buffer&& bytes, const stack_options& options) : options(options), data(std::move(bytes))
 {
-	data.reserve(2048);
 }
 
 slurp::Stack::~Stack()
@@ -12,17 +30,19 @@ slurp::Stack::~Stack()
 
 const slurp::Node& slurp::Stack::Root() const
 {
-	return *((const Node*)((const char*)&data[0] + data.size()) - 1);
+	assert(options.encoding == fixed_nodes);
+	return *((const Node*)(data.data() + data.size()) - 1);
 }
 
 slurp::Node& slurp::Stack::Root()
 {
-	return *((Node*)((char*)&data[0] + data.size()) - 1);
+	assert(options.encoding == fixed_nodes);
+	return *((Node*)(data.data() + data.size()) - 1);
 }
 
 inline void slurp::Stack::Append(const void* d, size_type s)
 {
-	data.insert(data.end(), (const char*)d, (const char*)d + s);
+	data.append(d, s);
 }
 
 inline void slurp::Stack::Append(size_type s)
@@ -32,60 +52,178 @@ inline void slurp::Stack::Append(size_type s)
 
 wchar_t *slurp::Stack::Shift(short kind, const TokenData& td, unsigned length)
 {
+	if (options.node_starts)
+		starts.push_back(Top());
+
+	if (options.encoding == packed_nodes)
+	{
+		ShiftPacked(kind, td, length);
+		return nullptr;
+	}
+
+	if (options.text == reference_text)
+	{
+		// The length is of this token, which is 0 for a node with no children
+		TokenData reference = td;
+		reference.length = length;
+		Append(&reference, sizeof(TokenData));
+		Node node(kind, 0, sizeof(TokenData) + sizeof(Node));
+		Append(&node, sizeof(Node));
+		return nullptr;
+	}
+
 	unsigned newSize = (length+1)*sizeof(wchar_t) + sizeof(TokenData) + sizeof(Node);
-	data.reserve(data.size() + newSize);
 
 	Append(&td, sizeof(TokenData));
 	auto pos = data.size();
 	Append((length+1)*sizeof(wchar_t));
 	Node node(kind, 0, newSize);
 	Append(&node, sizeof(Node));
-	return (wchar_t*)(&data[pos]);
+
+	wchar_t* text = (wchar_t*)(data.data() + pos);
+	text[length] = 0;
+	return text;
 }
 
 
 void slurp::Stack::Reduce(short kind, unsigned short numberOfChildren)
 {
 	assert(numberOfChildren > 0);
+	assert(numberOfChildren <= Node::max_children);
 
-	size_type totalSize = sizeof(Node);
-	const Node* child = &Root();
+	if (options.encoding == packed_nodes)
+	{
+		ReducePacked(kind, numberOfChildren);
+		return;
+	}
+
+	// The child table goes after the last child, and the offsets are from the new node
+	size_type top = Top(), tableSize = options.child_table ? numberOfChildren * sizeof(unsigned) : 0;
+	if (tableSize) Append(tableSize);
+	unsigned* offsets = tableSize ? (unsigned*)(data.data() + top) : nullptr;
+	size_type nodePosition = top + tableSize;
 
-	for (int i = 0; i < numberOfChildren;
-		++i, child = child->NextChild())
+	// Find the start of the first child
+	size_type start;
+	if (options.node_starts)
+	{
+		// Each child ends where the next one starts, so the children are not read
+		assert(numberOfChildren <= starts.size());
+		const size_type* child = &starts[starts.size() - numberOfChildren];
+		start = child[0];
+		if (offsets)
+			for (int i = 0; i < numberOfChildren; ++i)
+				offsets[i] = nodePosition - ((i + 1 < numberOfChildren ? child[i + 1] : top) - sizeof(Node));
+
+		// The new node starts at its first child
+		starts.resize(starts.size() - numberOfChildren + 1);
+	}
+	else
 	{
-		totalSize += child->length;
+		size_type child = top - sizeof(Node);
+		for (int i = numberOfChildren - 1; i >= 0; --i)
+		{
+			if (offsets) offsets[i] = nodePosition - child;
+			child -= ((const Node*)(data.data() + child))->length;
+		}
+		start = child + sizeof(Node);
 	}
 
-	Node node(kind, numberOfChildren, totalSize);
+	Node node(kind, numberOfChildren | (tableSize ? Node::child_table_flag : 0), nodePosition + sizeof(Node) - start);
 	Append(&node, sizeof(Node));
 }
 
-void slurp::Stack::DumpTree() const
+void slurp::Stack::ShiftPacked(short kind, const TokenData& td, unsigned length)
 {
-	if (data.empty())
+	// The fields are written in the reverse of the order that packed_node reads them
+	char fields[4 * 5];
+	char* p = fields;
+	p = helpers::write_back_varint(p, td.offset);
+	p = helpers::write_back_varint(p, length);
+	p = helpers::write_back_varint(p, 1);
+	p = helpers::write_back_varint(p, (std::uint16_t)kind);
+	Append(fields, (size_type)(p - fields));
+}
+
+void slurp::Stack::ReducePacked(short kind, unsigned short numberOfChildren)
+{
+	size_type top = Top(), start;
+	if (options.node_starts)
 	{
-		std::cout << "<empty>\n";
-		return;
+		assert(numberOfChildren <= starts.size());
+		start = starts[starts.size() - numberOfChildren];
+		starts.resize(starts.size() - numberOfChildren + 1);
+	}
+	else
+	{
+		packed_node child(data.data() + top);
+		for (int i = 1; i < numberOfChildren; ++i)
+			child = child.NextChild();
+		start = (size_type)(child.begin() - data.data());
 	}
 
-	DumpTree(Root(), 0);
+	char fields[3 * 5];
+	char* p = fields;
+	p = helpers::write_back_varint(p, top - start);
+	p = helpers::write_back_varint(p, std::uint32_t(numberOfChildren) << 2);
+	p = helpers::write_back_varint(p, (std::uint16_t)kind);
+	Append(fields, (size_type)(p - fields));
 }
 
-void slurp::Stack::DumpTree(const Node& node, int indent)
+void slurp::Stack::DumpTree() const
 {
-	if (node.IsToken())
+	if (data.empty())
 	{
-		for (int i = 0; i < indent; ++i) std::cout << ' ';
-		std::wcout << node.Kind << ": " << node.WText() << std::endl;
+		std::cout << "<empty>\n";
+		return;
 	}
-	else
+
+	if (options.encoding == packed_nodes)
 	{
-		for (int i = 0; i < indent; ++i) std::cout << ' ';
-		std::cout << node.Kind << ":" << std::endl;
-		for (int i = 0; i < node.size(); ++i)
-			DumpTree(node[i], indent + 2);
+		// As walk_tree, with the nodes still to print and their depths
+		std::vector<std::pair<packed_node, std::size_t>> pending = { std::make_pair(PackedRoot(), std::size_t(0)) };
+		while (!pending.empty())
+		{
+			packed_node node = pending.back().first;
+			std::size_t depth = pending.back().second;
+			pending.pop_back();
+
+			for (std::size_t i = 0; i < 2 * depth; ++i) std::cout << ' ';
+			if (node.IsToken())
+			{
+				std::cout << node.Kind << ": @" << node.GetToken()->offset << "+" << node.GetToken()->length << std::endl;
+				continue;
+			}
+
+			std::cout << node.Kind << ":" << std::endl;
+			packed_node child = node.FirstChild();
+			for (int i = 0; i < node.size(); ++i)
+			{
+				pending.push_back(std::make_pair(child, depth + 1));
+				if (i + 1 < node.size()) child = child.NextChild();
+			}
+		}
+		return;
 	}
+
+	// Without recursion, so that deep trees can be dumped
+	walk_tree(Root(), [](const Node& node, std::size_t depth) {
+		for (std::size_t i = 0; i < 2 * depth; ++i) std::cout << ' ';
+		if (!node.IsToken())
+			std::cout << node.Kind << ":" << std::endl;
+		else if (node.HasText())
+			std::wcout << node.Kind << ": " << node.WText() << std::endl;
+		else
+			std::cout << node.Kind << ": @" << node.GetToken()->offset << "+" << node.GetToken()->length << std::endl;
+		return walk_children;
+	});
+}
+
+void slurp::Stack::ShiftNode(const char* node, size_type length)
+{
+	if (options.node_starts)
+		starts.push_back(Top());
+	Append(node, length);
 }
 
 unsigned slurp::Stack::Top() const
@@ -93,12 +231,237 @@ unsigned slurp::Stack::Top() const
 	return (unsigned)data.size();
 }
 
+void slurp::Stack::ShrinkToFit()
+{
+	data.shrink_to_fit();
+	starts.shrink_to_fit();
+}
+
 void slurp::Stack::Unwind(unsigned size)
 {
 	data.resize(size);
+	while (!starts.empty() && starts.back() >= size)
+		starts.pop_back();
 }
 
 bool slurp::Stack::Empty() const
 {
 	return data.empty();
 }
+
+slurp::stack_buffer::stack_buffer(const stack_options& options) :
+	bytes(nullptr), used(0), allocated(0), storage(options.storage), resource(options.resource), reserve(options.reserve), huge_pages(options.huge_pages), mapping(nullptr)
+{
+	if (storage == file_storage)
+		storage = heap_storage;
+
+	if (storage == resource_storage && !resource)
+		resource = std::pmr::get_default_resource();
+
+	// The reservation doubles when the stack outgrows it, so this only needs to cover most inputs
+	if (!reserve)
+		reserve = sizeof(void*) >= 8 ? std::size_t(1) << 26 : std::size_t(1) << 24;
+
+#if !defined(_WIN32) && !defined(SLURP_MMAP)
+	if (storage == mapped_storage)
+		storage = heap_storage;
+#endif
+}
+
+slurp::stack_buffer::stack_buffer(void* mapping, std::size_t mapping_size, std::size_t offset, std::size_t size) :
+	bytes((char*)mapping + offset), used(size), allocated(size), storage(file_storage), resource(nullptr), reserve(mapping_size), huge_pages(false), mapping(mapping)
+{
+}
+
+slurp::stack_buffer::stack_buffer(const stack_buffer& other) :
+	bytes(nullptr), used(0), allocated(0), storage(other.storage == file_storage ? heap_storage : other.storage),
+	resource(other.resource), reserve(other.used), huge_pages(other.huge_pages), mapping(nullptr)
+{
+	// A copy of mapped_storage only reserves the bytes that it copies, and grows if it is appended to
+	append(other.bytes, other.used);
+}
+
+slurp::stack_buffer::stack_buffer(stack_buffer&& other) noexcept :
+	bytes(other.bytes), used(other.used), allocated(other.allocated), storage(other.storage), resource(other.resource), reserve(other.reserve), huge_pages(other.huge_pages), mapping(other.mapping)
+{
+	other.bytes = nullptr;
+	other.mapping = nullptr;
+	other.used = other.allocated = 0;
+}
+
+slurp::stack_buffer& slurp::stack_buffer::operator=(stack_buffer other) noexcept
+{
+	std::swap(bytes, other.bytes);
+	std::swap(used, other.used);
+	std::swap(allocated, other.allocated);
+	std::swap(storage, other.storage);
+	std::swap(resource, other.resource);
+	std::swap(reserve, other.reserve);
+	std::swap(huge_pages, other.huge_pages);
+	std::swap(mapping, other.mapping);
+	return *this;
+}
+
+slurp::stack_buffer::~stack_buffer()
+{
+	release();
+}
+
+void slurp::stack_buffer::release()
+{
+	if (!bytes) return;
+
+	switch (storage)
+	{
+	case heap_storage:
+		std::free(bytes);
+		break;
+	case resource_storage:
+		resource->deallocate(bytes, allocated);
+		break;
+	case mapped_storage:
+#if defined(_WIN32)
+		VirtualFree(bytes, 0, MEM_RELEASE);
+#elif defined(SLURP_MMAP)
+		munmap(bytes, reserve);
+#endif
+		break;
+	case file_storage:
+#if defined(_WIN32)
+		UnmapViewOfFile(mapping);
+#elif defined(SLURP_MMAP)
+		munmap(mapping, reserve);
+#endif
+		mapping = nullptr;
+		break;
+	}
+	bytes = nullptr;
+	used = allocated = 0;
+}
+
+void slurp::stack_buffer::shrink_to_fit()
+{
+	if (used == allocated) return;
+	if (!used)
+	{
+		release();
+		return;
+	}
+
+	switch (storage)
+	{
+	case heap_storage:
+		if (void* b = std::realloc(bytes, used))
+		{
+			bytes = (char*)b;
+			allocated = used;
+		}
+		break;
+	case resource_storage:
+	{
+		char* b = (char*)resource->allocate(used);
+		std::memcpy(b, bytes, used);
+		resource->deallocate(bytes, allocated);
+		bytes = b;
+		allocated = used;
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void slurp::stack_buffer::grow(std::size_t size)
+{
+	std::size_t capacity = std::max<std::size_t>({ size, allocated * 2, 2048 });
+
+	switch (storage)
+	{
+	case heap_storage:
+	{
+		void* b = std::realloc(bytes, capacity);
+		if (!b) throw std::bad_alloc();
+		bytes = (char*)b;
+		break;
+	}
+	case file_storage:
+	{
+		// Copy the tree to the heap
+		char* b = (char*)std::malloc(capacity);
+		if (!b) throw std::bad_alloc();
+		std::size_t length = used;
+		std::memcpy(b, bytes, length);
+		release();
+		bytes = b;
+		used = length;
+		storage = heap_storage;
+		break;
+	}
+	case resource_storage:
+	{
+		char* b = (char*)resource->allocate(capacity);
+		if (used) std::memcpy(b, bytes, used);
+		if (bytes) resource->deallocate(bytes, allocated);
+		bytes = b;
+		break;
+	}
+	case mapped_storage:
+#if defined(_WIN32)
+		if (size > reserve)
+		{
+			// Start again with a larger reservation
+			stack_options options;
+			options.storage = mapped_storage;
+			options.reserve = std::max(size, reserve * 2);
+			options.huge_pages = huge_pages;
+			stack_buffer larger(options);
+			larger.append(bytes, used);
+			*this = std::move(larger);
+			return;
+		}
+
+		if (!bytes)
+		{
+			bytes = (char*)VirtualAlloc(nullptr, reserve, MEM_RESERVE, PAGE_READWRITE);
+			if (!bytes) throw std::bad_alloc();
+		}
+
+		// Commit pages as they are needed
+		capacity = std::min(std::max(capacity, std::size_t(1) << 16), reserve);
+		if (!VirtualAlloc(bytes, capacity, MEM_COMMIT, PAGE_READWRITE)) throw std::bad_alloc();
+#elif defined(SLURP_MMAP)
+		if (bytes)
+		{
+			// Beyond the reservation
+			std::size_t larger = std::max(size, reserve * 2);
+#if defined(__linux__)
+			void* b = mremap(bytes, reserve, larger, MREMAP_MAYMOVE);
+			if (b == MAP_FAILED) throw std::bad_alloc();
+#else
+			void* b = mmap(nullptr, larger, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+			if (b == MAP_FAILED) throw std::bad_alloc();
+			std::memcpy(b, bytes, used);
+			munmap(bytes, reserve);
+#endif
+			bytes = (char*)b;
+			reserve = larger;
+		}
+		else
+		{
+			// The pages are not used until they are written
+			reserve = std::max(size, reserve);
+			void* b = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+			if (b == MAP_FAILED) throw std::bad_alloc();
+			bytes = (char*)b;
+		}
+#if defined(MADV_HUGEPAGE)
+		if (huge_pages)
+			madvise(bytes, reserve, MADV_HUGEPAGE);
+#endif
+		capacity = reserve;
+#endif
+		break;
+	}
+
+	allocated = capacity;
+}
@@ -1,4 +1,7 @@
 #include "Node.h"
+#include "packed_node.hpp"
+#include <cstring>
+#include <memory_resource>
 #include <vector>
 
 namespace slurp
@@ -21,14 +24,142 @@ namespace slurp
 		- Shift appends a token node to the end of the stack.
 		- Reduce appends a node to the end of the stack.
 		Neither operation requires data to be moved within the stack.
+
+		By default, Shift copies the text of each token into the stack as wchar_t, so the tree
+		does not depend on the input. With reference_text, a token only stores its TokenData,
+		and Node::Text(source) gives the text from the source, which must outlive the tree.
+		This needs the tokenizer to set the offset and length of the tokens.
+	*/
+	enum token_text { copy_text, reference_text };
+
+	/*
+		Where a Stack keeps its bytes. The nodes refer to their children by relative offsets,
+		so the bytes must be contiguous, but they need not be copied as the stack grows:
+
+		- heap_storage uses realloc, which for large stacks can grow by remapping pages instead of copying.
+		- resource_storage uses a std::pmr::memory_resource, for example an arena for many small parses.
+		  The bytes are copied when the stack grows.
+		- mapped_storage reserves address space up front (stack_options::reserve), and the pages are only
+		  used when they are written, so peak memory is the size of the tree. The bytes do not move
+		  until the stack outgrows the reservation, which then doubles (with mremap on Linux, which
+		  moves the pages without copying them). Optionally, it asks for transparent huge pages.
+		- file_storage is a copy-on-write mapping of a tree file (see tree_file.hpp), which is copied
+		  to the heap if the stack grows.
 	*/
+	enum stack_storage { heap_storage, resource_storage, mapped_storage, file_storage };
+
+	/*
+		How a Stack encodes its nodes:
+
+		- fixed_nodes are Node, with 8 bytes per node and a TokenData per token.
+		- packed_nodes are packed_node, with varint fields, for trees that are larger than memory
+		  or walked at memory bandwidth. The tokens reference the source (as with reference_text),
+		  and there are no child tables. The tree is read with Stack::PackedRoot() instead of Root().
+	*/
+	enum node_encoding { fixed_nodes, packed_nodes };
+
+	// How a Stack stores the tree.
+	struct stack_options
+	{
+		stack_options(token_text text = copy_text) : text(text), child_table(false), node_starts(false),
+			storage(heap_storage), resource(nullptr), reserve(0), huge_pages(false), encoding(fixed_nodes)
+		{
+		}
+
+		token_text text;
+
+		// Whether Reduce writes a table of the offsets of the children of each node,
+		// so that Node::operator[] is constant time, at 4 bytes per child.
+		bool child_table;
+
+		// Whether the Stack keeps the start of each node that has not been reduced (see NodeStarts),
+		// so that Reduce does not need to read the children.
+		bool node_starts;
+
+		stack_storage storage;
+
+		// The memory resource of resource_storage, or nullptr for the default resource.
+		std::pmr::memory_resource* resource;
+
+		// The address space that mapped_storage reserves, or 0 for a default of 64 MB (16 MB on a
+		// 32-bit system). A larger stack is remapped, so set this from the size of the input to
+		// avoid remapping a large tree.
+		std::size_t reserve;
+
+		// Whether mapped_storage asks for transparent huge pages.
+		bool huge_pages;
+
+		node_encoding encoding;
+	};
+
+	// The bytes of a Stack, which are allocated according to the stack_options.
+	class stack_buffer
+	{
+	public:
+		explicit stack_buffer(const stack_options& options);
+
+		// Uses size bytes at offset in a copy-on-write mapping of a file, which the buffer unmaps.
+		stack_buffer(void* mapping, std::size_t mapping_size, std::size_t offset, std::size_t size);
+		stack_buffer(const stack_buffer& other);
+		stack_buffer(stack_buffer&& other) noexcept;
+		stack_buffer& operator=(stack_buffer other) noexcept;
+		~stack_buffer();
+
+		char* data() { return bytes; }
+		const char* data() const { return bytes; }
+		std::size_t size() const { return used; }
+		std::size_t capacity() const { return allocated; }
+		bool empty() const { return used == 0; }
+
+		// Resizes the buffer, where any new bytes are uninitialised.
+		void resize(std::size_t size)
+		{
+			if (size > allocated) grow(size);
+			used = size;
+		}
+
+		// Releases the unused capacity of heap_storage and resource_storage.
+		// The other storages only use the pages that have been written.
+		void shrink_to_fit();
+
+		void append(const void* src, std::size_t length)
+		{
+			std::size_t at = used;
+			resize(used + length);
+			std::memcpy(bytes + at, src, length);
+		}
+
+	private:
+		char* bytes;
+		std::size_t used, allocated;
+		stack_storage storage;
+		std::pmr::memory_resource* resource;
+		std::size_t reserve;
+		bool huge_pages;
+		void* mapping;
+
+		void grow(std::size_t size);
+		void release();
+	};
+
 	class Stack
 	{
 
 	public:
-		Stack();
+		Stack(const stack_options& options = stack_options());
+
+		// Uses the bytes of a tree, for example from a tree file, which was built with the given options.
+		explicit Stack(stack_buffer&& bytes, const stack_options& options = stack_options());
+		Stack(const Stack&) = default;
+		Stack(Stack&&) = default;
+		Stack& operator=(const Stack&) = default;
+		Stack& operator=(Stack&&) = default;
 		~Stack();
 
+		token_text text_mode() const { return options.text; }
+
+		const stack_options& get_options() const { return options; }
+
 		/*
 			Gets the root of the parse tree.
 			If the parse tree is empty then this is undefined.
@@ -37,9 +168,12 @@ namespace slurp
 
 		Node& Root();
 
+		// Gets the root of a parse tree with packed_nodes.
+		packed_node PackedRoot() const { return packed_node(data.data() + data.size()); }
+
 		/*
 			Reduces the last n nodes on the stack into a single node.
-			The new node has kind "kind".
+			The new node has kind "kind", and a child table if the options have child_table.
 			Ensure that there are enough nodes on the stack prior to this call
 			otherwise the result is undefined.
 		*/
@@ -53,10 +187,12 @@ namespace slurp
 		void Shift(short kind, const TokenData& data, It start, It end)
 		{
 			wchar_t * text = Shift(kind, data, (unsigned)(end - start));
-			for (It s = start; s != end; ++s)
-				*text++ = *s;
+			if (text)
+				for (It s = start; s != end; ++s)
+					*text++ = *s;
 		}
 
+		// Returns the space for the text of the token, or nullptr with reference_text.
 		wchar_t *Shift(short kind, const TokenData& data, unsigned length);
 
 		void DumpTree() const;
@@ -64,16 +200,36 @@ namespace slurp
 
 		size_type Top() const;
 
+		// The bytes of the stack, of which there are Top().
+		const char* Data() const { return data.data(); }
+
+		// Releases the spare capacity of the stack, for example once the tree is complete.
+		// See also compact_tree.
+		void ShrinkToFit();
+
 		// Unwinds the stack to a position previously given by Top();
 		void Unwind(size_type position);
 
+		// Pushes a copy of a node and its subtree, of length bytes, from the Data() of a Stack with the same options.
+		void ShiftNode(const char* node, size_type length);
+
+		/*
+			With node_starts, the positions in the stack where the nodes that have not yet been
+			reduced start, in order. The children of Reduce(kind, n) are the last n of these,
+			and each child ends where the next one starts.
+		*/
+		const std::vector<size_type>& NodeStarts() const { return starts; }
+
 		bool Empty() const;
 
 	private:
 		void Append(const void* src, size_type length);
 		void Append(size_type length);
-		static void DumpTree(const Node& node, int indent);
+		void ShiftPacked(short kind, const TokenData& data, unsigned length);
+		void ReducePacked(short kind, unsigned short numberOfChildren);
 
-		std::vector<char> data;
+		stack_options options;
+		stack_buffer data;
+		std::vector<size_type> starts;
 	};
 }
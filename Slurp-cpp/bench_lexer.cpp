@@ -0,0 +1,274 @@
+// Measures the generated and lazy DFA tokenizers on source-like text.
+
+#include "slurp.hpp"
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+using namespace slurp;
+
+namespace
+{
+	typedef Rules<Range<'a', 'z'>, Range<'A', 'Z'>, Ch<'_'>> Letter;
+	typedef Range<'0', '9'> Digit;
+
+	struct Identifier
+	{
+		typedef Rules<Letter, Seq<Identifier, Letter>, Seq<Identifier, Digit>> rule;
+	};
+
+	struct Integer
+	{
+		typedef Rules<Digit, Seq<Integer, Digit>> rule;
+	};
+
+	struct Spaces
+	{
+		typedef Rules<Ch<' '>, Ch<'\t'>, Ch<'\n'>, Seq<Spaces, Rules<Ch<' '>, Ch<'\t'>, Ch<'\n'>>>> rule;
+	};
+
+	typedef typeset<
+		Token<'w', Seq<Ch<'w'>, Ch<'h'>, Ch<'i'>, Ch<'l'>, Ch<'e'>>>,
+		Token<'r', Seq<Ch<'r'>, Ch<'e'>, Ch<'t'>, Ch<'u'>, Ch<'r'>, Ch<'n'>>>,
+		Token<'x', Identifier>,
+		Token<'i', Integer>,
+		Token<'=', Ch<'='>>,
+		Token<'e', Seq<Ch<'='>, Ch<'='>>>,
+		Token<'+', Ch<'+'>>,
+		Token<'(', Ch<'('>>,
+		Token<')', Ch<')'>>,
+		Token<';', Ch<';'>>
+	> tokens;
+
+	typedef dfa_tokenizer<tokens, typeset<Spaces>> tokenizer;
+
+	std::string generate(std::size_t length)
+	{
+		const char* words[] = { "while", "return", "x", "count", "total_size", "i2", "0", "42", "65536", "=", "==", "+", "(", ")", ";" };
+		const char* spaces[] = { " ", " ", "  ", "\n", "\n\t" };
+		std::mt19937 rng;
+		std::string result;
+		while (result.size() < length)
+		{
+			result += words[rng() % (sizeof(words) / sizeof(words[0]))];
+			result += spaces[rng() % (sizeof(spaces) / sizeof(spaces[0]))];
+		}
+		return result;
+	}
+}
+
+SLURP_BENCHMARK(lexer_tokens)
+{
+	typedef tokenizer::tables tables;
+	std::string input = generate(1 << 16);
+	tokenizer tok;
+
+	auto count_tokens = [&] {
+		token_position<const char*> pos(input.data(), input.data() + input.size());
+		int count = 0;
+		for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+			++count;
+		return count;
+	};
+
+	int tokens = count_tokens();
+	std::cout << "  " << tables::number_of_states << " states, " << tables::number_of_intervals << " intervals, " << tables::number_of_classes << " classes\n";
+	std::cout << "  tables: " << tables::size() << " bytes, " << tokens << " tokens in " << input.size() << " characters\n";
+
+	benchmark::measure("dfa_tokenizer", tokens, [&] {
+		benchmark::keep(count_tokens());
+	});
+}
+
+SLURP_BENCHMARK(lexer_long_tokens)
+{
+	// Identifiers, numbers and whitespace of 16 to 256 characters
+	std::mt19937 rng;
+	std::string input;
+	while (input.size() < (1 << 20))
+	{
+		std::size_t length = 16 + rng() % 241;
+		switch (rng() % 3)
+		{
+		case 0:
+			for (std::size_t i = 0; i < length; ++i)
+				input += "abcdefghijklmnopqrstuvwxyz_0123456789"[i == 0 ? rng() % 26 : rng() % 37];
+			break;
+		case 1:
+			for (std::size_t i = 0; i < length; ++i)
+				input += char('0' + rng() % 10);
+			break;
+		}
+		input += std::string(1 + rng() % length, " \t\n"[rng() % 3]);
+	}
+
+	tokenizer tok;
+	const char* names[] = { "scalar", "sse2", "avx2" };
+	lexer_simd original = get_lexer_simd();
+	for (lexer_simd simd : { lexer_scalar, lexer_sse2, lexer_avx2 })
+	{
+		if (set_lexer_simd(simd) != simd) continue;
+		benchmark::measure(names[simd], input.size(), [&] {
+			token_position<const char*> pos(input.data(), input.data() + input.size());
+			int count = 0;
+			for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+				++count;
+			benchmark::keep(count);
+		});
+	}
+	set_lexer_simd(original);
+}
+
+namespace
+{
+	struct As
+	{
+		typedef Rules<Ch<'a'>, Seq<As, Ch<'a'>>> rule;
+	};
+
+	// On aaaa..., every a is a token, but is only found by scanning to the end of the input
+	typedef typeset<Token<'a', Ch<'a'>>, Token<'b', Seq<As, Ch<'b'>>>> pathological_tokens;
+
+	template<typename Tokenizer>
+	void measure_tokens(const char* label, Tokenizer tok, const std::string& input)
+	{
+		benchmark::measure(label, input.size(), [&] {
+			token_position<const char*> pos(input.data(), input.data() + input.size());
+			int count = 0;
+			for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+				++count;
+			benchmark::keep(count);
+		});
+	}
+}
+
+SLURP_BENCHMARK(lexer_pathological)
+{
+	// The time per character of the dfa_tokenizer grows with the input, but not the linear_tokenizer
+	for (std::size_t n = 1 << 10; n <= 1 << 20; n <<= 2)
+	{
+		std::cout << "  " << n << " characters\n";
+		std::string input(n, 'a');
+		if (n <= 1 << 16) measure_tokens("  dfa_tokenizer", dfa_tokenizer<pathological_tokens>(), input);
+		measure_tokens("  linear_tokenizer", linear_tokenizer<pathological_tokens>(), input);
+	}
+}
+
+SLURP_BENCHMARK(lexer_lazy)
+{
+	// The tokens of lexer_tokens, built at runtime
+	runtime_lexer lx;
+	auto letter = lx.rules({ lx.range('a', 'z'), lx.range('A', 'Z'), lx.ch('_') });
+	auto digit = lx.range('0', '9');
+	auto keyword = [&](const char* text) {
+		runtime_lexer::part p = lx.ch(*text);
+		while (*++text)
+			p = lx.seq({ p, lx.ch(*text) });
+		return p;
+	};
+	lx.token('w', keyword("while"));
+	lx.token('r', keyword("return"));
+	lx.token('x', lx.seq({ letter, lx.star(lx.rules({ letter, digit })) }));
+	lx.token('i', lx.plus(digit));
+	lx.token('=', lx.ch('='));
+	lx.token('e', keyword("=="));
+	lx.token('+', lx.ch('+'));
+	lx.token('(', lx.ch('('));
+	lx.token(')', lx.ch(')'));
+	lx.token(';', lx.ch(';'));
+	lx.skip(lx.plus(lx.rules({ lx.ch(' '), lx.ch('\t'), lx.ch('\n') })));
+
+	std::string input = generate(1 << 16);
+	measure_tokens("dfa_tokenizer", tokenizer(), input);
+	lazy_tokenizer lazy(lx);
+	measure_tokens("lazy_tokenizer", lazy, input);
+
+	token_position<const char*> pos(input.data(), input.data() + input.size());
+	for (lazy.MoveNext(pos); pos.kind != -1; lazy.MoveNext(pos))
+		;
+	std::cout << "  " << lazy.number_of_states() << " states built, and " << tokenizer::tables::number_of_states << " in the minimal DFA\n";
+}
+
+SLURP_BENCHMARK(lexer_chunked)
+{
+	std::string input = generate(1 << 20);
+	measure_tokens("dfa_tokenizer", tokenizer(), input);
+
+	for (std::size_t chunk : { 1500, 65536 })
+	{
+		chunked_tokenizer<tokens, typeset<Spaces>> tok;
+		auto count_tokens = [&] {
+			tok = chunked_tokenizer<tokens, typeset<Spaces>>();
+			token_position<const char*> pos;
+			int count = 0;
+			for (std::size_t i = 0; i < input.size(); i += chunk)
+			{
+				tok.feed(input.data() + i, std::min(chunk, input.size() - i));
+				while (tok.MoveNext(pos))
+					++count;
+			}
+			tok.finish();
+			while (tok.MoveNext(pos) && pos.kind != -1)
+				++count;
+			return count;
+		};
+
+		std::cout << "  " << chunk << " byte chunks\n";
+		benchmark::measure("  chunked_tokenizer", input.size(), [&] {
+			benchmark::keep(count_tokens());
+		});
+		std::cout << "  " << tok.bytes_copied() << " bytes copied\n";
+	}
+}
+
+SLURP_BENCHMARK(tree_token_text)
+{
+	// The size of a tree of tokens that copies or references the input
+	std::string input = generate(1 << 20);
+	for (token_text text : { copy_text, reference_text })
+	{
+		std::size_t bytes = 0;
+		benchmark::measure(text == copy_text ? "copy_text" : "reference_text", input.size(), [&] {
+			Stack stack(text);
+			token_position<const char*> pos(input.data(), input.data() + input.size());
+			tokenizer tok;
+			for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+				stack.Shift(pos.kind, pos.data, pos.begin(), pos.end());
+			bytes = stack.Top();
+		});
+		std::cout << "  " << double(bytes) / input.size() << " bytes of tree per byte of input\n";
+	}
+}
+
+SLURP_BENCHMARK(lexer_line_index)
+{
+	// Building a line_index, and the position of every token
+	std::string input = generate(1 << 20);
+	const char* names[] = { "scalar", "sse2", "avx2" };
+	lexer_simd original = get_lexer_simd();
+	for (lexer_simd simd : { lexer_scalar, lexer_sse2, lexer_avx2 })
+	{
+		if (set_lexer_simd(simd) != simd) continue;
+		benchmark::measure(names[simd], input.size(), [&] {
+			benchmark::keep(line_index(input.data(), input.size()).number_of_lines());
+		});
+	}
+	set_lexer_simd(original);
+
+	std::vector<unsigned> offsets;
+	token_position<const char*> pos(input.data(), input.data() + input.size());
+	tokenizer tok;
+	for (tok.MoveNext(pos); pos.kind != -1; tok.MoveNext(pos))
+		offsets.push_back(pos.data.offset);
+
+	line_index lines(input.data(), input.size());
+	std::cout << "  " << lines.number_of_lines() << " lines, " << offsets.size() << " tokens\n";
+	benchmark::measure("position", offsets.size(), [&] {
+		unsigned sum = 0;
+		for (unsigned offset : offsets)
+			sum += lines.position(offset).column;
+		benchmark::keep(sum);
+	});
+}
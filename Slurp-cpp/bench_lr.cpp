@@ -0,0 +1,321 @@
+// Compares the direct-coded LR parser with a table-driven LR parser
+// on the same tables, grammar and input.
+
+#include "slurp.hpp"
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+
+using namespace slurp;
+
+namespace
+{
+	enum nodes { Int, Plus, Minus, Times, Divide, Bracket };
+
+	typedef Token<'1', Ch<'1'>> tok_int;
+	typedef Token<'(', Ch<'('>> tok_open;
+	typedef Token<')', Ch<')'>> tok_close;
+	typedef Token<'+', Ch<'+'>> tok_plus;
+	typedef Token<'-', Ch<'-'>> tok_minus;
+	typedef Token<'*', Ch<'*'>> tok_times;
+	typedef Token<'/', Ch<'/'>> tok_divide;
+
+	struct Expression;
+
+	typedef Rules<
+		tok_int,
+		Rule<Bracket, tok_open, Expression, tok_close>
+	> PrimaryExpr;
+
+	struct MultiplicativeExpr
+	{
+		typedef Rules<
+			PrimaryExpr,
+			Rule<Times, MultiplicativeExpr, tok_times, PrimaryExpr>,
+			Rule<Divide, MultiplicativeExpr, tok_divide, PrimaryExpr>
+		> rule;
+	};
+
+	struct AdditiveExpr
+	{
+		typedef Rules<
+			MultiplicativeExpr,
+			Rule<Plus, MultiplicativeExpr, tok_plus, AdditiveExpr>,
+			Rule<Minus, MultiplicativeExpr, tok_minus, AdditiveExpr>
+		> rule;
+	};
+
+	struct Expression
+	{
+		typedef AdditiveExpr rule;
+	};
+
+	typedef lalr_tables<Expression> tables;
+
+	// A random expression of about the given length.
+	class expression_generator
+	{
+	public:
+		std::string generate(std::size_t length)
+		{
+			std::string result;
+			while (result.size() < length)
+			{
+				if (!result.empty()) result += op();
+				expression(result, 0);
+			}
+			return result;
+		}
+
+	private:
+		std::mt19937 rng;
+
+		char op()
+		{
+			return "+-*/"[rng() % 4];
+		}
+
+		void expression(std::string& out, int depth)
+		{
+			primary(out, depth);
+			while (rng() % 3 != 0)
+			{
+				out += op();
+				primary(out, depth);
+			}
+		}
+
+		void primary(std::string& out, int depth)
+		{
+			if (depth < 10 && rng() % 4 == 0)
+			{
+				out += '(';
+				expression(out, depth + 1);
+				out += ')';
+			}
+			else
+				out += '1';
+		}
+	};
+
+	void compare(const std::string& input)
+	{
+		lr_parser<tables, null_tokenizer, const char*> parser;
+		benchmark::measure("table-driven", input.size(), [&] {
+			auto result = parser.parse(input.data(), input.data() + input.size());
+			benchmark::keep(result.root().size());
+		});
+
+		benchmark::measure("direct-coded", input.size(), [&] {
+			auto result = direct_lr<Expression>(null_tokenizer(), input.data(), input.data() + input.size());
+			benchmark::keep(result.root().size());
+		});
+	}
+}
+
+SLURP_BENCHMARK(lr_random_expressions)
+{
+	compare(expression_generator().generate(1 << 16));
+}
+
+SLURP_BENCHMARK(lr_regular_expressions)
+{
+	std::string input = "1";
+	while (input.size() < (1 << 16))
+		input += "+1*(1-1)/1";
+	compare(input);
+}
+
+SLURP_BENCHMARK(lr_tree_cache)
+{
+	// Parsing an input, against loading its tree from a tree_cache in the current directory
+	std::string input = expression_generator().generate(1 << 20);
+	lr_parser<tables, null_tokenizer, const char*> parser;
+	auto parse = [&] { return parser.parse(input.data(), input.data() + input.size()); };
+
+	tree_cache cache(".", tables_fingerprint<tables>());
+	std::string path = cache.path(content_hash(input.data(), input.size()));
+	std::remove(path.c_str());
+	bool hit;
+	std::size_t tree_size = cache.parse(input.data(), input.size(), parse, &hit).tree().Top();
+
+	benchmark::measure("parse", input.size(), [&] {
+		benchmark::keep(parse().root().size());
+	});
+
+	benchmark::measure("content_hash", input.size(), [&] {
+		benchmark::keep(content_hash(input.data(), input.size()));
+	});
+
+	benchmark::measure("cache hit", input.size(), [&] {
+		benchmark::keep(cache.parse(input.data(), input.size(), parse, &hit).root().size());
+	});
+
+	std::cout << "  " << tree_size << " bytes of tree file, " << (hit ? "hit" : "miss") << "\n";
+	std::remove(path.c_str());
+}
+
+namespace
+{
+	// Evaluates an expression as it is parsed.
+	struct calculator
+	{
+		typedef double value_type;
+
+		template<typename It>
+		double token(short, const TokenData&, It, It) { return 1; }
+
+		double reduce(short kind, const double* children, unsigned short)
+		{
+			switch (kind)
+			{
+			case Plus: return children[0] + children[2];
+			case Minus: return children[0] - children[2];
+			case Times: return children[0] * children[2];
+			case Divide: return children[0] / children[2];
+			default: return children[1];  // Bracket
+			}
+		}
+	};
+
+	// Evaluates the tree of an expression in the same way.
+	double evaluate(const Node& root, std::vector<double>& values)
+	{
+		calculator calc;
+		values.clear();
+		walk_tree(root, [](const Node&, std::size_t) { return walk_children; }, [&](const Node& node, std::size_t) {
+			if (node.IsToken())
+				values.push_back(1);
+			else
+			{
+				double value = calc.reduce(node.Kind, values.data() + values.size() - node.size(), node.size());
+				values.resize(values.size() - node.size());
+				values.push_back(value);
+			}
+		});
+		return values.back();
+	}
+
+	// The peak memory of fn in MB, or 0 if unknown.
+	template<typename Fn>
+	double peak_memory(Fn fn)
+	{
+		benchmark::reset_peak_memory();
+		std::size_t before = benchmark::peak_memory();
+		fn();
+		std::size_t peak = benchmark::peak_memory();
+		return peak ? double(peak - before) / (1 << 20) : 0;
+	}
+}
+
+SLURP_BENCHMARK(lr_actions)
+{
+	// Evaluating an expression by building and walking its tree, against with semantic actions
+	std::string input = expression_generator().generate(1 << 22);
+	const char* begin = input.data(), *end = begin + input.size();
+	lr_parser<tables, null_tokenizer, const char*> parser;
+	calculator calc;
+	std::vector<double> values;
+
+	auto table_tree = [&] { return evaluate(parser.parse(begin, end).root(), values); };
+	auto table_actions = [&] { return parser.parse_actions(calc, begin, end).value; };
+	auto direct_tree = [&] { return evaluate(direct_lr<Expression>(null_tokenizer(), begin, end).root(), values); };
+	auto direct_actions = [&] { return direct_lr_actions<Expression>(calc, null_tokenizer(), begin, end).value; };
+
+	std::cout << "  " << parser.parse(begin, end).tree().Top() << " bytes of tree for " << input.size() << " characters\n";
+
+	const char* labels[] = { "table-driven, tree", "table-driven, actions", "direct-coded, tree", "direct-coded, actions" };
+	std::function<double()> fns[] = { table_tree, table_actions, direct_tree, direct_actions };
+	for (int i = 0; i < 4; ++i)
+	{
+		double mb = peak_memory([&] { benchmark::keep(fns[i]() > 0); });
+		benchmark::measure(labels[i], input.size(), [&] {
+			benchmark::keep(fns[i]() > 0);
+		});
+		if (mb) std::cout << "    peak memory " << mb << " MB\n";
+	}
+}
+
+namespace
+{
+	// Expression without left recursion, for recursive descent.
+	struct RightExpression;
+
+	typedef Rules<
+		tok_int,
+		Rule<Bracket, tok_open, RightExpression, tok_close>
+	> RightPrimary;
+
+	struct RightMultiplicative
+	{
+		typedef Rules<
+			RightPrimary,
+			Rule<Times, RightPrimary, tok_times, RightMultiplicative>,
+			Rule<Divide, RightPrimary, tok_divide, RightMultiplicative>
+		> rule;
+	};
+
+	struct RightExpression
+	{
+		typedef Rules<
+			RightMultiplicative,
+			Rule<Plus, RightMultiplicative, tok_plus, RightExpression>,
+			Rule<Minus, RightMultiplicative, tok_minus, RightExpression>
+		> rule;
+	};
+
+	typedef Token<'a', Ch<'a'>> tok_a;
+	typedef Token<'b', Ch<'b'>> tok_b;
+
+	// Each level is parsed twice by the level outside it, when that ends in b.
+	struct Nested
+	{
+		typedef Rules<
+			tok_int,
+			Rule<'a', tok_open, Nested, tok_close, tok_a>,
+			Rule<'b', tok_open, Nested, tok_close, tok_b>
+		> rule;
+	};
+
+	template<typename Grammar>
+	void compare_packrat(const std::string& input)
+	{
+		const char* begin = input.data(), *end = begin + input.size();
+		packrat_statistics statistics;
+		auto p = recursive_descent_packrat<Grammar>(null_tokenizer(), begin, end, stack_options(), default_packrat_bytes, &statistics);
+		std::cout << "  " << input.size() << " characters, " << statistics.hits << " hits, " << statistics.misses << " misses\n";
+
+		benchmark::measure("recursive descent", input.size(), [&] {
+			benchmark::keep(recursive_descent<Grammar>(null_tokenizer(), begin, end).root().size());
+		});
+		benchmark::measure("packrat", input.size(), [&] {
+			benchmark::keep(recursive_descent_packrat<Grammar>(null_tokenizer(), begin, end).root().size());
+		});
+	}
+}
+
+SLURP_BENCHMARK(rd_packrat)
+{
+	// Alternatives that share a prefix, which recursive descent parses again for each alternative
+	for (int depth : { 8, 12, 16 })
+	{
+		std::string input = "1";
+		for (int i = 0; i < depth; ++i)
+			input = "(" + input + ")b";
+		compare_packrat<Nested>(input);
+	}
+
+	// Expressions, where each alternative parses a product again, and each bracket parses its contents again
+	compare_packrat<RightExpression>(expression_generator().generate(96));
+
+	// A longer expression takes recursive descent too long
+	std::string input = expression_generator().generate(1 << 12);
+	const char* begin = input.data(), *end = begin + input.size();
+	std::cout << "  " << input.size() << " characters\n";
+	benchmark::measure("packrat", input.size(), [&] {
+		benchmark::keep(recursive_descent_packrat<RightExpression>(null_tokenizer(), begin, end).root().size());
+	});
+}
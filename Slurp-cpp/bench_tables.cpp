@@ -0,0 +1,122 @@
+// Compares the size and parse speed of dense and compressed LR tables,
+// on an expression grammar with many levels of precedence.
+
+#include "slurp.hpp"
+#include "benchmark.hpp"
+
+#include <random>
+#include <string>
+
+using namespace slurp;
+
+namespace
+{
+	// The binary operators of each level of precedence, from lowest to highest.
+	const char* levels[] = { ",", "?:", "|", "^", "&", "=!", "<>", "LR", "+-", "*/%", "@#", "$~" };
+	const int number_of_levels = sizeof(levels) / sizeof(levels[0]);
+
+	// expr_0 -> expr_1 | expr_0 op_0 expr_1
+	// ...
+	// expr_n -> 1 | ( expr_0 ) | f ( ) | f ( expr_0 )
+	runtime_grammar::symbol make_grammar(runtime_grammar& g)
+	{
+		std::vector<runtime_grammar::symbol> expr;
+		for (int i = 0; i <= number_of_levels; ++i)
+			expr.push_back(g.declare());
+
+		for (int i = 0; i < number_of_levels; ++i)
+		{
+			std::vector<runtime_grammar::symbol> alternatives = { expr[i + 1] };
+			for (const char* op = levels[i]; *op; ++op)
+				alternatives.push_back(g.rule(*op, { expr[i], g.token(*op), expr[i + 1] }));
+			g.define(expr[i], g.rules(alternatives));
+		}
+
+		auto open = g.token('('), close = g.token(')'), call = g.token('f');
+		g.define(expr[number_of_levels], g.rules({
+			g.token('1'),
+			g.rule('b', { open, expr[0], close }),
+			g.rule('c', { call, open, close }),
+			g.rule('c', { call, open, expr[0], close }) }));
+
+		return expr[0];
+	}
+
+	class expression_generator
+	{
+	public:
+		std::string generate(std::size_t length)
+		{
+			std::string result;
+			while (result.size() < length)
+			{
+				if (!result.empty()) result += op();
+				expression(result, 0);
+			}
+			return result;
+		}
+
+	private:
+		std::mt19937 rng;
+
+		char op()
+		{
+			const char* level = levels[rng() % number_of_levels];
+			return level[rng() % std::char_traits<char>::length(level)];
+		}
+
+		void expression(std::string& out, int depth)
+		{
+			primary(out, depth);
+			while (rng() % 3 != 0)
+			{
+				out += op();
+				primary(out, depth);
+			}
+		}
+
+		void primary(std::string& out, int depth)
+		{
+			switch (depth < 8 ? rng() % 8 : 0)
+			{
+			case 1:
+				out += '(';
+				expression(out, depth + 1);
+				out += ')';
+				break;
+			case 2:
+				out += "f(";
+				if (rng() % 2) expression(out, depth + 1);
+				out += ')';
+				break;
+			default:
+				out += '1';
+			}
+		}
+	};
+
+	template<typename Tables>
+	void measure_parse(const char* label, const Tables& tables, const std::string& input)
+	{
+		lr_parser<Tables, null_tokenizer, const char*> parser(tables);
+		benchmark::measure(label, input.size(), [&] {
+			auto result = parser.parse(input.data(), input.data() + input.size());
+			benchmark::keep(result.root().size());
+		});
+	}
+}
+
+SLURP_BENCHMARK(lr_table_compression)
+{
+	runtime_grammar g;
+	runtime_tables dense(g.flatten(make_grammar(g)));
+	compressed_tables compressed(dense);
+
+	std::size_t dense_size = dense.actions.size() * sizeof(lr_action) + dense.rules.size() * sizeof(lr_rule) + dense.terminals.size() * sizeof(short);
+	std::cout << "  " << dense.number_of_states << " states, " << dense.number_of_symbols << " symbols, " << compressed.fused_shifts << " fused shifts\n";
+	std::cout << "  dense: " << dense_size << " bytes, compressed: " << compressed.size() << " bytes\n";
+
+	std::string input = expression_generator().generate(1 << 16);
+	measure_parse("dense", dense.view(), input);
+	measure_parse("compressed", compressed.view(), input);
+}
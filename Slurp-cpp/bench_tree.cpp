@@ -0,0 +1,344 @@
+// Measures operations on the trees in a Stack.
+
+#include "slurp.hpp"
+#include "benchmark.hpp"
+
+#include <random>
+
+using namespace slurp;
+
+namespace
+{
+	// A node with n token children.
+	void wide_node(Stack& stack, int n)
+	{
+		TokenData data = {};
+		const char text[] = "x";
+		for (int i = 0; i < n; ++i)
+			stack.Shift((short)i, data, text, text + 1);
+		stack.Reduce(0, (unsigned short)n);
+	}
+}
+
+SLURP_BENCHMARK(tree_child_access)
+{
+	for (int n : { 4, 64, 1024 })
+	{
+		std::cout << "  " << n << " children\n";
+		for (bool table : { false, true })
+		{
+			stack_options options;
+			options.child_table = table;
+			Stack stack(options);
+			wide_node(stack, n);
+			const Node& root = stack.Root();
+
+			benchmark::measure(table ? "  operator[] with child table" : "  operator[]", n, [&] {
+				std::size_t sum = 0;
+				for (unsigned short i = 0; i < root.size(); ++i)
+					sum += root[i].Kind;
+				benchmark::keep(sum);
+			});
+
+			benchmark::measure(table ? "  children() with child table" : "  children()", n, [&] {
+				std::size_t sum = 0;
+				for (const Node& child : root.children())
+					sum += child.Kind;
+				benchmark::keep(sum);
+			});
+		}
+	}
+}
+
+SLURP_BENCHMARK(tree_reduce)
+{
+	// Shifts and reduces of 3 children, as in a binary expression, and of 64 children.
+	// The stack is unwound after each reduce so that it stays in the cache.
+	TokenData data = {};
+	const char text[] = "x";
+	for (int width : { 3, 64 })
+	{
+		std::cout << "  " << width << " children\n";
+		for (bool starts : { false, true })
+		{
+			stack_options options(reference_text);
+			options.node_starts = starts;
+			Stack stack(options);
+			int reduces = (1 << 20) / width;
+
+			// The time of the shifts alone, to subtract from the time with the reduce
+			benchmark::measure(starts ? "  Shifts with node starts" : "  Shifts", reduces, [&] {
+				for (int i = 0; i < reduces; ++i)
+				{
+					for (int j = 0; j < width; ++j)
+						stack.Shift(0, data, text, text + 1);
+					benchmark::keep(stack.Root().size());
+					stack.Unwind(0);
+				}
+			});
+
+			benchmark::measure(starts ? "  Shifts and Reduce with node starts" : "  Shifts and Reduce", reduces, [&] {
+				for (int i = 0; i < reduces; ++i)
+				{
+					for (int j = 0; j < width; ++j)
+						stack.Shift(0, data, text, text + 1);
+					stack.Reduce(1, (unsigned short)width);
+					benchmark::keep(stack.Root().size());
+					stack.Unwind(0);
+				}
+			});
+		}
+	}
+}
+
+SLURP_BENCHMARK(tree_storage)
+{
+	// Builds a tree of about 100MB in each storage, and its peak memory.
+	// resource_storage with the default resource copies the stack as it grows, as std::vector does.
+	const int tokens = 1 << 21;
+	TokenData data = {};
+	const char text[] = "token";
+
+	auto build = [&](const stack_options& options) {
+		Stack stack(options);
+		stack.Shift(0, data, text, text + 5);
+		for (int i = 1; i < tokens; ++i)
+		{
+			stack.Shift(0, data, text, text + 5);
+			stack.Reduce(1, 2);
+		}
+		return parse_result(std::move(stack));
+	};
+
+	const char* names[] = { "heap_storage", "resource_storage", "mapped_storage", "mapped_storage (huge pages)" };
+	for (int i = 0; i < 4; ++i)
+	{
+		stack_options options;
+		options.storage = i < 3 ? stack_storage(i) : mapped_storage;
+		options.huge_pages = i == 3;
+
+		benchmark::reset_peak_memory();
+		std::size_t before = benchmark::peak_memory();
+		std::size_t size;
+		{
+			auto result = build(options);
+			size = result.root().size();
+		}
+		std::size_t peak = benchmark::peak_memory();
+
+		benchmark::measure(names[i], tokens, [&] {
+			benchmark::keep(build(options).root().size());
+		});
+		if (peak) std::cout << "  peak memory " << (peak - before) / (1 << 20) << " MB\n";
+		benchmark::keep(size);
+	}
+}
+
+namespace
+{
+	// A random subtree of at most the given depth, of tokens and nodes of 1 to 4 children,
+	// where the tokens are at offset onwards, with a space between them.
+	// Returns the number of nodes.
+	std::size_t random_tree(Stack& stack, std::mt19937& rng, int depth, unsigned& offset)
+	{
+		if (depth == 0 || rng() % 3 == 0)
+		{
+			TokenData data = { offset, (unsigned)(1 + rng() % 8) };
+			const char text[] = "abcdefgh";
+			stack.Shift((short)(rng() % 64), data, text, text + data.length);
+			offset += data.length + 1;
+			return 1;
+		}
+
+		std::size_t nodes = 1;
+		unsigned short children = (unsigned short)(1 + rng() % 4);
+		for (unsigned short i = 0; i < children; ++i)
+			nodes += random_tree(stack, rng, depth - 1, offset);
+		stack.Reduce((short)(rng() % 64), children);
+		return nodes;
+	}
+
+	template<typename N>
+	std::size_t walk(const N& node)
+	{
+		if (node.IsToken()) return node.Kind + node.GetToken()->length;
+		std::size_t sum = node.Kind;
+		for (const N& child : node.children())
+			sum += walk(child);
+		return sum;
+	}
+
+	std::size_t walk_indexed(const Node& node)
+	{
+		if (node.IsToken()) return node.Kind + node.GetToken()->length;
+		std::size_t sum = node.Kind;
+		for (unsigned short i = 0; i < node.size(); ++i)
+			sum += walk_indexed(node[i]);
+		return sum;
+	}
+}
+
+SLURP_BENCHMARK(tree_walk)
+{
+	// Top-down, left-to-right walks of the same tree of about 1M nodes in each layout
+	for (bool table : { false, true })
+	{
+		stack_options options;
+		options.child_table = table;
+		Stack stack(options);
+		std::mt19937 rng;
+		std::size_t nodes = 0;
+		unsigned short children = 0;
+		unsigned offset = 0;
+		while (nodes < (1 << 20))
+		{
+			nodes += random_tree(stack, rng, 12, offset);
+			++children;
+		}
+		stack.Reduce(0, children);
+		++nodes;
+
+		const Node& root = stack.Root();
+		std::cout << "  " << nodes << " nodes, " << stack.Top() << " bytes" << (table ? " with child tables" : "") << "\n";
+		if (table)
+		{
+			benchmark::measure("  Stack, operator[] with child tables", nodes, [&] {
+				benchmark::keep(walk_indexed(root));
+			});
+			continue;
+		}
+
+		benchmark::measure("  Stack, children()", nodes, [&] {
+			benchmark::keep(walk(root));
+		});
+
+		tree_cursor cursor;
+		benchmark::measure("  Stack, tree_cursor", nodes, [&] {
+			std::size_t sum = 0;
+			walk_tree(cursor, root, [&](const Node& n, std::size_t) {
+				sum += n.Kind + (n.IsToken() ? n.GetToken()->length : 0);
+				return walk_children;
+			}, [](const Node&, std::size_t) {});
+			benchmark::keep(sum);
+		});
+
+		benchmark::measure("  compacting", nodes, [&] {
+			benchmark::keep(compact_tree(root).size());
+		});
+
+		compact_tree tree(root);
+		assert(walk(tree.root()) == walk(root));
+		std::cout << "  compact_tree: " << tree.size() << " bytes\n";
+
+		benchmark::measure("  compact_tree, children()", nodes, [&] {
+			benchmark::keep(walk(tree.root()));
+		});
+
+		benchmark::measure("  compact_tree, Next()", nodes, [&] {
+			std::size_t sum = 0;
+			for (const compact_node* n = &tree.root(); n != tree.end(); n = n->Next())
+				sum += n->Kind + (n->IsToken() ? n->GetToken()->length : 0);
+			benchmark::keep(sum);
+		});
+	}
+}
+
+SLURP_BENCHMARK(tree_parallel_fold)
+{
+	// A top-level list of random subtrees, of about 4M nodes, folded on 1 thread and on every thread
+	Stack stack;
+	std::mt19937 rng;
+	std::size_t nodes = 0;
+	unsigned short children = 0;
+	unsigned offset = 0;
+	while (nodes < (1 << 22) && children < Node::max_children)
+	{
+		nodes += random_tree(stack, rng, 12, offset);
+		++children;
+	}
+	stack.Reduce(0, children);
+	parse_result result(std::move(stack));
+
+	auto fold = [](const Node& n) { return walk(n); };
+	auto combine = [](const Node& n, std::vector<std::size_t>&& children) {
+		std::size_t sum = n.Kind;
+		for (std::size_t c : children) sum += c;
+		return sum;
+	};
+
+	benchmark::measure("sequential", nodes, [&] {
+		benchmark::keep(walk(result.root()));
+	});
+
+	for (unsigned threads : { 1u, std::thread::hardware_concurrency() })
+	{
+		thread_pool pool(threads);
+		std::cout << "  " << pool.size() << " threads\n";
+		benchmark::measure("  parallel_fold", nodes, [&] {
+			benchmark::keep(result.parallel_fold(pool, fold, combine, 1 << 16));
+		});
+	}
+}
+
+namespace
+{
+	// Walks the children from the last, as Node::NextChild does.
+	std::size_t walk_back(const Node& node)
+	{
+		if (node.IsToken()) return node.Kind + node.GetToken()->offset;
+		std::size_t sum = node.Kind;
+		const Node* c = node.FirstChild();
+		for (int i = 0; i < node.size(); ++i, c = c->NextChild())
+			sum += walk_back(*c);
+		return sum;
+	}
+
+	std::size_t walk_back(packed_node node)
+	{
+		if (node.IsToken()) return node.Kind + node.GetToken()->offset;
+		std::size_t sum = node.Kind;
+		packed_node c = node.FirstChild();
+		for (int i = 0;; c = c.NextChild())
+		{
+			sum += walk_back(c);
+			if (++i == node.size()) break;
+		}
+		return sum;
+	}
+}
+
+SLURP_BENCHMARK(tree_encoding)
+{
+	// The same tree of about 1M nodes in each encoding
+	const char* names[] = { "fixed_nodes", "fixed_nodes, reference_text", "packed_nodes" };
+	for (int i = 0; i < 3; ++i)
+	{
+		stack_options options(i == 0 ? copy_text : reference_text);
+		options.encoding = i < 2 ? fixed_nodes : packed_nodes;
+
+		std::size_t nodes = 0, bytes = 0;
+		auto build = [&] {
+			Stack stack(options);
+			std::mt19937 rng;
+			unsigned offset = 0;
+			unsigned short children = 0;
+			for (nodes = 0; nodes < (1 << 20); ++children)
+				nodes += random_tree(stack, rng, 12, offset);
+			stack.Reduce(0, children);
+			++nodes;
+			bytes = stack.Top();
+			return stack;
+		};
+
+		std::cout << "  " << names[i] << "\n";
+		benchmark::measure("    build", 1 << 20, [&] {
+			benchmark::keep(build().Top());
+		});
+
+		Stack stack = build();
+		std::cout << "    " << double(bytes) / nodes << " bytes per node\n";
+		benchmark::measure("    walk", nodes, [&] {
+			benchmark::keep(options.encoding == packed_nodes ? walk_back(stack.PackedRoot()) : walk_back(stack.Root()));
+		});
+	}
+}
@@ -0,0 +1,75 @@
+// benchmark.cpp : The entry point of Slurp-bench.
+//
+// Usage: Slurp-bench [name...]
+// Runs all benchmarks, or only those whose names are given.
+
+#include "benchmark.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct entry
+	{
+		const char* name;
+		slurp::benchmark::function fn;
+	};
+
+	std::vector<entry>& benchmarks()
+	{
+		static std::vector<entry> list;
+		return list;
+	}
+
+	volatile std::size_t sink;
+}
+
+slurp::benchmark::registration::registration(const char* name, function fn)
+{
+	benchmarks().push_back(entry{ name, fn });
+}
+
+void slurp::benchmark::keep(std::size_t value)
+{
+	sink = sink + value;
+}
+
+void slurp::benchmark::reset_peak_memory()
+{
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5";
+}
+
+std::size_t slurp::benchmark::peak_memory()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return std::stoul(line.substr(6)) * 1024;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+#ifndef NDEBUG
+	std::cout << "Warning: this is not an optimised build\n";
+#endif
+
+	for (const entry& b : benchmarks())
+	{
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; ++i)
+			selected = selected || std::strcmp(argv[i], b.name) == 0;
+
+		if (selected)
+		{
+			std::cout << b.name << std::endl;
+			b.fn();
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,69 @@
+/*
+	A minimal benchmark harness for the Slurp-bench executable.
+
+	SLURP_BENCHMARK(name)
+	{
+		...
+	}
+
+	registers a benchmark that is run by Slurp-bench (optionally filtered by name on the
+	command line). Inside a benchmark,
+
+	measure("label", items, fn)
+
+	runs fn repeatedly for a short time and reports the best time per item,
+	and keep(value) stops the optimiser from discarding a result.
+	reset_peak_memory() and peak_memory() measure the peak memory of some code.
+
+	Benchmarks are only meaningful in an optimised (Release) build.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+
+namespace slurp
+{
+	namespace benchmark
+	{
+		typedef void (*function)();
+
+		struct registration
+		{
+			registration(const char* name, function fn);
+		};
+
+		void keep(std::size_t value);
+
+		// Resets the peak memory of the process, where supported (Linux).
+		void reset_peak_memory();
+
+		// The peak resident memory of the process in bytes since reset_peak_memory(), or 0 if unknown.
+		std::size_t peak_memory();
+
+		template<typename Fn>
+		void measure(const char* label, std::size_t items, Fn fn)
+		{
+			typedef std::chrono::steady_clock clock;
+
+			double best = 0;
+			auto start = clock::now();
+			for (int runs = 0; runs < 3 || clock::now() - start < std::chrono::milliseconds(300); ++runs)
+			{
+				auto t0 = clock::now();
+				fn();
+				double ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+				if (runs == 0 || ns < best) best = ns;
+			}
+
+			std::cout << "  " << label << ": " << best / 1e6 << " ms, " << best / items << " ns/item\n";
+		}
+	}
+}
+
+#define SLURP_BENCHMARK(name) \
+	static void name(); \
+	static slurp::benchmark::registration name##_registration(#name, name); \
+	static void name()
@@ -0,0 +1,242 @@
+/*
+	A tokenizer for input that arrives in chunks, such as network receive buffers,
+	so that the input does not need to be concatenated into one string first.
+
+	chunked_tokenizer<Tokens, Skip> has the same tokens as dfa_tokenizer<Tokens, Skip>:
+
+		chunked_tokenizer<Tokens, Skip> tok;
+		token_position<const char*> token;
+
+		while (receive(buffer, length))
+		{
+			tok.feed(buffer, length);
+			while (tok.MoveNext(token))
+				... // Use the token
+		}
+		tok.finish();
+		while (tok.MoveNext(token) && token.kind != -1)
+			... // Use the token
+
+	MoveNext returns false when it reaches the end of the chunk in the middle of a token,
+	and keeps the DFA state so that it resumes there when the next chunk is fed.
+	The characters of a token normally point into the chunk, and are only copied
+	when the token spans chunks. The characters of a token are valid until the next
+	call to feed() or MoveNext(), and a chunk must be valid until the next call to feed().
+*/
+
+#pragma once
+
+namespace slurp
+{
+	template<typename Tokens, typename Skip = ts_empty, int Capacity = 0>
+	class chunked_tokenizer
+	{
+	public:
+		typedef lexer_tables<Tokens, Skip, Capacity> tables;
+
+		chunked_tokenizer() : chunk(nullptr), chunk_length(0), carry_length(0), stream_offset(0),
+			start(0), scan(0), accept_end(0), state(0), token(-1), looped(0), scanning(false), at_end(false), copied(0)
+		{
+			position.offset = 0;
+			position.length = 0;
+		}
+
+		// Sets the next chunk of the input, which is valid until the next call to feed().
+		void feed(const char* data, std::size_t length)
+		{
+			// Keep the characters of the current token
+			if (start >= carry_length)
+				carry.assign(chunk + (start - carry_length), chunk + chunk_length);
+			else
+			{
+				carry.erase(0, start);
+				carry.resize(carry_length - start);
+				carry.append(chunk, chunk_length);
+			}
+			copied += carry.size();
+
+			stream_offset += start;
+			scan -= start;
+			accept_end -= start;
+			start = 0;
+			carry_length = carry.size();
+			chunk = data;
+			chunk_length = length;
+		}
+
+		// Marks the end of the input, so that the last token can finish.
+		void finish()
+		{
+			at_end = true;
+		}
+
+		// Moves to the next token, or returns false if the chunk ends before the token does.
+		// After finish(), the last token has kind -1.
+		bool MoveNext(token_position<const char*>& pos)
+		{
+			for (;;)
+			{
+				if (!scanning)
+				{
+					if (start == input_length())
+					{
+						if (!at_end) return false;
+						pos.tok_start = pos.tok_end = nullptr;
+						pos.kind = -1;
+						pos.data = position;
+						pos.data.length = 0;
+						return true;
+					}
+
+					state = 0;
+					token = -1;
+					looped = 0;
+					scan = accept_end = start;
+					scanning = true;
+				}
+
+				// Find the longest match, which may continue from the previous chunk.
+				// The scan uses local copies of the state, which the compiler can keep in registers.
+				int current = state, match = token, loops = looped;
+				std::size_t match_end = accept_end;
+				bool stopped = false;
+
+				// Moves to the next state on character ch at position p, and returns false if there is none
+				auto step = [&](char ch, std::size_t p) {
+					int next = tables::next(current, helpers::code_unit(ch));
+					if (next < 0) return false;
+					loops = next == current ? loops + 1 : 0;
+					current = next;
+					if (tables::accepts(current) >= 0)
+					{
+						match = tables::accepts(current);
+						match_end = p + 1;
+					}
+					return true;
+				};
+
+				std::size_t p = scan;
+				for (; p < carry_length && !stopped; ++p)
+					stopped = !step(carry[p], p);
+
+				if (!stopped)
+				{
+					const char* end = chunk + chunk_length;
+					for (const char* q = chunk + (p - carry_length); q != end; ++q)
+					{
+						if (!step(*q, q - chunk + carry_length))
+						{
+							stopped = true;
+							p = q - chunk + carry_length;
+							break;
+						}
+
+						// As dfa_tokenizer, skip long runs in one go
+						if (loops >= 8 && tables::run(current).count)
+						{
+							const unsigned char* bytes = reinterpret_cast<const unsigned char*>(q + 1);
+							const char* after = q + 1 + (scan_run(tables::run(current), bytes, reinterpret_cast<const unsigned char*>(end)) - bytes);
+							if (after != q + 1 && tables::accepts(current) >= 0)
+								match_end = after - chunk + carry_length;
+							q = after - 1;
+						}
+					}
+					if (!stopped) p = input_length();
+				}
+				else
+					--p;
+
+				state = current;
+				token = match;
+				looped = loops;
+				scan = p;
+				accept_end = match_end;
+
+				if (!stopped && !at_end) return false;
+				scanning = false;
+
+				std::size_t end = token < 0 ? start + 1 : accept_end;
+				if (token >= tables::number_of_tokens)
+				{
+					// Skipped
+					advance(end);
+					continue;
+				}
+
+				pos.kind = token < 0 ? lexer_error : tables::kind(token);
+				pos.data = position;
+				pos.data.length = (unsigned)(end - start);
+				std::size_t token_start = start;
+				advance(end);
+				set_text(pos, token_start, end);
+				return true;
+			}
+		}
+
+		// The number of characters that have been copied because tokens spanned chunks.
+		std::size_t bytes_copied() const { return copied; }
+
+	private:
+		/*
+			The input is the characters of the current token from previous chunks (carry_length characters of carry),
+			followed by the current chunk. start, scan and accept_end are indexes into the input.
+		*/
+		std::string carry;
+		const char* chunk;
+		std::size_t chunk_length, carry_length;
+
+		// The offset in the stream of the start of the input.
+		std::size_t stream_offset;
+
+		// The start of the current token, the next character to scan, and the end of the longest match.
+		std::size_t start, scan, accept_end;
+		int state, token, looped;
+		bool scanning, at_end;
+		std::size_t copied;
+
+		// The position of the start of the current token.
+		TokenData position;
+
+		std::size_t input_length() const { return carry_length + chunk_length; }
+
+		void set_text(token_position<const char*>& pos, std::size_t token_start, std::size_t end)
+		{
+			if (token_start >= carry_length)
+			{
+				pos.stream_start = chunk;
+				pos.stream_end = chunk + chunk_length;
+				pos.tok_start = chunk + (token_start - carry_length);
+				pos.tok_end = chunk + (end - carry_length);
+				return;
+			}
+
+			if (end > carry_length)
+			{
+				// The token spans chunks, so copy the rest of it after the carried characters.
+				// The rest of the input is then just the chunk.
+				carry.erase(0, token_start);
+				carry.resize(carry_length - token_start);
+				carry.append(chunk, end - carry_length);
+				copied += end - carry_length;
+
+				stream_offset += carry_length;
+				start -= carry_length;
+				carry_length = 0;
+				pos.tok_start = carry.data();
+			}
+			else
+				pos.tok_start = carry.data() + token_start;
+
+			pos.tok_end = pos.tok_start + (end - token_start);
+			pos.stream_start = carry.data();
+			pos.stream_end = carry.data() + carry.size();
+		}
+
+		// Moves the start of the current token to end.
+		void advance(std::size_t end)
+		{
+			start = end;
+			position.offset = (unsigned)(stream_offset + start);
+		}
+	};
+}
@@ -32,15 +32,26 @@ namespace slurp
 		typedef typename follows2<N - 1, Lookahead, Ts...>::type type;
 	};
 
+	namespace helpers
+	{
+		// The symbols after the dot of an item, as a nonterminal,
+		// so that their FIRST set and nullable come from one flat_grammar.
+		template<typename... Ts>
+		struct item_suffix
+		{
+			typedef Rule<0, Ts...> rule;
+		};
+	}
+
 	template<typename Lookahead, typename T, typename...Ts>
 	struct follows2<0, Lookahead, T, Ts...>
 	{
-		typedef typename first<T>::type t1;
-		// typedef t1 type;
-		// typename typename ts_union<t1, typename follows2<0, Lookahead, Ts...>::type>::type t2;
+		typedef helpers::item_suffix<T, Ts...> suffix;
+		typedef flat_grammar<suffix> grammar;
+		typedef typename grammar_first<grammar, suffix>::type t1;
 		typedef typename std::conditional<
-			is_empty<T>::value,
-			typename ts_union<t1, typename follows2<0, Lookahead, Ts...>::type>::type,
+			grammar_nullable<grammar, suffix>::value,
+			typename ts_union<t1, typeset<Lookahead>>::type,
 			t1>::type type;
 	};
 
@@ -131,8 +142,155 @@ namespace slurp
 	};
 
 
-	template<typename Items>
-	struct closure
+	/*
+		The LR(0) automaton of a flat_grammar, computed in constexpr functions.
+
+		An item is a production with a position (the "dot") in its right hand side.
+		Items are numbered so that production p with the dot before symbol d is item
+
+			first_item(p) + d
+
+		and advancing the dot is adding 1 to the item.
+
+		A state is identified by its kernel - the items that were reached by
+		advancing the dot over a symbol - and its closure adds the initial items
+		of every nonterminal that appears after a dot.
+
+		lr0_automaton<Grammar, MaxStates>
+
+		enumerates the states reachable from the initial items of the root symbol,
+		and the goto (transition) of each state on each symbol.
+		MaxStates is the capacity used during construction. If it is too small,
+		overflow is set and the automaton is incomplete.
+	*/
+
+	template<typename Grammar>
+	struct lr_items
 	{
+		static const int number_of_items = Grammar::rhs_size + Grammar::number_of_productions;
+		typedef bitset<number_of_items> item_set;
+
+		// The production of each item.
+		int production[number_of_items];
+
+		// The symbol after the dot, or -1 if the item is complete.
+		int next[number_of_items];
+
+		// The closure of the initial items of each nonterminal.
+		item_set initial[Grammar::number_of_symbols];
+
+		// The productions of each symbol are productions[first_production[s], first_production[s+1]).
+		int first_production[Grammar::number_of_symbols + 1];
+
+		static constexpr int first_item(int production)
+		{
+			return Grammar::productions[production].rhs + production;
+		}
+
+		constexpr lr_items() : production{}, next{}, initial{}, first_production{}
+		{
+			for (int p = 0; p < Grammar::number_of_productions; ++p)
+			{
+				const auto& prod = Grammar::productions[p];
+				for (int d = 0; d <= prod.length; ++d)
+				{
+					production[first_item(p) + d] = p;
+					next[first_item(p) + d] = d < prod.length ? Grammar::rhs[prod.rhs + d] : -1;
+				}
+			}
+
+			// Productions are grouped by their left hand side
+			for (int s = 0, p = 0; s <= Grammar::number_of_symbols; ++s)
+			{
+				while (p < Grammar::number_of_productions && Grammar::productions[p].lhs < s)
+					++p;
+				first_production[s] = p;
+			}
+
+			for (int p = 0; p < Grammar::number_of_productions; ++p)
+				initial[Grammar::productions[p].lhs].insert(first_item(p));
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (int s = Grammar::number_of_terminals; s < Grammar::number_of_symbols; ++s)
+				{
+					for (int p = first_production[s]; p < first_production[s + 1]; ++p)
+					{
+						int n = next[first_item(p)];
+						if (n >= Grammar::number_of_terminals)
+							changed = initial[s].insert_all(initial[n]) || changed;
+					}
+				}
+			}
+		}
+
+		// Whether the item is the root production before its final eof.
+		constexpr bool accepts(int item) const
+		{
+			return next[item] == 0 && Grammar::productions[production[item]].lhs == Grammar::root;
+		}
+
+		// Adds the initial items of every nonterminal after a dot.
+		constexpr item_set closure(const item_set& kernel) const
+		{
+			item_set result = kernel;
+			for (int i = 0; i < number_of_items; ++i)
+				if (kernel.contains(i) && next[i] >= Grammar::number_of_terminals)
+					result.insert_all(initial[next[i]]);
+			return result;
+		}
+	};
+
+	template<typename Grammar, int MaxStates>
+	struct lr0_automaton
+	{
+		typedef lr_items<Grammar> items_type;
+		typedef typename items_type::item_set item_set;
+
+		items_type items;
+		int number_of_states;
+		bool overflow;
+
+		item_set kernel[MaxStates];
+		item_set closure[MaxStates];
+
+		// The state reached from each state over each symbol, or -1.
+		int transitions[MaxStates][Grammar::number_of_symbols];
+
+		constexpr lr0_automaton() : items(), number_of_states(1), overflow(false), kernel{}, closure{}, transitions{}
+		{
+			for (int p = items.first_production[Grammar::root]; p < items.first_production[Grammar::root + 1]; ++p)
+				kernel[0].insert(items.first_item(p));
+
+			for (int s = 0; s < number_of_states; ++s)
+			{
+				closure[s] = items.closure(kernel[s]);
+
+				// The parser accepts instead of shifting the eof at the end of the root,
+				// so there is no transition over it.
+				item_set gotos[Grammar::number_of_symbols] = {};
+				for (int i = 0; i < items_type::number_of_items; ++i)
+					if (closure[s].contains(i) && items.next[i] >= 0 && !items.accepts(i))
+						gotos[items.next[i]].insert(i + 1);
+
+				for (int x = 0; x < Grammar::number_of_symbols; ++x)
+					transitions[s][x] = gotos[x].empty() ? -1 : find_or_add(gotos[x]);
+			}
+		}
+
+	private:
+		constexpr int find_or_add(const item_set& k)
+		{
+			for (int s = 0; s < number_of_states; ++s)
+				if (kernel[s] == k) return s;
+			if (number_of_states == MaxStates)
+			{
+				overflow = true;
+				return -1;
+			}
+			kernel[number_of_states] = k;
+			return number_of_states++;
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "compact_tree.hpp"
+#include <cstring>
+#include <new>
+
+slurp::compact_tree::compact_tree()
+{
+}
+
+slurp::compact_tree::compact_tree(const Node& root)
+{
+	// The tree is no larger than in the Stack, where it can also have child tables
+	bytes.resize(root.length);
+	std::size_t size = 0;
+
+	// The nodes still to be copied, with the next one at the back
+	std::vector<const Node*> pending = { &root };
+
+	// The nodes that have been copied but whose children have not, and the number of children to go
+	struct open_node
+	{
+		std::size_t position;
+		unsigned short remaining;
+	};
+	std::vector<open_node> open;
+
+	while (!pending.empty())
+	{
+		const Node& node = *pending.back();
+		pending.pop_back();
+
+		std::size_t position = size;
+		if (!node.IsToken())
+		{
+			// The length is written when the last child has been copied
+			new (bytes.data() + position) compact_node(node.Kind, node.size(), 0);
+			size += sizeof(compact_node);
+			open.push_back(open_node{ position, node.size() });
+
+			// The last child is found first, so is pushed first
+			const Node* c = node.FirstChild();
+			for (int i = 0; i < node.size(); ++i, c = c->NextChild())
+				pending.push_back(c);
+			continue;
+		}
+
+		// The TokenData and the text are copied as they are
+		std::size_t payload = sizeof(TokenData) + (node.HasText() ? (node.WTextLength() + 1) * sizeof(wchar_t) : 0);
+		new (bytes.data() + position) compact_node(node.Kind, 0, (compact_node::size_type)(sizeof(compact_node) + payload));
+		std::memcpy(bytes.data() + position + sizeof(compact_node), node.GetToken(), payload);
+		size += sizeof(compact_node) + payload;
+
+		// Close the nodes whose last child this was
+		while (!open.empty() && --open.back().remaining == 0)
+		{
+			compact_node* n = (compact_node*)(bytes.data() + open.back().position);
+			n->length = (compact_node::size_type)(size - open.back().position);
+			open.pop_back();
+		}
+	}
+
+	if (size < bytes.size())
+	{
+		bytes.resize(size);
+		bytes.shrink_to_fit();
+	}
+}
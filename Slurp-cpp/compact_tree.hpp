@@ -0,0 +1,201 @@
+#pragma once
+#include "Node.h"
+
+namespace slurp
+{
+	/*
+		A node in a compact_tree.
+
+		A Stack stores a tree in postorder, with the children of a node before it, which
+		is ideal for building the tree, but a walk from the root goes backwards in memory,
+		and finding the first child means walking back over the others.
+		A compact_tree stores the same tree in preorder, so a walk from the root goes forwards:
+
+		Node (8 bytes)
+		Child 0
+		...
+		Child n
+
+		and the length of a node is of its whole subtree, so NextSibling() skips the subtree.
+		The layout of a token is as follows:
+
+		Node (8 bytes)
+		TokenData
+		Text (if copied, as in a Stack)
+
+		There are no child tables.
+	*/
+	class compact_node
+	{
+	private:
+		friend class compact_tree;
+
+		unsigned length; // The total length of this node and its subtree in bytes
+
+		unsigned short numberOfChildren;
+
+	public:
+		typedef unsigned size_type;
+
+		compact_node(short kind, unsigned short children, size_type length) :
+			length(length), numberOfChildren(children), Kind(kind)
+		{
+		}
+
+		short Kind;
+
+		unsigned short size() const { return numberOfChildren; }
+
+		bool operator==(int kind) const
+		{
+			return Kind == kind;
+		}
+
+		bool IsToken() const { return numberOfChildren == 0; }
+
+		// The first child, immediately after this node.
+		// Undefined if IsToken()==true
+		const compact_node* FirstChild() const { return this + 1; }
+
+		// The node after this subtree, which is the next sibling of this node if there is one.
+		const compact_node* NextSibling() const
+		{
+			return (const compact_node*)((const char*)this + length);
+		}
+
+		// The next node in preorder.
+		const compact_node* Next() const
+		{
+			return IsToken() ? NextSibling() : FirstChild();
+		}
+
+		// Takes linear time in the index.
+		const compact_node& operator[](unsigned short index) const
+		{
+			assert(index < size());
+			const compact_node* c = FirstChild();
+			for (; index > 0; --index)
+				c = c->NextSibling();
+			return *c;
+		}
+
+		// The children in order, as a forward range.
+		class child_range;
+		child_range children() const;
+
+		// Gets the token data if this is a token (IsToken()==true)
+		// Undefined if IsToken()==false
+		const TokenData* GetToken() const
+		{
+			return (const TokenData*)(this + 1);
+		}
+
+		// Whether the text of the token was copied into the tree (see Stack).
+		bool HasText() const { return IsToken() && length > sizeof(compact_node) + sizeof(TokenData); }
+
+		const wchar_t* WText() const { return HasText() ? (const wchar_t*)(GetToken() + 1) : L""; }
+
+		size_type WTextLength() const { return HasText() ? (length - sizeof(compact_node) - sizeof(TokenData))/sizeof(wchar_t) - 1 : 0; }
+
+		std::wstring_view WTextView() const { return std::wstring_view(WText(), WTextLength()); }
+
+		std::wstring Str() const {
+			return std::wstring(WText());
+		}
+
+		// The text of the token in the source that was parsed, as Node::Text.
+		template<typename Ch>
+		std::basic_string_view<Ch> Text(const Ch* source) const
+		{
+			return IsToken() ? std::basic_string_view<Ch>(source + GetToken()->offset, GetToken()->length) : std::basic_string_view<Ch>();
+		}
+	};
+
+	class compact_node::child_range
+	{
+	public:
+		explicit child_range(const compact_node& parent) : parent(parent) {}
+
+		unsigned short size() const { return parent.size(); }
+
+		class iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef compact_node value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const compact_node* pointer;
+			typedef const compact_node& reference;
+
+			explicit iterator(const compact_node* node) : node(node) {}
+
+			const compact_node& operator*() const { return *node; }
+			const compact_node* operator->() const { return node; }
+
+			iterator& operator++()
+			{
+				node = node->NextSibling();
+				return *this;
+			}
+
+			iterator operator++(int)
+			{
+				iterator result = *this;
+				node = node->NextSibling();
+				return result;
+			}
+
+			bool operator==(const iterator& other) const { return node == other.node; }
+			bool operator!=(const iterator& other) const { return node != other.node; }
+
+		private:
+			const compact_node* node;
+		};
+
+		iterator begin() const { return iterator(parent.IsToken() ? parent.NextSibling() : parent.FirstChild()); }
+		iterator end() const { return iterator(parent.NextSibling()); }
+
+	private:
+		const compact_node& parent;
+	};
+
+	inline compact_node::child_range compact_node::children() const
+	{
+		return child_range(*this);
+	}
+
+	/*
+		A tree that has been rewritten from a Stack into preorder (see compact_node),
+		for trees that are walked from the root many times after they are built.
+
+			compact_tree tree(result.root());
+			for (const compact_node* n = &tree.root(); n != tree.end(); n = n->Next())
+				... // Every node in preorder
+
+		The bytes are allocated to the exact size of the tree, without the spare capacity
+		of a Stack.
+	*/
+	class compact_tree
+	{
+	public:
+		compact_tree();
+
+		// Copies the subtree of a node. This does not recurse, so works on trees of any depth.
+		explicit compact_tree(const Node& root);
+
+		// Gets the root of the tree.
+		// Undefined if the tree is empty.
+		const compact_node& root() const { return *(const compact_node*)bytes.data(); }
+
+		// The end of the nodes in preorder.
+		const compact_node* end() const { return (const compact_node*)(bytes.data() + bytes.size()); }
+
+		bool empty() const { return bytes.empty(); }
+
+		// The size of the tree in bytes.
+		std::size_t size() const { return bytes.size(); }
+
+	private:
+		std::vector<char> bytes;
+	};
+}
@@ -0,0 +1,180 @@
+#include "slurp.hpp"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace
+{
+	const std::uint16_t no_state = 0xffff;
+
+	std::int32_t pack(slurp::lr_action a)
+	{
+		return (a.value << 3) | a.action;
+	}
+
+	// Overlays rows of (column, value) entries into check/value arrays, where
+	// row r is at base[r] and check records the row of each entry.
+	template<typename Value>
+	void displace(const std::vector<std::vector<std::pair<int, Value>>>& rows, int columns,
+		std::vector<std::int32_t>& base, std::vector<std::uint16_t>& check, std::vector<Value>& value)
+	{
+		std::vector<int> order;
+		for (int r = 0; r < (int)rows.size(); ++r)
+			order.push_back(r);
+
+		// Placing the densest rows first packs better
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return rows[a].size() > rows[b].size(); });
+
+		base.assign(rows.size(), 0);
+		check.clear();
+		value.clear();
+
+		for (int r : order)
+		{
+			if (rows[r].empty()) continue;
+
+			int b = 0;
+			for (;; ++b)
+			{
+				bool fits = true;
+				for (const auto& e : rows[r])
+					if (b + e.first < (int)check.size() && check[b + e.first] != no_state)
+					{
+						fits = false;
+						break;
+					}
+				if (fits) break;
+			}
+
+			base[r] = b;
+			for (const auto& e : rows[r])
+			{
+				if (b + e.first >= (int)check.size())
+				{
+					check.resize(b + e.first + 1, no_state);
+					value.resize(b + e.first + 1, Value());
+				}
+				check[b + e.first] = (std::uint16_t)r;
+				value[b + e.first] = e.second;
+			}
+		}
+
+		// Every row can be indexed by any column
+		int size = columns;
+		for (int b : base)
+			size = std::max(size, b + columns);
+		check.resize(size, no_state);
+		value.resize(size, Value());
+	}
+
+	// The most common value in a row, or fallback if the row is empty.
+	template<typename Value>
+	Value most_common(const std::vector<Value>& values, Value fallback)
+	{
+		std::map<Value, int> counts;
+		Value result = fallback;
+		int best = 0;
+		for (Value v : values)
+			if (++counts[v] > best || (counts[v] == best && v < result))
+			{
+				best = counts[v];
+				result = v;
+			}
+		return result;
+	}
+}
+
+void slurp::compressed_tables::compress(const std::vector<lr_action>& dense)
+{
+	assert(number_of_states < no_state);
+	auto dense_action = [&](int s, int x) { return dense[s * number_of_symbols + x]; };
+
+	// The default reduction of each state, or an error
+	default_action.resize(number_of_states);
+	for (int s = 0; s < number_of_states; ++s)
+	{
+		std::vector<int> reductions;
+		for (int t = 0; t < number_of_terminals; ++t)
+			if (dense_action(s, t).action == lr_reduce)
+				reductions.push_back(dense_action(s, t).rule());
+		default_action[s] = reductions.empty() ? pack(lr_action{ lr_error, 0 }) : pack(lr_action{ lr_reduce, most_common(reductions, 0) });
+	}
+
+	// The actions that are not the default
+	std::vector<std::vector<std::pair<int, std::int32_t>>> rows(number_of_states);
+	for (int s = 0; s < number_of_states; ++s)
+	{
+		bool reduces = lr_action_type(default_action[s] & 7) == lr_reduce;
+		for (int t = 0; t < number_of_terminals; ++t)
+		{
+			lr_action a = dense_action(s, t);
+			if (pack(a) != default_action[s] && !(a.action == lr_error && reduces))
+				rows[s].push_back(std::make_pair(t, pack(a)));
+		}
+	}
+
+	// A state whose only action is its default reduction
+	auto reduce_only = [&](int s) {
+		if (!rows[s].empty() || lr_action_type(default_action[s] & 7) != lr_reduce)
+			return false;
+		for (int n = number_of_terminals; n < number_of_symbols; ++n)
+			if (dense_action(s, n).action == lr_goto)
+				return false;
+		return true;
+	};
+
+	fused_shifts = 0;
+	for (int s = 0; s < number_of_states; ++s)
+		for (auto& e : rows[s])
+		{
+			lr_action a = compressed_table_view::unpack(e.second);
+			if (a.action == lr_shift && reduce_only(a.state()))
+			{
+				e.second = pack(lr_action{ lr_shift_reduce, compressed_table_view::unpack(default_action[a.state()]).rule() });
+				++fused_shifts;
+			}
+		}
+
+	displace(rows, number_of_terminals, base, check, value);
+
+	// The gotos of each nonterminal, with the most common target as the default
+	int number_of_nonterminals = number_of_symbols - number_of_terminals;
+	assert(number_of_nonterminals < no_state);
+	std::vector<std::vector<std::pair<int, std::uint16_t>>> gotos(number_of_nonterminals);
+	goto_default.resize(number_of_nonterminals);
+	for (int n = 0; n < number_of_nonterminals; ++n)
+	{
+		std::vector<std::uint16_t> targets;
+		for (int s = 0; s < number_of_states; ++s)
+			if (dense_action(s, number_of_terminals + n).action == lr_goto)
+				targets.push_back((std::uint16_t)dense_action(s, number_of_terminals + n).state());
+
+		goto_default[n] = most_common(targets, std::uint16_t(0));
+
+		for (int s = 0; s < number_of_states; ++s)
+		{
+			lr_action a = dense_action(s, number_of_terminals + n);
+			if (a.action == lr_goto && a.state() != goto_default[n])
+				gotos[n].push_back(std::make_pair(s, (std::uint16_t)a.state()));
+		}
+	}
+
+	// Goto rows are indexed by state, and the check is the nonterminal
+	displace(gotos, number_of_states, goto_base, goto_check, goto_value);
+}
+
+slurp::compressed_table_view slurp::compressed_tables::view() const
+{
+	return compressed_table_view{
+		base.data(), check.data(), value.data(), default_action.data(),
+		goto_base.data(), goto_check.data(), goto_value.data(), goto_default.data(),
+		rules.data(), terminals.data(), number_of_terminals, min_kind, (int)terminals.size() };
+}
+
+std::size_t slurp::compressed_tables::size() const
+{
+	return (base.size() + value.size() + default_action.size() + goto_base.size()) * sizeof(std::int32_t) +
+		(check.size() + goto_check.size() + goto_value.size() + goto_default.size()) * sizeof(std::uint16_t) +
+		rules.size() * sizeof(lr_rule) + terminals.size() * sizeof(short);
+}
@@ -0,0 +1,123 @@
+/*
+	Compressed LR parser tables.
+
+	Dense tables (lalr_tables, runtime_tables) have a row of number_of_symbols actions
+	for every state, which is mostly errors. compressed_tables stores the same parser in
+	a fraction of the space, using the usual techniques of yacc and Bison:
+
+	- Default reductions. The most common reduce in each row is the default action of
+	  the state, and is not stored. This also replaces the errors of that row, which
+	  delays (but does not miss) the detection of syntax errors.
+	- Row displacement. The remaining terminal actions of all rows are overlaid in one
+	  array (a comb vector), with a base offset per state, and a check array that records
+	  which state owns each entry.
+	- A separate goto table, indexed by nonterminal, where the most common target of each
+	  nonterminal is its default, and the other targets are displaced by state.
+	- Shift-reduce fusion. A shift into a state whose only action is a reduce
+	  becomes lr_shift_reduce, so the parser reduces without looking at the next token.
+
+	compressed_tables can be built from any dense tables, and view() gives a
+	compressed_table_view that can be used with lr_parser.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace slurp
+{
+	// A view of compressed_tables, which can be used as the Tables of an lr_parser.
+	struct compressed_table_view
+	{
+		const std::int32_t* base;  // The offset of each state in check/value
+		const std::uint16_t* check;  // The state owning each entry
+		const std::int32_t* value;  // The packed action of each entry
+		const std::int32_t* default_action;  // The packed default action of each state
+
+		const std::int32_t* goto_base;  // The offset of each nonterminal in goto_check/goto_value
+		const std::uint16_t* goto_check;  // The nonterminal owning each entry
+		const std::uint16_t* goto_value;
+		const std::uint16_t* goto_default;  // The most common goto of each nonterminal
+
+		const lr_rule* rules;
+		const short* terminals;
+		int number_of_terminals, min_kind, kind_range;
+
+		static lr_action unpack(std::int32_t a)
+		{
+			return lr_action{ lr_action_type(a & 7), a >> 3 };
+		}
+
+		lr_action action(int state, int symbol) const
+		{
+			if (symbol >= number_of_terminals)
+				return lr_action{ lr_goto, goto_state(state, symbol - number_of_terminals) };
+
+			int i = base[state] + symbol;
+			return unpack(check[i] == state ? value[i] : default_action[state]);
+		}
+
+		int goto_state(int state, int nonterminal) const
+		{
+			int i = goto_base[nonterminal] + state;
+			return goto_check[i] == nonterminal ? goto_value[i] : goto_default[nonterminal];
+		}
+
+		const lr_rule& rule(int r) const
+		{
+			return rules[r];
+		}
+
+		int terminal(int kind) const
+		{
+			return kind < min_kind || kind >= min_kind + kind_range ? -1 : terminals[kind - min_kind];
+		}
+	};
+
+	class compressed_tables
+	{
+	public:
+		// Compresses dense tables.
+		template<typename Tables>
+		explicit compressed_tables(const Tables& tables) :
+			number_of_states(tables.number_of_states), number_of_symbols(tables.number_of_symbols),
+			number_of_terminals(tables.number_of_terminals), min_kind(tables.min_kind)
+		{
+			std::vector<lr_action> dense;
+			for (int s = 0; s < number_of_states; ++s)
+				for (int x = 0; x < number_of_symbols; ++x)
+					dense.push_back(tables.action(s, x));
+
+			for (int r = 0; r < tables.number_of_rules; ++r)
+				rules.push_back(tables.rule(r));
+
+			for (int k = tables.min_kind; k <= tables.max_kind; ++k)
+				terminals.push_back((short)tables.terminal(k));
+
+			compress(dense);
+		}
+
+		int number_of_states, number_of_symbols, number_of_terminals, min_kind;
+
+		// The number of shifts that were fused with a reduce.
+		int fused_shifts;
+
+		compressed_table_view view() const;
+
+		lr_action action(int state, int symbol) const { return view().action(state, symbol); }
+		const lr_rule& rule(int r) const { return rules[r]; }
+		int terminal(int kind) const { return view().terminal(kind); }
+
+		// The size of the tables in bytes.
+		std::size_t size() const;
+
+	private:
+		std::vector<std::int32_t> base, value, default_action, goto_base;
+		std::vector<std::uint16_t> check, goto_check, goto_value, goto_default;
+		std::vector<lr_rule> rules;
+		std::vector<short> terminals;
+
+		void compress(const std::vector<lr_action>& dense);
+	};
+}
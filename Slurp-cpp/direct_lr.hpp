@@ -0,0 +1,188 @@
+/*
+	A direct-coded LR parser.
+
+	direct_lr<Symbol>(tokenizer, begin, end)
+
+	parses using the LALR(1) tables of Symbol (lalr_tables<Symbol>), but instead of
+	interpreting the tables at runtime, each state is compiled into its own function
+	step<State>() in which the action for each lookahead is a compile-time constant.
+	A shift goes straight to its target state, a reduce knows the length, kind and
+	nonterminal of its rule, and only the goto after a reduce depends on the state
+	stack. There is no table lookup and no decoding of actions in the parser loop.
+
+	The tree is written into a Stack using Shift and Reduce, in the same way as
+	recursive_descent, so both parsers produce identical trees:
+
+	- A token is shifted with its text, or only its offset and length with reference_text.
+	- Rule<Kind> (an empty rule) shifts a node with no children and no text.
+	- Rule<Kind, Xs...> reduces its children into a node of kind Kind.
+	- A pass-through alternative does not create a node.
+
+	direct_lr_actions<Symbol>(actions, tokenizer, begin, end) instead computes a value
+	with semantic actions (see parse_actions.hpp), where the kind of each rule is a
+	compile-time constant.
+
+	The state stack is a std::vector of the states below the current state, so the
+	depth of the input is not limited by the C++ call stack.
+
+	This needs a grammar without conflicts, and compiles one function per state, so
+	code size grows with the number of states times the number of terminals.
+*/
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace slurp
+{
+	namespace helpers
+	{
+		// Parses into Output, which is a Stack or an action_stack.
+		template<typename Tables, typename Tokenizer, typename It, typename Output>
+		class direct_lr
+		{
+		public:
+			direct_lr(Tokenizer tok, It a, It b, Output& output) : tokenizer(tok), pos(a, b), stack(output)
+			{
+				states.reserve(64);
+			}
+
+			// Returns whether the input was accepted.
+			bool parse()
+			{
+				next_token();
+
+				int state = 0;
+				while (state >= 0)
+					state = dispatch(state, std::make_integer_sequence<int, Tables::number_of_states>());
+
+				return state == accepted;
+			}
+
+			// The token where the parse stopped, which is the syntax error if the input was not accepted.
+			const TokenData& position() const { return pos.data; }
+
+		private:
+			static_assert(Tables::conflicts == 0, "The grammar of a direct-coded LR parser must not have conflicts");
+
+			static const int accepted = -2, rejected = -1;
+
+			Tokenizer tokenizer;
+			token_position<It> pos;
+			int terminal;
+			Output& stack;
+
+			// The states below the current state.
+			std::vector<int> states;
+
+			void next_token()
+			{
+				tokenizer.MoveNext(pos);
+				terminal = Tables::terminal(pos.kind);
+			}
+
+			// Calls step<S>() for the current state.
+			// This is a switch on the state once optimised.
+			template<int... S>
+			int dispatch(int state, std::integer_sequence<int, S...>)
+			{
+				int next = rejected;
+				(void)((state == S && (next = step<S>(), true)) || ...);
+				return next;
+			}
+
+			// The goto of Symbol from the state exposed by a reduce.
+			template<int Symbol, int... S>
+			static int goto_state(int state, std::integer_sequence<int, S...>)
+			{
+				int next = rejected;
+				(void)((state == S && (next = Tables::action(S, Symbol).state(), true)) || ...);
+				return next;
+			}
+
+			// Runs the action of state S on the current lookahead.
+			template<int S>
+			int step()
+			{
+				return step<S>(std::make_integer_sequence<int, Tables::number_of_terminals>());
+			}
+
+			template<int S, int... T>
+			int step(std::integer_sequence<int, T...>)
+			{
+				int next = rejected;
+				(void)((Tables::action(S, T).action != lr_error && terminal == T && (next = act<S, T>(), true)) || ...);
+				return next;
+			}
+
+			template<int S, int T>
+			int act()
+			{
+				constexpr lr_action a = Tables::action(S, T);
+
+				if constexpr (a.action == lr_shift)
+				{
+					stack.Shift(pos.kind, pos.data, pos.begin(), pos.end());
+					next_token();
+					states.push_back(S);
+					return a.state();
+				}
+				else if constexpr (a.action == lr_reduce)
+					return reduce<S, a.rule()>();
+				else if constexpr (a.action == lr_accept)
+					return accepted;
+				else
+					return rejected;
+			}
+
+			template<int S, int R>
+			int reduce()
+			{
+				constexpr lr_rule r = Tables::rule(R);
+
+				if constexpr (r.node && r.length == 0)
+					stack.Shift(rule_kind<r.kind>(), pos.data, 0);  // A node with no children
+				else if constexpr (r.node)
+					stack.Reduce(rule_kind<r.kind>(), r.length);
+
+				// Pop the states of the rule, exposing the state before it
+				int state = S;
+				if constexpr (r.length > 0)
+				{
+					state = states[states.size() - r.length];
+					states.resize(states.size() - r.length + 1);
+				}
+				else
+					states.push_back(S);
+
+				return goto_state<r.symbol>(state, std::make_integer_sequence<int, Tables::number_of_states>());
+			}
+		};
+	}
+
+	// Parses the input using a direct-coded LR parser for Grammar.
+	// The options say how the tree is stored (see Stack).
+	template<typename Grammar, typename Tokenizer, typename It>
+	parse_result direct_lr(Tokenizer tok, It a, It b, const stack_options& options = stack_options())
+	{
+		Stack stack(options);
+		helpers::direct_lr<lalr_tables<Grammar>, Tokenizer, It, Stack> parser(tok, a, b, stack);
+		if (parser.parse())
+			return stack;
+
+		parse_result error;
+		error.syntaxError = parser.position();
+		return error;
+	}
+
+	// Parses the input using a direct-coded LR parser for Grammar, and computes its value with actions.
+	template<typename Grammar, typename Actions, typename Tokenizer, typename It>
+	action_result<typename Actions::value_type> direct_lr_actions(Actions& actions, Tokenizer tok, It a, It b)
+	{
+		action_stack<Actions> stack(actions);
+		helpers::direct_lr<lalr_tables<Grammar>, Tokenizer, It, action_stack<Actions>> parser(tok, a, b, stack);
+		bool success = parser.parse();
+		return stack.Result(success, parser.position());
+	}
+}
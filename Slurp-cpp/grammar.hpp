@@ -0,0 +1,515 @@
+/*
+	Flattens a grammar into constexpr arrays of productions, and computes
+	nullable, FIRST and FOLLOW using a fixpoint iteration.
+
+	flat_grammar<Root>
+
+	collects every symbol reachable from Root, and numbers them: first the terminals
+	(eof is always terminal 0), then the nonterminals (Root is the first nonterminal).
+
+	A nonterminal is either a class with a "rule", or an anonymous Rule<> or Rules<>
+	that appears inside another rule. Its productions are:
+
+	Rules<A, B...>     - one production for each alternative
+	Rule<Kind, Xs...>  - a production Xs that creates a node of the given kind
+	X (anything else)  - a pass-through production X that does not create a node
+
+	grammar_analysis<Grammar>::sets
+
+	holds the nullable, FIRST and FOLLOW sets of each symbol, as bitsets over the terminals.
+	These are computed with an ordinary fixpoint iteration in constexpr functions, so are correct
+	for arbitrary recursion, and cost one template instantiation per grammar rather than one
+	per recursive context.
+
+	grammar_nullable<Grammar, S>::value
+	grammar_first<Grammar, S>::type
+	grammar_follow<Grammar, S>::type
+
+	give the results for a symbol S as a typeset of tokens.
+*/
+
+#pragma once
+
+#include <utility>
+
+namespace slurp
+{
+	typedef Token<-1, void> eof;
+
+	struct is_terminal
+	{
+		template<typename S>
+		struct predicate
+		{
+			static const bool value = false;
+		};
+
+		template<int N, typename T>
+		struct predicate<Token<N, T>>
+		{
+			static const bool value = true;
+		};
+	};
+
+	// A production in a flat_grammar.
+	struct production
+	{
+		int lhs;  // The symbol being defined
+		int rhs;  // The index of the first symbol in flat_grammar::rhs
+		int length;  // The number of symbols in the production
+		short kind;  // The kind of node created when the production is reduced
+		bool node;  // false for a pass-through production which does not create a node
+	};
+
+	namespace helpers
+	{
+		// A list of types, which unlike a typeset may contain duplicates.
+		template<typename... Ts>
+		struct list
+		{
+			static const int size = sizeof...(Ts);
+		};
+
+		template<typename... Ls>
+		struct concat;
+
+		template<>
+		struct concat<>
+		{
+			typedef list<> type;
+		};
+
+		template<typename... A>
+		struct concat<list<A...>>
+		{
+			typedef list<A...> type;
+		};
+
+		template<typename... A, typename... B>
+		struct concat<list<A...>, list<B...>>
+		{
+			typedef list<A..., B...> type;
+		};
+
+		template<typename... A, typename... B, typename... C, typename... D, typename... Ls>
+		struct concat<list<A...>, list<B...>, list<C...>, list<D...>, Ls...>
+		{
+			typedef typename concat<list<A..., B..., C..., D...>, Ls...>::type type;
+		};
+
+		template<typename... A, typename... B, typename... C>
+		struct concat<list<A...>, list<B...>, list<C...>>
+		{
+			typedef list<A..., B..., C...> type;
+		};
+
+		// The rule of a nonterminal symbol.
+		template<typename S>
+		struct symbol_rule
+		{
+			typedef typename S::rule type;
+		};
+
+		template<int Kind, typename... Ts>
+		struct symbol_rule<Rule<Kind, Ts...>>
+		{
+			typedef Rule<Kind, Ts...> type;
+		};
+
+		template<typename... Ts>
+		struct symbol_rule<Rules<Ts...>>
+		{
+			typedef Rules<Ts...> type;
+		};
+
+		// The symbols referred to by one alternative of a rule.
+		template<typename Alternative>
+		struct alternative_symbols
+		{
+			typedef list<Alternative> type;
+		};
+
+		template<int Kind, typename... Ts>
+		struct alternative_symbols<Rule<Kind, Ts...>>
+		{
+			typedef list<Ts...> type;
+		};
+
+		template<typename Body>
+		struct body_symbols
+		{
+			typedef typename alternative_symbols<Body>::type type;
+		};
+
+		template<typename... Alternatives>
+		struct body_symbols<Rules<Alternatives...>>
+		{
+			typedef typename concat<typename alternative_symbols<Alternatives>::type...>::type type;
+		};
+
+		// The symbols directly referred to by a symbol.
+		template<typename S, bool Terminal = is_terminal::predicate<S>::value>
+		struct symbol_successors
+		{
+			typedef typename body_symbols<typename symbol_rule<S>::type>::type type;
+		};
+
+		template<typename S>
+		struct symbol_successors<S, true>
+		{
+			typedef list<> type;
+		};
+
+		template<typename T, typename... Ts>
+		constexpr bool list_contains(list<Ts...>)
+		{
+			const bool matches[] = { false, std::is_same<T, Ts>::value... };
+			for (bool m : matches)
+				if (m) return true;
+			return false;
+		}
+
+		// true if T is not in Visited, and position N is the first occurrence of T in Ts.
+		template<typename T, int N, typename Visited, typename... Ts>
+		constexpr bool is_new_symbol()
+		{
+			return !list_contains<T>(Visited()) && index_of<T, Ts...>() == N;
+		}
+
+		// Keeps each type in Ts that is not in Visited, and is the first occurrence in Ts.
+		template<typename Visited, typename Ts, typename Sequence>
+		struct new_symbols;
+
+		template<typename Visited, typename... Ts, std::size_t... I>
+		struct new_symbols<Visited, list<Ts...>, std::index_sequence<I...>>
+		{
+			typedef typename concat<typename std::conditional<is_new_symbol<Ts, (int)I, Visited, Ts...>(), list<Ts>, list<>>::type...>::type type;
+		};
+
+		// Breadth-first search for the symbols reachable from Frontier.
+		template<typename Frontier, typename Visited>
+		struct reachable;
+
+		template<typename... Visited>
+		struct reachable<list<>, list<Visited...>>
+		{
+			typedef list<Visited...> type;
+		};
+
+		template<typename F, typename... Fs, typename... Visited>
+		struct reachable<list<F, Fs...>, list<Visited...>>
+		{
+			typedef list<Visited..., F, Fs...> visited;
+			typedef typename concat<typename symbol_successors<F>::type, typename symbol_successors<Fs>::type...>::type successors;
+			typedef typename new_symbols<visited, successors, std::make_index_sequence<successors::size>>::type frontier;
+			typedef typename reachable<frontier, visited>::type type;
+		};
+
+
+		template<typename T>
+		struct is_same_as
+		{
+			template<typename U>
+			struct predicate
+			{
+				static const bool value = std::is_same<T, U>::value;
+			};
+		};
+
+		// Selects the types in a list that satisfy (or do not satisfy) a predicate.
+		template<typename Ts, typename Predicate, bool Value>
+		struct select;
+
+		template<typename... Ts, typename Predicate, bool Value>
+		struct select<list<Ts...>, Predicate, Value>
+		{
+			typedef typename concat<typename std::conditional<
+				Predicate::template predicate<Ts>::value == Value, list<Ts>, list<>>::type...>::type type;
+		};
+
+		template<typename Ts>
+		struct to_typeset;
+
+		template<typename... Ts>
+		struct to_typeset<list<Ts...>>
+		{
+			typedef typeset<Ts...> type;
+		};
+
+		// A production of a nonterminal.
+		template<typename Lhs, int Kind, bool Node, typename... Rhs>
+		struct flat_production
+		{
+			typedef Lhs lhs;
+			typedef list<Rhs...> rhs;
+			static const short kind = Kind;
+			static const bool node = Node;
+			static const int length = sizeof...(Rhs);
+		};
+
+		template<typename S, typename Alternative>
+		struct alternative_productions
+		{
+			typedef list<flat_production<S, 0, false, Alternative>> type;
+		};
+
+		template<typename S, int Kind, typename... Ts>
+		struct alternative_productions<S, Rule<Kind, Ts...>>
+		{
+			typedef list<flat_production<S, Kind, true, Ts...>> type;
+		};
+
+		template<typename S, typename Body>
+		struct body_productions
+		{
+			typedef typename alternative_productions<S, Body>::type type;
+		};
+
+		template<typename S, typename... Alternatives>
+		struct body_productions<S, Rules<Alternatives...>>
+		{
+			typedef typename concat<typename alternative_productions<S, Alternatives>::type...>::type type;
+		};
+
+		template<typename Nonterminals>
+		struct all_productions;
+
+		template<typename... Ns>
+		struct all_productions<list<Ns...>>
+		{
+			typedef typename concat<typename body_productions<Ns, typename symbol_rule<Ns>::type>::type...>::type type;
+		};
+
+		template<typename Productions>
+		struct all_rhs;
+
+		template<typename... Ps>
+		struct all_rhs<list<Ps...>>
+		{
+			typedef typename concat<typename Ps::rhs...>::type type;
+		};
+
+		template<typename T>
+		struct token_kind;
+
+		template<int Kind, typename T>
+		struct token_kind<Token<Kind, T>>
+		{
+			static const short value = Kind;
+		};
+
+		template<int... Lengths>
+		constexpr int prefix_sum(int n)
+		{
+			const int lengths[] = { Lengths..., 0 };
+			int result = 0;
+			for (int i = 0; i < n; ++i)
+				result += lengths[i];
+			return result;
+		}
+
+		// The symbols and productions of a grammar.
+		template<typename Root>
+		struct grammar_symbols
+		{
+			typedef typename reachable<list<Root>, list<>>::type reachable_symbols;
+			typedef typename select<reachable_symbols, is_same_as<eof>, false>::type without_eof;
+			typedef typename concat<list<eof>, typename select<without_eof, is_terminal, true>::type>::type terminals;
+			typedef typename select<reachable_symbols, is_terminal, false>::type nonterminals;
+			typedef typename concat<terminals, nonterminals>::type symbols;
+			typedef typename all_productions<nonterminals>::type productions;
+			typedef typename all_rhs<productions>::type rhs;
+		};
+
+		template<typename Symbols, typename Terminals, typename Productions, typename Rhs, typename Sequence>
+		struct grammar_arrays;
+
+		template<typename... Ss, typename... Ts, typename... Ps, typename... Rs, std::size_t... I>
+		struct grammar_arrays<list<Ss...>, list<Ts...>, list<Ps...>, list<Rs...>, std::index_sequence<I...>>
+		{
+			static const int number_of_symbols = sizeof...(Ss);
+			static const int number_of_terminals = sizeof...(Ts);
+			static const int number_of_nonterminals = number_of_symbols - number_of_terminals;
+			static const int number_of_productions = sizeof...(Ps);
+			static const int rhs_size = sizeof...(Rs);
+
+			// The token kind of each terminal.
+			static constexpr short kinds[] = { token_kind<Ts>::value... };
+
+			// The symbols on the right hand side of all productions.
+			// Terminated by -1 so that the array is never empty.
+			static constexpr int rhs[] = { index_of<Rs, Ss...>()..., -1 };
+
+			static constexpr production productions[] = {
+				production { index_of<typename Ps::lhs, Ss...>(), prefix_sum<Ps::length...>(I), Ps::length, Ps::kind, Ps::node }...
+			};
+		};
+
+		template<typename... Ss, typename... Ts, typename... Ps, typename... Rs, std::size_t... I>
+		constexpr short grammar_arrays<list<Ss...>, list<Ts...>, list<Ps...>, list<Rs...>, std::index_sequence<I...>>::kinds[];
+
+		template<typename... Ss, typename... Ts, typename... Ps, typename... Rs, std::size_t... I>
+		constexpr int grammar_arrays<list<Ss...>, list<Ts...>, list<Ps...>, list<Rs...>, std::index_sequence<I...>>::rhs[];
+
+		template<typename... Ss, typename... Ts, typename... Ps, typename... Rs, std::size_t... I>
+		constexpr production grammar_arrays<list<Ss...>, list<Ts...>, list<Ps...>, list<Rs...>, std::index_sequence<I...>>::productions[];
+	}
+
+	template<typename Root>
+	struct flat_grammar : helpers::grammar_arrays<
+		typename helpers::grammar_symbols<Root>::symbols,
+		typename helpers::grammar_symbols<Root>::terminals,
+		typename helpers::grammar_symbols<Root>::productions,
+		typename helpers::grammar_symbols<Root>::rhs,
+		std::make_index_sequence<helpers::grammar_symbols<Root>::productions::size>>
+	{
+		static_assert(!is_terminal::predicate<Root>::value, "The root of a grammar must be a nonterminal");
+
+		typedef typename helpers::to_typeset<typename helpers::grammar_symbols<Root>::terminals>::type terminals;
+		typedef typename helpers::to_typeset<typename helpers::grammar_symbols<Root>::nonterminals>::type nonterminals;
+		typedef typename helpers::to_typeset<typename helpers::grammar_symbols<Root>::symbols>::type symbols;
+
+		// The ordinal of the root symbol.
+		static const int root = flat_grammar::number_of_terminals;
+
+		// The ordinal of a symbol, or -1 if it is not in the grammar.
+		template<typename S>
+		struct symbol
+		{
+			static const int value = ts_index<S, symbols>::value;
+		};
+
+		static constexpr bool terminal(int symbol)
+		{
+			return symbol < flat_grammar::number_of_terminals;
+		}
+	};
+
+	// The nullable, FIRST and FOLLOW sets of a flat_grammar.
+	template<typename Grammar>
+	struct grammar_sets
+	{
+		typedef bitset<Grammar::number_of_terminals> terminal_set;
+
+		bool nullable[Grammar::number_of_symbols];
+		terminal_set first[Grammar::number_of_symbols];
+		terminal_set follow[Grammar::number_of_symbols];
+
+		constexpr grammar_sets() : nullable{}, first{}, follow{}
+		{
+			for (int t = 0; t < Grammar::number_of_terminals; ++t)
+				first[t].insert(t);
+
+			// End of input follows the root
+			follow[Grammar::root].insert(0);
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (const production& p : Grammar::productions)
+				{
+					if (!nullable[p.lhs] && nullable_of(p.rhs, p.rhs + p.length))
+						nullable[p.lhs] = changed = true;
+
+					for (int i = p.rhs; i < p.rhs + p.length; ++i)
+					{
+						changed = first[p.lhs].insert_all(first[Grammar::rhs[i]]) || changed;
+						if (!nullable[Grammar::rhs[i]]) break;
+					}
+				}
+			}
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (const production& p : Grammar::productions)
+				{
+					// The terminals that can follow rhs[i]
+					terminal_set trailer = follow[p.lhs];
+					for (int i = p.rhs + p.length - 1; i >= p.rhs; --i)
+					{
+						int s = Grammar::rhs[i];
+						if (!Grammar::terminal(s))
+							changed = follow[s].insert_all(trailer) || changed;
+						if (nullable[s])
+							trailer.insert_all(first[s]);
+						else
+							trailer = first[s];
+					}
+				}
+			}
+		}
+
+		// Whether the symbols rhs[begin, end) can all be empty.
+		constexpr bool nullable_of(int begin, int end) const
+		{
+			for (int i = begin; i < end; ++i)
+				if (!nullable[Grammar::rhs[i]]) return false;
+			return true;
+		}
+
+		// The first terminals of the symbols rhs[begin, end).
+		constexpr terminal_set first_of(int begin, int end) const
+		{
+			terminal_set result;
+			for (int i = begin; i < end; ++i)
+			{
+				result.insert_all(first[Grammar::rhs[i]]);
+				if (!nullable[Grammar::rhs[i]]) break;
+			}
+			return result;
+		}
+	};
+
+	template<typename Grammar>
+	struct grammar_analysis
+	{
+		static constexpr grammar_sets<Grammar> sets = grammar_sets<Grammar>();
+	};
+
+	template<typename Grammar>
+	constexpr grammar_sets<Grammar> grammar_analysis<Grammar>::sets;
+
+	namespace helpers
+	{
+		template<typename Grammar, int Symbol, bool Follow, typename Sequence>
+		struct terminal_bits;
+
+		template<typename Grammar, int Symbol, bool Follow, std::size_t... W>
+		struct terminal_bits<Grammar, Symbol, Follow, std::index_sequence<W...>>
+		{
+			typedef ts_bits<typename Grammar::terminals, (Follow ?
+				grammar_analysis<Grammar>::sets.follow[Symbol] :
+				grammar_analysis<Grammar>::sets.first[Symbol]).words[W]...> type;
+		};
+
+		template<typename Grammar, typename S, bool Follow>
+		struct grammar_set
+		{
+			static const int index = Grammar::template symbol<S>::value;
+			static_assert(index >= 0, "Symbol is not in the grammar");
+
+			typedef typename terminal_bits<Grammar, index, Follow,
+				std::make_index_sequence<grammar_sets<Grammar>::terminal_set::number_of_words>>::type bits;
+			typedef typename ts_from_bits<bits>::type type;
+		};
+	}
+
+	template<typename Grammar, typename S>
+	struct grammar_nullable
+	{
+		static const bool value = grammar_analysis<Grammar>::sets.nullable[Grammar::template symbol<S>::value];
+	};
+
+	// The tokens that can start S, as a typeset (type) or a ts_bits (bits).
+	template<typename Grammar, typename S>
+	struct grammar_first : helpers::grammar_set<Grammar, S, false>
+	{
+	};
+
+	// The tokens that can follow S, as a typeset (type) or a ts_bits (bits).
+	template<typename Grammar, typename S>
+	struct grammar_follow : helpers::grammar_set<Grammar, S, true>
+	{
+	};
+}
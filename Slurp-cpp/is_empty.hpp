@@ -20,78 +20,33 @@
 		>;
 	};
 
-	In order to process this, we can just skip all recursive calls.
+	In order to process this, the grammar reachable from S is flattened (flat_grammar<S>)
+	and nullable is computed as a fixpoint over its productions (see grammar.hpp).
 */
 
 namespace slurp
 {
-
-	template<typename T, typename Visited = ts_empty, bool Recursive = ts_contains<T, Visited>::value>
+	template<typename T>
 	struct is_empty
 	{
-		using visited = typename ts_concat<T, Visited>::type;
-		static const bool value = is_empty<typename T::rule, visited>::value;
-	};
-
-	template<typename T, typename Visited>
-	struct is_empty<T, Visited, true>
-	{
-		// Recursive case
-		static const bool value = false;
-		using visited = Visited;
+		static const bool value = grammar_nullable<flat_grammar<T>, T>::value;
 	};
 
-	template<int N, typename T, typename Visited>
-	struct is_empty<Token<N, T>, Visited, false>
+	template<int N, typename T>
+	struct is_empty<Token<N, T>>
 	{
 		static const bool value = false;
-		using visited = Visited;
 	};
 
-	template<int N, typename Visited>
-	struct is_empty<Ch<N>, Visited, false>
+	template<int N>
+	struct is_empty<Ch<N>>
 	{
 		static const bool value = false;
-		using visited = Visited;
 	};
 
-	template<int A, int B, typename Visited>
-	struct is_empty<Range<A, B>, Visited, false>
+	template<int A, int B>
+	struct is_empty<Range<A, B>>
 	{
 		static const bool value = false;
-		using visited = Visited;
-	};
-
-	template<typename A, typename... B, typename Visited>
-	struct is_empty<Rules<A, B...>, Visited, false>
-	{
-		typedef is_empty<A, Visited> t1;
-		typedef is_empty<Rules<B...>, Visited> t2;
-		static const bool value = t1::value || t2::value;
-		using visited = Visited;
-	};
-
-	template<typename Visited>
-	struct is_empty<Rules<>, Visited, false>
-	{
-		static const bool value = false;
-		using visited = Visited;
-	};
-
-	template<int N, typename Visited>
-	struct is_empty<Rule<N>, Visited, false>
-	{
-		static const bool value = true;
-		using visited = Visited;
-	};
-
-	template<int N, typename T, typename...Ts, typename Visited>
-	struct is_empty<Rule<N, T, Ts...>, Visited, false>
-	{
-		using t1 = is_empty<T, Visited>;
-		using t2 = is_empty<Rule<N, Ts...>, Visited>;
-		using visited = Visited;
-
-		static const bool value = t1::value && t2::value;
 	};
 }
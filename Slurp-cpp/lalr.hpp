@@ -0,0 +1,328 @@
+/*
+	Compile-time LALR(1) parser tables.
+
+	lalr_tables<Symbol>
+
+	builds the parser tables for the grammar with start symbol Symbol:
+
+	1) The grammar is flattened (flat_grammar) and nullable/FIRST are computed.
+	2) The LR(0) states are enumerated (lr0_automaton). Each LR(0) state is
+	   the merge of all of the LR(1) states with the same core.
+	3) LALR(1) lookaheads are propagated through the LR(0) automaton to a fixpoint.
+	4) The action/goto table is filled in, and conflicts are counted.
+
+	The output is in the same shape as a hand written table:
+
+	lalr_tables<Symbol>::states[state].actions[symbol]
+	lalr_tables<Symbol>::rules[rule]
+
+	where terminals are numbered from 0 (eof), followed by nonterminals.
+	The tables are static constexpr arrays, so they are computed once at compile time
+	and placed in read-only data.
+
+	Conflicts are resolved in favour of shift, and then in favour of the
+	earliest rule, but parsers should normally check that conflicts == 0.
+*/
+
+#pragma once
+
+namespace slurp
+{
+	// lr_shift_reduce shifts a token and then reduces a rule, and is only used in
+	// compressed_tables, for a shift into a state whose only action is that reduce.
+	enum lr_action_type { lr_error, lr_shift, lr_reduce, lr_accept, lr_goto, lr_shift_reduce };
+
+	// An entry in the parser table.
+	struct lr_action
+	{
+		lr_action_type action;
+		int value;  // The state to shift or goto, or the rule to reduce
+
+		constexpr int state() const { return value; }
+		constexpr int rule() const { return value; }
+
+		constexpr bool operator==(const lr_action& other) const
+		{
+			return action == other.action && value == other.value;
+		}
+	};
+
+	// A row in the parser table.
+	template<int NumberOfSymbols>
+	struct lr_state
+	{
+		lr_action actions[NumberOfSymbols];
+	};
+
+	// Information about rules, needed when the parser reduces.
+	struct lr_rule
+	{
+		int length;  // The number of symbols to pop
+		int symbol;  // The nonterminal to goto
+		short kind;  // The kind of the node to create
+		bool node;  // Whether to create a node, or leave the single child in place
+	};
+
+	template<typename Grammar, int NumberOfStates>
+	struct lalr_builder
+	{
+		typedef lr_items<Grammar> items_type;
+		typedef typename items_type::item_set item_set;
+		typedef typename grammar_sets<Grammar>::terminal_set terminal_set;
+
+		static const int number_of_items = items_type::number_of_items;
+
+		items_type items;
+		item_set closure[NumberOfStates];
+		int transitions[NumberOfStates][Grammar::number_of_symbols];
+
+		// The lookaheads of each item in each state.
+		terminal_set lookaheads[NumberOfStates][number_of_items];
+
+		lr_state<Grammar::number_of_symbols> states[NumberOfStates];
+
+		int conflicts;
+		int conflict_state, conflict_symbol;  // The first conflict
+
+		template<typename Automaton>
+		constexpr lalr_builder(const Automaton& lr0) :
+			items(lr0.items), closure{}, transitions{}, lookaheads{}, states{},
+			conflicts(0), conflict_state(-1), conflict_symbol(-1)
+		{
+			for (int s = 0; s < NumberOfStates; ++s)
+			{
+				closure[s] = lr0.closure[s];
+				for (int x = 0; x < Grammar::number_of_symbols; ++x)
+					transitions[s][x] = lr0.transitions[s][x];
+			}
+
+			propagate_lookaheads();
+
+			for (int s = 0; s < NumberOfStates; ++s)
+				fill_actions(s);
+		}
+
+	private:
+		constexpr void propagate_lookaheads()
+		{
+			const grammar_sets<Grammar>& sets = grammar_analysis<Grammar>::sets;
+
+			// The FIRST and nullable of the symbols after the next symbol of each item.
+			terminal_set rest_first[number_of_items] = {};
+			bool rest_nullable[number_of_items] = {};
+			for (int i = 0; i < number_of_items; ++i)
+			{
+				if (items.next[i] >= 0)
+				{
+					const production& p = Grammar::productions[items.production[i]];
+					int begin = p.rhs + i - items.first_item(items.production[i]) + 1, end = p.rhs + p.length;
+					rest_first[i] = sets.first_of(begin, end);
+					rest_nullable[i] = sets.nullable_of(begin, end);
+				}
+			}
+
+			for (int i = 0; i < number_of_items; ++i)
+				if (closure[0].contains(i) && Grammar::productions[items.production[i]].lhs == Grammar::root)
+					lookaheads[0][i].insert(0);
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (int s = 0; s < NumberOfStates; ++s)
+				{
+					for (int i = 0; i < number_of_items; ++i)
+					{
+						int x = items.next[i];
+						if (x < 0 || items.accepts(i) || !closure[s].contains(i)) continue;
+
+						// Lookaheads are carried over the transition
+						changed = lookaheads[transitions[s][x]][i + 1].insert_all(lookaheads[s][i]) || changed;
+
+						// Lookaheads of the items added by the closure
+						if (x >= Grammar::number_of_terminals)
+						{
+							terminal_set la = rest_first[i];
+							if (rest_nullable[i]) la.insert_all(lookaheads[s][i]);
+
+							for (int p = items.first_production[x]; p < items.first_production[x + 1]; ++p)
+								changed = lookaheads[s][items.first_item(p)].insert_all(la) || changed;
+						}
+					}
+				}
+			}
+		}
+
+		constexpr void set_action(int s, int x, lr_action a)
+		{
+			lr_action& current = states[s].actions[x];
+			if (current.action == lr_error || current == a)
+			{
+				current = a;
+				return;
+			}
+
+			if (conflicts++ == 0)
+			{
+				conflict_state = s;
+				conflict_symbol = x;
+			}
+
+			if (current.action == lr_reduce && (a.action != lr_reduce || a.value < current.value))
+				current = a;
+		}
+
+		constexpr void fill_actions(int s)
+		{
+			for (int i = 0; i < number_of_items; ++i)
+			{
+				if (!closure[s].contains(i)) continue;
+
+				int x = items.next[i], p = items.production[i];
+				if (x < 0)
+				{
+					for (int t = 0; t < Grammar::number_of_terminals; ++t)
+						if (lookaheads[s][i].contains(t))
+							set_action(s, t, lr_action{ lr_reduce, p });
+				}
+				else if (items.accepts(i))
+					set_action(s, x, lr_action{ lr_accept, 0 });
+				else if (x < Grammar::number_of_terminals)
+					set_action(s, x, lr_action{ lr_shift, transitions[s][x] });
+			}
+
+			for (int x = Grammar::number_of_terminals; x < Grammar::number_of_symbols; ++x)
+				if (transitions[s][x] >= 0)
+					set_action(s, x, lr_action{ lr_goto, transitions[s][x] });
+		}
+	};
+
+	namespace helpers
+	{
+		constexpr int lalr_capacity(int capacity, int number_of_items)
+		{
+			return capacity > 0 ? capacity : number_of_items + 1;
+		}
+
+		template<typename Grammar, int Capacity>
+		struct lalr_automaton
+		{
+			static const int capacity = lalr_capacity(Capacity, lr_items<Grammar>::number_of_items);
+			static constexpr lr0_automaton<Grammar, capacity> lr0 = lr0_automaton<Grammar, capacity>();
+
+			static_assert(!lr0.overflow, "Too many LR states: increase the capacity of lalr_tables");
+
+			static const int number_of_states = lr0.number_of_states;
+			static constexpr lalr_builder<Grammar, number_of_states> tables = lalr_builder<Grammar, number_of_states>(lr0);
+		};
+
+		template<typename Grammar, int Capacity>
+		constexpr lr0_automaton<Grammar, lalr_automaton<Grammar, Capacity>::capacity> lalr_automaton<Grammar, Capacity>::lr0;
+
+		template<typename Grammar, int Capacity>
+		constexpr lalr_builder<Grammar, lalr_automaton<Grammar, Capacity>::number_of_states> lalr_automaton<Grammar, Capacity>::tables;
+
+		template<typename Grammar>
+		constexpr int min_kind()
+		{
+			int result = Grammar::kinds[0];
+			for (short k : Grammar::kinds)
+				if (k < result) result = k;
+			return result;
+		}
+
+		template<typename Grammar>
+		constexpr int max_kind()
+		{
+			int result = Grammar::kinds[0];
+			for (short k : Grammar::kinds)
+				if (k > result) result = k;
+			return result;
+		}
+
+		template<typename Grammar, int Capacity, typename States, typename Rules, typename Kinds>
+		struct lalr_arrays;
+
+		template<typename Grammar, int Capacity, std::size_t... States, std::size_t... Rules, std::size_t... Kinds>
+		struct lalr_arrays<Grammar, Capacity, std::index_sequence<States...>, std::index_sequence<Rules...>, std::index_sequence<Kinds...>>
+		{
+			typedef lalr_automaton<Grammar, Capacity> automaton;
+
+			static const int min_kind = helpers::min_kind<Grammar>();
+			static const int max_kind = helpers::max_kind<Grammar>();
+
+			static constexpr short terminal_of(int kind)
+			{
+				for (int t = 0; t < Grammar::number_of_terminals; ++t)
+					if (Grammar::kinds[t] == kind) return t;
+				return -1;
+			}
+
+			static constexpr lr_state<Grammar::number_of_symbols> states[] = { automaton::tables.states[States]... };
+
+			static constexpr lr_rule rules[] = {
+				lr_rule{ Grammar::productions[Rules].length, Grammar::productions[Rules].lhs, Grammar::productions[Rules].kind, Grammar::productions[Rules].node }...
+			};
+
+			// Maps token kinds in [min_kind, max_kind] to terminals, or -1.
+			static constexpr short terminals[] = { terminal_of(min_kind + (int)Kinds)... };
+		};
+
+		template<typename Grammar, int Capacity, std::size_t... States, std::size_t... Rules, std::size_t... Kinds>
+		constexpr lr_state<Grammar::number_of_symbols> lalr_arrays<Grammar, Capacity, std::index_sequence<States...>, std::index_sequence<Rules...>, std::index_sequence<Kinds...>>::states[];
+
+		template<typename Grammar, int Capacity, std::size_t... States, std::size_t... Rules, std::size_t... Kinds>
+		constexpr lr_rule lalr_arrays<Grammar, Capacity, std::index_sequence<States...>, std::index_sequence<Rules...>, std::index_sequence<Kinds...>>::rules[];
+
+		template<typename Grammar, int Capacity, std::size_t... States, std::size_t... Rules, std::size_t... Kinds>
+		constexpr short lalr_arrays<Grammar, Capacity, std::index_sequence<States...>, std::index_sequence<Rules...>, std::index_sequence<Kinds...>>::terminals[];
+
+		template<typename Grammar>
+		constexpr int kind_range()
+		{
+			return max_kind<Grammar>() - min_kind<Grammar>() + 1;
+		}
+	}
+
+	// The LALR(1) parser tables of the grammar with start symbol Symbol.
+	// Capacity is the maximum number of states during construction (0 for a default based on the grammar size).
+	template<typename Symbol, int Capacity = 0>
+	struct lalr_tables : helpers::lalr_arrays<
+		typename parser_construction<Symbol>::grammar,
+		Capacity,
+		std::make_index_sequence<helpers::lalr_automaton<typename parser_construction<Symbol>::grammar, Capacity>::number_of_states>,
+		std::make_index_sequence<parser_construction<Symbol>::grammar::number_of_productions>,
+		std::make_index_sequence<helpers::kind_range<typename parser_construction<Symbol>::grammar>()>>
+	{
+		typedef typename parser_construction<Symbol>::grammar grammar;
+		typedef helpers::lalr_automaton<grammar, Capacity> automaton;
+
+		static const int number_of_symbols = grammar::number_of_symbols;
+		static const int number_of_terminals = grammar::number_of_terminals;
+		static const int number_of_states = automaton::number_of_states;
+		static const int number_of_rules = grammar::number_of_productions;
+
+		// The number of shift/reduce and reduce/reduce conflicts.
+		// If this is not 0, then the grammar is not LALR(1).
+		static const int conflicts = automaton::tables.conflicts;
+
+		// The state and symbol of the first conflict, or -1.
+		static const int conflict_state = automaton::tables.conflict_state;
+		static const int conflict_symbol = automaton::tables.conflict_symbol;
+
+		static constexpr const lr_action& action(int state, int symbol)
+		{
+			return lalr_tables::states[state].actions[symbol];
+		}
+
+		static constexpr const lr_rule& rule(int r)
+		{
+			return lalr_tables::rules[r];
+		}
+
+		// The terminal of a token kind, or -1 if the kind is not a terminal of the grammar.
+		static constexpr int terminal(int kind)
+		{
+			return kind < lalr_tables::min_kind || kind > lalr_tables::max_kind ? -1 : lalr_tables::terminals[kind - lalr_tables::min_kind];
+		}
+	};
+}
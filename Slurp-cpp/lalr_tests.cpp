@@ -0,0 +1,190 @@
+#include "slurp.hpp"
+
+using namespace slurp;
+
+namespace
+{
+	// Runs the parser tables on a sequence of token kinds terminated by -1.
+	template<typename Tables, int N>
+	constexpr bool accepts(const int(&input)[N])
+	{
+		int stack[64] = {};
+		int top = 0;
+		for (int i = 0; i < N;)
+		{
+			int t = Tables::terminal(input[i]);
+			if (t < 0) return false;
+			const lr_action& a = Tables::action(stack[top], t);
+			switch (a.action)
+			{
+			case lr_shift:
+				stack[++top] = a.state();
+				++i;
+				break;
+			case lr_reduce:
+				top -= Tables::rule(a.rule()).length;
+				stack[top + 1] = Tables::action(stack[top], Tables::rule(a.rule()).symbol).state();
+				++top;
+				break;
+			case lr_accept:
+				return true;
+			default:
+				return false;
+			}
+		}
+		return false;
+	}
+}
+
+namespace ManualGrammar
+{
+	// The grammar of ManualTableExample
+	// E -> a b
+	// E -> a E b
+	typedef Token<'a', Ch<'a'>> a;
+	typedef Token<'b', Ch<'b'>> b;
+
+	struct E
+	{
+		typedef Rules<
+			Rule<0, a, b>,
+			Rule<1, a, E, b>
+		> rule;
+	};
+
+	typedef lalr_tables<E> tables;
+
+	static_assert(tables::conflicts == 0, "");
+	static_assert(tables::number_of_terminals == 3, "");
+	static_assert(tables::number_of_symbols == 5, "");
+
+	// The manual table has 10 states, but LALR(1) merges states with the same core.
+	static_assert(tables::number_of_states == 6, "");
+
+	static_assert(tables::terminal(-1) == 0, "");
+	static_assert(tables::terminal('a') > 0, "");
+	static_assert(tables::terminal('c') == -1, "");
+	static_assert(tables::action(0, tables::terminal('a')).action == lr_shift, "");
+	static_assert(tables::action(0, tables::terminal('b')).action == lr_error, "");
+	static_assert(tables::action(0, tables::grammar::symbol<E>::value).action == lr_goto, "");
+
+	static_assert(tables::rules[1].kind == 0 && tables::rules[1].length == 2, "");
+	static_assert(tables::rules[2].kind == 1 && tables::rules[2].length == 3, "");
+
+	constexpr int program1[] = { -1 };
+	constexpr int program2[] = { 'a', 'b', -1 };
+	constexpr int program3[] = { 'a', 'a', 'a', 'b', 'b', 'b', -1 };
+	constexpr int program4[] = { 'a', 'a', 'b', -1 };
+	constexpr int program5[] = { 'a', 'a', 'b', 'b', 'b', -1 };
+	constexpr int program6[] = { 'a', 'a', 'b', 'b', -1 };
+
+	static_assert(!accepts<tables>(program1), "");
+	static_assert(accepts<tables>(program2), "");
+	static_assert(accepts<tables>(program3), "");
+	static_assert(!accepts<tables>(program4), "");
+	static_assert(!accepts<tables>(program5), "");
+	static_assert(accepts<tables>(program6), "");
+}
+
+namespace ExpressionGrammar
+{
+	enum nodes { Int, Plus, Minus, Times, Divide, Bracket };
+
+	typedef Token<'1', Ch<'1'>> tok_int;
+	typedef Token<'(', Ch<'('>> tok_open;
+	typedef Token<')', Ch<')'>> tok_close;
+	typedef Token<'+', Ch<'+'>> tok_plus;
+	typedef Token<'-', Ch<'-'>> tok_minus;
+	typedef Token<'*', Ch<'*'>> tok_times;
+	typedef Token<'/', Ch<'/'>> tok_divide;
+
+	struct Expression;
+
+	typedef Rules<
+		tok_int,
+		Rule<Bracket, tok_open, Expression, tok_close>
+	> PrimaryExpr;
+
+	struct MultiplicativeExpr
+	{
+		typedef Rules<
+			PrimaryExpr,
+			Rule<Times, MultiplicativeExpr, tok_times, PrimaryExpr>,
+			Rule<Divide, MultiplicativeExpr, tok_divide, PrimaryExpr>
+		> rule;
+	};
+
+	struct AdditiveExpr
+	{
+		typedef Rules<
+			MultiplicativeExpr,
+			Rule<Plus, MultiplicativeExpr, tok_plus, AdditiveExpr>,
+			Rule<Minus, MultiplicativeExpr, tok_minus, AdditiveExpr>
+		> rule;
+	};
+
+	struct Expression
+	{
+		typedef AdditiveExpr rule;
+	};
+
+	typedef lalr_tables<Expression> tables;
+	static_assert(tables::conflicts == 0, "");
+
+	constexpr int program1[] = { '1', '+', '1', '*', '1', -1 };
+	constexpr int program2[] = { '(', '1', '+', '1', ')', '*', '1', '/', '1', -1 };
+	constexpr int program3[] = { '1', '+', -1 };
+	constexpr int program4[] = { '(', ')', -1 };
+	constexpr int program5[] = { '1', '1', -1 };
+
+	static_assert(accepts<tables>(program1), "");
+	static_assert(accepts<tables>(program2), "");
+	static_assert(!accepts<tables>(program3), "");
+	static_assert(!accepts<tables>(program4), "");
+	static_assert(!accepts<tables>(program5), "");
+}
+
+namespace NullableGrammar
+{
+	typedef Token<'a', Ch<'a'>> a;
+	typedef Token<'b', Ch<'b'>> b;
+
+	typedef Rules<Rule<2>, a> MaybeA;
+
+	struct List
+	{
+		typedef Rules<
+			Rule<1, MaybeA, b, List>,
+			Rule<3>
+		> rule;
+	};
+
+	typedef lalr_tables<List> tables;
+	static_assert(tables::conflicts == 0, "");
+
+	constexpr int program1[] = { -1 };
+	constexpr int program2[] = { 'a', 'b', 'b', 'a', 'b', -1 };
+	constexpr int program3[] = { 'a', 'a', 'b', -1 };
+
+	static_assert(accepts<tables>(program1), "");
+	static_assert(accepts<tables>(program2), "");
+	static_assert(!accepts<tables>(program3), "");
+}
+
+namespace AmbiguousGrammar
+{
+	typedef Token<'x', Ch<'x'>> x;
+	typedef Token<'+', Ch<'+'>> plus;
+
+	struct E
+	{
+		typedef Rules<
+			Rule<1, E, plus, E>,
+			x
+		> rule;
+	};
+
+	typedef lalr_tables<E> tables;
+	static_assert(tables::conflicts > 0, "E -> E + E is ambiguous");
+	static_assert(tables::conflict_symbol == tables::terminal('+'), "");
+}
@@ -0,0 +1,258 @@
+#include "slurp.hpp"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SLURP_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define SLURP_TARGET(t) __attribute__((target(t)))
+#else
+#define SLURP_TARGET(t)
+#endif
+
+namespace
+{
+	typedef const unsigned char* (*scan_function)(const slurp::lexer_run&, const unsigned char*, const unsigned char*);
+
+	bool in_run(const slurp::lexer_run& run, unsigned char b)
+	{
+		for (int k = 0; k < run.count; ++k)
+			if ((unsigned char)(b - run.lo[k]) <= (unsigned char)(run.hi[k] - run.lo[k]))
+				return true;
+		return false;
+	}
+
+	const unsigned char* scan_scalar(const slurp::lexer_run& run, const unsigned char* p, const unsigned char* end)
+	{
+		while (p != end && in_run(run, *p))
+			++p;
+		return p;
+	}
+
+	void newlines_scalar(const char* begin, const char* p, const char* end, std::vector<std::size_t>& starts)
+	{
+		while (p != end && (p = (const char*)std::memchr(p, '\n', end - p)))
+			starts.push_back(++p - begin);
+	}
+
+#ifdef SLURP_X86
+	int first_bit(unsigned mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (int)index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	// Each byte is in a range [lo, lo+width] if (byte-lo) == min(byte-lo, width), as unsigned bytes.
+	SLURP_TARGET("sse2")
+	const unsigned char* scan_sse2(const slurp::lexer_run& run, const unsigned char* p, const unsigned char* end)
+	{
+		__m128i lo[slurp::lexer_run::max_ranges], width[slurp::lexer_run::max_ranges];
+		for (int k = 0; k < run.count; ++k)
+		{
+			lo[k] = _mm_set1_epi8((char)run.lo[k]);
+			width[k] = _mm_set1_epi8((char)(run.hi[k] - run.lo[k]));
+		}
+
+		for (; end - p >= 16; p += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			__m128i in = _mm_setzero_si128();
+			for (int k = 0; k < run.count; ++k)
+			{
+				__m128i d = _mm_sub_epi8(v, lo[k]);
+				in = _mm_or_si128(in, _mm_cmpeq_epi8(_mm_min_epu8(d, width[k]), d));
+			}
+			unsigned mask = ~(unsigned)_mm_movemask_epi8(in) & 0xffff;
+			if (mask) return p + first_bit(mask);
+		}
+		return scan_scalar(run, p, end);
+	}
+
+	SLURP_TARGET("avx2")
+	const unsigned char* scan_avx2(const slurp::lexer_run& run, const unsigned char* p, const unsigned char* end)
+	{
+		__m256i lo[slurp::lexer_run::max_ranges], width[slurp::lexer_run::max_ranges];
+		for (int k = 0; k < run.count; ++k)
+		{
+			lo[k] = _mm256_set1_epi8((char)run.lo[k]);
+			width[k] = _mm256_set1_epi8((char)(run.hi[k] - run.lo[k]));
+		}
+
+		for (; end - p >= 32; p += 32)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i*)p);
+			__m256i in = _mm256_setzero_si256();
+			for (int k = 0; k < run.count; ++k)
+			{
+				__m256i d = _mm256_sub_epi8(v, lo[k]);
+				in = _mm256_or_si256(in, _mm256_cmpeq_epi8(_mm256_min_epu8(d, width[k]), d));
+			}
+			unsigned mask = ~(unsigned)_mm256_movemask_epi8(in);
+			if (mask) return p + first_bit(mask);
+		}
+		return scan_sse2(run, p, end);
+	}
+
+	// The newlines in each block are the set bits of a mask, which are usually few.
+	SLURP_TARGET("sse2")
+	void newlines_sse2(const char* begin, const char* p, const char* end, std::vector<std::size_t>& starts)
+	{
+		const __m128i newline = _mm_set1_epi8('\n');
+		for (; end - p >= 16; p += 16)
+		{
+			unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), newline));
+			for (std::size_t offset = (p - begin) + 1; mask; mask &= mask - 1)
+				starts.push_back(offset + first_bit(mask));
+		}
+		newlines_scalar(begin, p, end, starts);
+	}
+
+	SLURP_TARGET("avx2")
+	void newlines_avx2(const char* begin, const char* p, const char* end, std::vector<std::size_t>& starts)
+	{
+		const __m256i newline = _mm256_set1_epi8('\n');
+		for (; end - p >= 32; p += 32)
+		{
+			unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), newline));
+			for (std::size_t offset = (p - begin) + 1; mask; mask &= mask - 1)
+				starts.push_back(offset + first_bit(mask));
+		}
+		newlines_sse2(begin, p, end, starts);
+	}
+
+	slurp::lexer_simd supported_simd()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int ids = info[0];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		// AVX2 also needs the OS to save the YMM registers
+		bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		bool avx2 = false;
+		if (avx && ids >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+		return avx2 ? slurp::lexer_avx2 : sse2 ? slurp::lexer_sse2 : slurp::lexer_scalar;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? slurp::lexer_avx2 : __builtin_cpu_supports("sse2") ? slurp::lexer_sse2 : slurp::lexer_scalar;
+#endif
+	}
+#else
+	slurp::lexer_simd supported_simd()
+	{
+		return slurp::lexer_scalar;
+	}
+#endif
+
+	scan_function scanner(slurp::lexer_simd simd)
+	{
+		switch (simd)
+		{
+#ifdef SLURP_X86
+		case slurp::lexer_avx2:
+			return scan_avx2;
+		case slurp::lexer_sse2:
+			return scan_sse2;
+#endif
+		default:
+			return scan_scalar;
+		}
+	}
+
+	const unsigned char* scan_first(const slurp::lexer_run& run, const unsigned char* p, const unsigned char* end);
+
+	// The scanner is chosen on the first call.
+	std::atomic<scan_function> current_scanner(scan_first);
+	std::atomic<int> current_simd(-1);
+
+	const unsigned char* scan_first(const slurp::lexer_run& run, const unsigned char* p, const unsigned char* end)
+	{
+		slurp::get_lexer_simd();
+		return current_scanner.load(std::memory_order_relaxed)(run, p, end);
+	}
+}
+
+const unsigned char* slurp::scan_run(const lexer_run& run, const unsigned char* p, const unsigned char* end)
+{
+	return current_scanner.load(std::memory_order_relaxed)(run, p, end);
+}
+
+slurp::lexer_simd slurp::get_lexer_simd()
+{
+	int simd = current_simd.load(std::memory_order_relaxed);
+	return simd < 0 ? set_lexer_simd(lexer_avx2) : lexer_simd(simd);
+}
+
+slurp::lexer_simd slurp::set_lexer_simd(lexer_simd simd)
+{
+	static const lexer_simd supported = supported_simd();
+	if (simd > supported) simd = supported;
+
+	current_scanner.store(scanner(simd), std::memory_order_relaxed);
+	current_simd.store(simd, std::memory_order_relaxed);
+	return simd;
+}
+
+void slurp::scan_newlines(const char* begin, const char* end, std::vector<std::size_t>& line_starts)
+{
+	switch (get_lexer_simd())
+	{
+#ifdef SLURP_X86
+	case lexer_avx2:
+		newlines_avx2(begin, begin, end, line_starts);
+		break;
+	case lexer_sse2:
+		newlines_sse2(begin, begin, end, line_starts);
+		break;
+#endif
+	default:
+		newlines_scalar(begin, begin, end, line_starts);
+	}
+}
+
+void slurp::lexer_failure_memo::start(std::size_t length, int states)
+{
+	positions = length + 1;
+	this->states = states;
+	rows.clear();
+	trail.clear();
+}
+
+void slurp::lexer_failure_memo::mark_trail()
+{
+	// Allocated on the first failure, since most inputs never need it
+	if (rows.empty())
+		rows.resize(states);
+
+	// The trail is in order of offset, and later scans only reach offsets after this one starts
+	std::size_t origin = trail.front().from;
+	for (const segment& s : trail)
+	{
+		row& r = rows[s.state];
+		if (r.bits.empty())
+		{
+			r.origin = origin;
+			r.bits.assign((positions - origin + 63) / 64, 0);
+		}
+		for (std::size_t i = s.from - r.origin, end = s.to - r.origin; i <= end; ++i)
+			r.bits[i / 64] |= std::uint64_t(1) << (i % 64);
+	}
+	trail.clear();
+}
@@ -0,0 +1,1046 @@
+/*
+	A lexer generated at compile time from token definitions.
+
+	dfa_tokenizer<typeset<Token<Kind, Part>...>, Skip>
+
+	is a tokenizer (with MoveNext) for the given tokens, where each Part is built from
+
+	Ch<C>          - the character C
+	Range<C1, C2>  - a character in [C1, C2]
+	Seq<Ps...>     - a sequence
+	Rules<Ps...>   - a choice
+	A class        - the class's rule, which may be recursive at its start or end:
+
+	struct Integer
+	{
+		typedef Rules<Digit, Seq<Integer, Digit>> rule;  // Digit+
+	};
+
+	Skip is a typeset of token parts (such as whitespace or comments) that are matched
+	but not returned as tokens.
+
+	The tokens are compiled into an NFA, which is converted into a DFA using the subset
+	construction and then minimised, all in constexpr functions.
+
+	The transition table has a column per character class rather than per character.
+	The characters are first partitioned into the intervals between the bounds of the
+	Ch and Range parts, and intervals with the same transitions in every state are merged
+	into one class. Class 0 is the characters that no token contains. A character below 256
+	is mapped to its class with a 256-entry table, and other characters by a binary search
+	of the intervals.
+
+	MoveNext finds the longest match (maximal munch), and if several tokens match the same
+	text, the token that is first in the typeset wins. A character that does not start any
+	token is returned as a token of kind lexer_error.
+
+	Long tokens such as identifiers, numbers and whitespace spend most of their time in a
+	state that loops on itself. The bytes that a state loops on are stored as a lexer_run
+	of up to 4 byte ranges. When the input is contiguous bytes (a char pointer or a
+	std::string iterator), MoveNext skips the rest of a run with scan_run every 16 bytes of a
+	token, which tests 16 or 32 bytes at a time using SSE2 or AVX2 if the CPU supports them
+	(lexer.cpp). Shorter tokens do not call scan_run at all.
+
+	Maximal munch can take quadratic time, for example with the tokens a and a*b on the
+	input aaaa..., where each token scans to the end of the input before going back to the
+	last accepting position.
+
+	linear_tokenizer<Tokens, Skip>
+
+	is a dfa_tokenizer that takes linear time on any input, using Reps' algorithm ("Maximal-munch
+	tokenization in linear time", 1998): when a scan goes past its last accepting position and
+	fails, the (state, offset) pairs after that position are remembered, and a later scan stops
+	as soon as it reaches one. This needs a bit per character for each state that a scan has
+	failed in, from the first such scan to the end of the input. So it needs no memory if no
+	scan fails, and at most (number of states) * (length of the input) bits; use it for
+	untrusted input.
+
+	grammar_tokenizer<Symbol, Skip>
+
+	is a dfa_tokenizer for the tokens of a grammar.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace slurp
+{
+	// The bytes that a lexer state loops on, as up to max_ranges ranges [lo, hi].
+	// count is 0 if the state has no loop, or its loop needs too many ranges.
+	struct lexer_run
+	{
+		static const int max_ranges = 4;
+		unsigned char count;
+		unsigned char lo[max_ranges], hi[max_ranges];
+	};
+
+	// The end of the bytes in [p, end) that are in a run.
+	const unsigned char* scan_run(const lexer_run& run, const unsigned char* p, const unsigned char* end);
+
+	// The instructions used by scan_run.
+	enum lexer_simd { lexer_scalar, lexer_sse2, lexer_avx2 };
+
+	// The instructions currently used by scan_run, which by default are the best that the CPU supports.
+	lexer_simd get_lexer_simd();
+
+	// Sets the instructions used by scan_run, if the CPU supports them.
+	// Returns the instructions that are used.
+	lexer_simd set_lexer_simd(lexer_simd simd);
+
+	// The (state, offset) pairs that are known not to reach an accepting state of a lexer.
+	class lexer_failure_memo
+	{
+	public:
+		// Starts a stream of the given length, for a lexer with the given number of states.
+		void start(std::size_t length, int states);
+
+		bool failed(int state, std::size_t offset) const
+		{
+			if (rows.empty()) return false;
+			const row& r = rows[state];
+			if (r.bits.empty() || offset < r.origin) return false;
+			std::size_t i = offset - r.origin;
+			return (r.bits[i / 64] >> (i % 64)) & 1;
+		}
+
+		// Records that the offsets [from, to] were scanned in a state since the last accepting state.
+		void visit(int state, std::size_t from, std::size_t to)
+		{
+			if (!trail.empty() && trail.back().state == state && trail.back().to + 1 == from)
+				trail.back().to = to;
+			else
+				trail.push_back(segment{ state, from, to });
+		}
+
+		// Called when a scan reaches an accepting state.
+		void accept()
+		{
+			trail.clear();
+		}
+
+		// Called at the end of a scan, so everything visited since the last accepting state failed.
+		void fail()
+		{
+			if (!trail.empty()) mark_trail();
+		}
+
+	private:
+		std::size_t positions = 0;
+		int states = 0;
+
+		// The failed offsets of a state, from origin to the end of the stream.
+		// A row is only allocated when a scan first fails in the state, and starts at that scan,
+		// since later scans start after it.
+		struct row
+		{
+			std::size_t origin;
+			std::vector<std::uint64_t> bits;
+		};
+		std::vector<row> rows;
+
+		struct segment
+		{
+			int state;
+			std::size_t from, to;
+		};
+		std::vector<segment> trail;
+
+		void mark_trail();
+	};
+
+	namespace helpers
+	{
+		// The memo of a dfa_tokenizer, which does nothing.
+		struct no_lexer_memo
+		{
+			bool failed(int, std::size_t) const { return false; }
+			void visit(int, std::size_t, std::size_t) {}
+			void accept() {}
+			void fail() {}
+		};
+
+		// An NFA edge, on the characters [lo, hi], or an epsilon edge if lo > hi.
+		struct nfa_edge
+		{
+			int from, to, lo, hi;
+		};
+
+		template<int MaxStates, int MaxEdges>
+		struct lexer_nfa_builder
+		{
+			int number_of_states, number_of_edges;
+			int accept[MaxStates];  // The token accepted in each state, or -1
+			nfa_edge edges[MaxEdges > 0 ? MaxEdges : 1];
+
+			constexpr lexer_nfa_builder() : number_of_states(0), number_of_edges(0), accept{}, edges{} {}
+
+			constexpr int add_state()
+			{
+				accept[number_of_states] = -1;
+				return number_of_states++;
+			}
+
+			constexpr void epsilon(int from, int to)
+			{
+				edges[number_of_edges++] = nfa_edge{ from, to, 1, 0 };
+			}
+
+			constexpr void range(int from, int to, int lo, int hi)
+			{
+				edges[number_of_edges++] = nfa_edge{ from, to, lo, hi };
+			}
+		};
+
+		// P*, used for recursive token parts.
+		template<typename P>
+		struct lex_star;
+
+		template<std::size_t I, typename T, typename... Ts>
+		struct type_at
+		{
+			typedef typename type_at<I - 1, Ts...>::type type;
+		};
+
+		template<typename T, typename... Ts>
+		struct type_at<0, T, Ts...>
+		{
+			typedef T type;
+		};
+
+		// Seq<Ps...> without its last element.
+		template<typename Sequence, typename... Ps>
+		struct seq_init;
+
+		template<std::size_t... I, typename... Ps>
+		struct seq_init<std::index_sequence<I...>, Ps...>
+		{
+			typedef Seq<typename type_at<I, Ps...>::type...> type;
+		};
+
+		template<typename List>
+		struct list_to_rules;
+
+		template<typename... Ps>
+		struct list_to_rules<list<Ps...>>
+		{
+			typedef Rules<Ps...> type;
+		};
+
+		// The alternatives of the rule of a class.
+		template<typename Rule>
+		struct lex_alternatives
+		{
+			typedef list<Rule> type;
+		};
+
+		template<typename... As>
+		struct lex_alternatives<Rules<As...>>
+		{
+			typedef list<As...> type;
+		};
+
+		// Classifies an alternative A of class C as
+		// base (no recursion), left (C followed by the rest) or right (the rest followed by C).
+		template<typename C, typename A>
+		struct lex_recursion
+		{
+			typedef list<A> base;
+			typedef list<> left, right;
+		};
+
+		template<typename C>
+		struct lex_recursion<C, C>
+		{
+			typedef list<> base, left, right;
+		};
+
+		template<typename C, typename... Ps>
+		struct lex_recursion<C, Seq<C, Ps...>>
+		{
+			typedef list<> base, right;
+			typedef list<Seq<Ps...>> left;
+		};
+
+		template<typename C, typename P, typename... Ps>
+		struct lex_recursion<C, Seq<P, Ps...>>
+		{
+			static const bool right_recursive = std::is_same<C, typename type_at<sizeof...(Ps), P, Ps...>::type>::value;
+			typedef typename seq_init<std::make_index_sequence<sizeof...(Ps)>, P, Ps...>::type rest;
+
+			typedef typename std::conditional<right_recursive, list<>, list<Seq<P, Ps...>>>::type base;
+			typedef list<> left;
+			typedef typename std::conditional<right_recursive, list<rest>, list<>>::type right;
+		};
+
+		// The NFA of a token part.
+		// Expanding is the set of classes being expanded, which may not be referred to again.
+		template<typename Part, typename Expanding = ts_empty, bool Recursive = ts_contains<Part, Expanding>::value>
+		struct lex_part
+		{
+			typedef typename ts_insert<Part, Expanding>::type inner;
+			typedef typename lex_alternatives<typename Part::rule>::type alternatives;
+
+			template<typename As>
+			struct split;
+
+			template<typename... As>
+			struct split<list<As...>>
+			{
+				typedef typename list_to_rules<typename concat<typename lex_recursion<Part, As>::base...>::type>::type base;
+				typedef typename list_to_rules<typename concat<typename lex_recursion<Part, As>::left...>::type>::type left;
+				typedef typename list_to_rules<typename concat<typename lex_recursion<Part, As>::right...>::type>::type right;
+			};
+
+			// Part = right* base left*
+			typedef split<alternatives> parts;
+			typedef lex_part<Seq<lex_star<typename parts::right>, typename parts::base, lex_star<typename parts::left>>, inner> body;
+
+			static const int states = body::states;
+			static const int edges = body::edges;
+
+			template<typename N>
+			static constexpr int build(N& nfa, int from)
+			{
+				return body::build(nfa, from);
+			}
+		};
+
+		template<typename Part, typename Expanding>
+		struct lex_part<Part, Expanding, true>
+		{
+			static_assert(!ts_contains<Part, Expanding>::value,
+				"A token part is recursive other than at the start or end of its own rule, so it is not regular");
+
+			static const int states = 0, edges = 0;
+
+			template<typename N>
+			static constexpr int build(N&, int from)
+			{
+				return from;
+			}
+		};
+
+		template<int C, typename Expanding>
+		struct lex_part<Ch<C>, Expanding, false>
+		{
+			static const int states = 1, edges = 1;
+
+			template<typename N>
+			static constexpr int build(N& nfa, int from)
+			{
+				int to = nfa.add_state();
+				nfa.range(from, to, C, C);
+				return to;
+			}
+		};
+
+		template<int C1, int C2, typename Expanding>
+		struct lex_part<Range<C1, C2>, Expanding, false>
+		{
+			static_assert(C1 <= C2, "Empty character range");
+
+			static const int states = 1, edges = 1;
+
+			template<typename N>
+			static constexpr int build(N& nfa, int from)
+			{
+				int to = nfa.add_state();
+				nfa.range(from, to, C1, C2);
+				return to;
+			}
+		};
+
+		template<typename... Ps, typename Expanding>
+		struct lex_part<Seq<Ps...>, Expanding, false>
+		{
+			static const int states = (0 + ... + lex_part<Ps, Expanding>::states);
+			static const int edges = (0 + ... + lex_part<Ps, Expanding>::edges);
+
+			template<typename N>
+			static constexpr int build(N& nfa, int from)
+			{
+				int end = from;
+				(void)((end = lex_part<Ps, Expanding>::build(nfa, end)), ...);
+				return end;
+			}
+		};
+
+		template<typename... Ps, typename Expanding>
+		struct lex_part<Rules<Ps...>, Expanding, false>
+		{
+			static const int states = 1 + (0 + ... + lex_part<Ps, Expanding>::states);
+			static const int edges = (0 + ... + (lex_part<Ps, Expanding>::edges + 1));
+
+			template<typename N>
+			static constexpr int build(N& nfa, [[maybe_unused]] int from)
+			{
+				int join = nfa.add_state();
+				(void)(nfa.epsilon(lex_part<Ps, Expanding>::build(nfa, from), join), ...);
+				return join;
+			}
+		};
+
+		template<typename P, typename Expanding>
+		struct lex_part<lex_star<P>, Expanding, false>
+		{
+			static const int states = 1 + lex_part<P, Expanding>::states;
+			static const int edges = 2 + lex_part<P, Expanding>::edges;
+
+			template<typename N>
+			static constexpr int build(N& nfa, int from)
+			{
+				int loop = nfa.add_state();
+				nfa.epsilon(from, loop);
+				nfa.epsilon(lex_part<P, Expanding>::build(nfa, loop), loop);
+				return loop;
+			}
+		};
+
+		template<typename T>
+		struct token_part
+		{
+			typedef T type;  // A skipped part
+			static const short kind = -1;
+		};
+
+		template<int Kind, typename Part>
+		struct token_part<Token<Kind, Part>>
+		{
+			typedef Part type;
+			static const short kind = Kind;
+		};
+
+		// The NFA of all tokens, where the accepting state of the n-th token (or skipped part) accepts n.
+		template<typename Tokens, typename Skip>
+		struct lexer_nfa;
+
+		template<typename... Ts, typename... Ss>
+		struct lexer_nfa<typeset<Ts...>, typeset<Ss...>>
+		{
+			static const int number_of_tokens = sizeof...(Ts);
+			static const int number_of_parts = sizeof...(Ts) + sizeof...(Ss);
+
+			static const int max_states = 1 + (0 + ... + (1 + lex_part<typename token_part<Ts>::type>::states)) + (0 + ... + (1 + lex_part<Ss>::states));
+			static const int max_edges = (0 + ... + (1 + lex_part<typename token_part<Ts>::type>::edges)) + (0 + ... + (1 + lex_part<Ss>::edges));
+
+			typedef lexer_nfa_builder<max_states, max_edges> nfa_type;
+
+			template<typename Part>
+			static constexpr void add(nfa_type& nfa, int index)
+			{
+				int start = nfa.add_state();
+				nfa.epsilon(0, start);
+				int end = lex_part<Part>::build(nfa, start);
+				if (nfa.accept[end] < 0) nfa.accept[end] = index;
+			}
+
+			static constexpr nfa_type make()
+			{
+				nfa_type nfa;
+				nfa.add_state();
+				int index = 0;
+				(void)(add<typename token_part<Ts>::type>(nfa, index++), ...);
+				(void)(add<Ss>(nfa, index++), ...);
+				return nfa;
+			}
+
+			static constexpr short kinds[] = { token_part<Ts>::kind..., token_part<Ss>::kind... };
+		};
+
+		template<typename... Ts, typename... Ss>
+		constexpr short lexer_nfa<typeset<Ts...>, typeset<Ss...>>::kinds[];
+
+		// The DFA of an NFA, using the subset construction.
+		template<typename Nfa, int MaxStates>
+		struct lexer_dfa_builder
+		{
+			static const int max_boundaries = 2 * Nfa::max_edges + 1;
+			typedef bitset<Nfa::max_states> state_set;
+
+			// The characters are partitioned into the intervals [boundaries[i], boundaries[i+1]).
+			int boundaries[max_boundaries];
+			int number_of_boundaries;
+
+			int number_of_states;
+			bool overflow;
+
+			state_set sets[MaxStates];
+			int accept[MaxStates];
+			int transitions[MaxStates][max_boundaries];
+
+			constexpr int number_of_intervals() const
+			{
+				return number_of_boundaries > 0 ? number_of_boundaries - 1 : 0;
+			}
+
+			constexpr lexer_dfa_builder(const typename Nfa::nfa_type& nfa) :
+				boundaries{}, number_of_boundaries(0), number_of_states(1), overflow(false), sets{}, accept{}, transitions{}
+			{
+				make_boundaries(nfa);
+
+				state_set closure[Nfa::max_states] = {};
+				for (int s = 0; s < nfa.number_of_states; ++s)
+					closure[s].insert(s);
+				for (bool changed = true; changed;)
+				{
+					changed = false;
+					for (int e = 0; e < nfa.number_of_edges; ++e)
+						if (nfa.edges[e].lo > nfa.edges[e].hi)
+							changed = closure[nfa.edges[e].from].insert_all(closure[nfa.edges[e].to]) || changed;
+				}
+
+				sets[0] = closure[0];
+				for (int d = 0; d < number_of_states; ++d)
+				{
+					accept[d] = -1;
+					for (int s = 0; s < nfa.number_of_states; ++s)
+						if (sets[d].contains(s) && nfa.accept[s] >= 0 && (accept[d] < 0 || nfa.accept[s] < accept[d]))
+							accept[d] = nfa.accept[s];
+
+					state_set moves[max_boundaries] = {};
+					for (int e = 0; e < nfa.number_of_edges; ++e)
+					{
+						const nfa_edge& edge = nfa.edges[e];
+						if (edge.lo > edge.hi || !sets[d].contains(edge.from)) continue;
+						for (int i = interval_of(edge.lo); i < number_of_intervals() && boundaries[i] <= edge.hi; ++i)
+							moves[i].insert_all(closure[edge.to]);
+					}
+
+					for (int i = 0; i < number_of_intervals(); ++i)
+						transitions[d][i] = moves[i].empty() ? -1 : find_or_add(moves[i]);
+				}
+			}
+
+			constexpr int interval_of(int ch) const
+			{
+				int i = 0;
+				while (i < number_of_boundaries && boundaries[i] <= ch)
+					++i;
+				return i - 1;
+			}
+
+		private:
+			constexpr void make_boundaries(const typename Nfa::nfa_type& nfa)
+			{
+				for (int e = 0; e < nfa.number_of_edges; ++e)
+				{
+					if (nfa.edges[e].lo > nfa.edges[e].hi) continue;
+					add_boundary(nfa.edges[e].lo);
+					add_boundary(nfa.edges[e].hi + 1);
+				}
+			}
+
+			constexpr void add_boundary(int b)
+			{
+				int i = 0;
+				while (i < number_of_boundaries && boundaries[i] < b)
+					++i;
+				if (i < number_of_boundaries && boundaries[i] == b) return;
+				for (int j = number_of_boundaries; j > i; --j)
+					boundaries[j] = boundaries[j - 1];
+				boundaries[i] = b;
+				++number_of_boundaries;
+			}
+
+			constexpr int find_or_add(const state_set& set)
+			{
+				for (int d = 0; d < number_of_states; ++d)
+					if (sets[d] == set) return d;
+				if (number_of_states == MaxStates)
+				{
+					overflow = true;
+					return -1;
+				}
+				sets[number_of_states] = set;
+				return number_of_states++;
+			}
+		};
+
+		// Minimises a DFA by partition refinement.
+		// The states of the minimal DFA are the classes, and the start state stays 0.
+		template<typename Dfa, int MaxStates>
+		struct lexer_dfa_minimiser
+		{
+			int number_of_classes;
+			int partition[MaxStates];
+
+			constexpr lexer_dfa_minimiser(const Dfa& dfa) : number_of_classes(0), partition{}
+			{
+				// States are first distinguished by the token they accept
+				for (int s = 0; s < dfa.number_of_states; ++s)
+				{
+					partition[s] = -1;
+					for (int t = 0; t < s && partition[s] < 0; ++t)
+						if (dfa.accept[t] == dfa.accept[s])
+							partition[s] = partition[t];
+					if (partition[s] < 0)
+						partition[s] = number_of_classes++;
+				}
+
+				for (int previous = 0; previous != number_of_classes;)
+				{
+					previous = number_of_classes;
+					int refined[MaxStates] = {};
+					number_of_classes = 0;
+					for (int s = 0; s < dfa.number_of_states; ++s)
+					{
+						refined[s] = -1;
+						for (int t = 0; t < s && refined[s] < 0; ++t)
+							if (equivalent(dfa, s, t))
+								refined[s] = refined[t];
+						if (refined[s] < 0)
+							refined[s] = number_of_classes++;
+					}
+					for (int s = 0; s < dfa.number_of_states; ++s)
+						partition[s] = refined[s];
+				}
+			}
+
+			constexpr int class_of(int state) const
+			{
+				return state < 0 ? -1 : partition[state];
+			}
+
+		private:
+			constexpr bool equivalent(const Dfa& dfa, int s, int t) const
+			{
+				if (partition[s] != partition[t]) return false;
+				for (int i = 0; i < dfa.number_of_intervals(); ++i)
+					if (class_of(dfa.transitions[s][i]) != class_of(dfa.transitions[t][i]))
+						return false;
+				return true;
+			}
+		};
+
+		// Partitions the intervals of a minimal DFA into classes with the same transitions.
+		// Class 0 is the intervals with no transitions.
+		template<typename Dfa, typename Minimal, int MaxIntervals>
+		struct lexer_class_builder
+		{
+			int number_of_classes;
+			int interval_class[MaxIntervals > 0 ? MaxIntervals : 1];
+
+			constexpr lexer_class_builder(const Dfa& dfa, const Minimal& minimal) : number_of_classes(1), interval_class{}
+			{
+				for (int i = 0; i < dfa.number_of_intervals(); ++i)
+				{
+					interval_class[i] = -1;
+					if (same_column(dfa, minimal, i, -1))
+						interval_class[i] = 0;
+					for (int j = 0; j < i && interval_class[i] < 0; ++j)
+						if (same_column(dfa, minimal, i, j))
+							interval_class[i] = interval_class[j];
+					if (interval_class[i] < 0)
+						interval_class[i] = number_of_classes++;
+				}
+			}
+
+			// The first interval in a class.
+			constexpr int representative(int c) const
+			{
+				int i = 0;
+				while (interval_class[i] != c)
+					++i;
+				return i;
+			}
+
+		private:
+			// Whether intervals i and j have the same transitions, where j = -1 has none.
+			static constexpr bool same_column(const Dfa& dfa, const Minimal& minimal, int i, int j)
+			{
+				for (int s = 0; s < dfa.number_of_states; ++s)
+					if (minimal.class_of(dfa.transitions[s][i]) != (j < 0 ? -1 : minimal.class_of(dfa.transitions[s][j])))
+						return false;
+				return true;
+			}
+		};
+
+		constexpr int lexer_capacity(int capacity, int nfa_states)
+		{
+			return capacity > 0 ? capacity : 2 * nfa_states + 1;
+		}
+
+		template<typename Tokens, typename Skip, int Capacity>
+		struct lexer_automaton
+		{
+			typedef lexer_nfa<Tokens, Skip> nfa_type;
+			static const int capacity = lexer_capacity(Capacity, nfa_type::max_states);
+
+			static constexpr typename nfa_type::nfa_type nfa = nfa_type::make();
+			static constexpr lexer_dfa_builder<nfa_type, capacity> dfa = lexer_dfa_builder<nfa_type, capacity>(nfa);
+
+			static_assert(!dfa.overflow, "Too many DFA states: increase the capacity of the lexer");
+
+			typedef lexer_dfa_minimiser<lexer_dfa_builder<nfa_type, capacity>, capacity> minimiser_type;
+			static constexpr minimiser_type minimal = dfa;
+
+			typedef lexer_class_builder<lexer_dfa_builder<nfa_type, capacity>, minimiser_type, lexer_dfa_builder<nfa_type, capacity>::max_boundaries> class_builder;
+			static constexpr class_builder classes = class_builder(dfa, minimal);
+
+			static const int number_of_states = minimal.number_of_classes;
+			static const int number_of_intervals = dfa.number_of_intervals();
+			static const int number_of_boundaries = dfa.number_of_boundaries;
+			static const int number_of_classes = classes.number_of_classes;
+
+			// A state of the minimal DFA, which is the first DFA state in the class.
+			static constexpr int representative(int state)
+			{
+				int s = 0;
+				while (minimal.partition[s] != state)
+					++s;
+				return s;
+			}
+
+			// The i-th entry of the transition table, which has a row per state and a column per class.
+			static constexpr short transition(int i)
+			{
+				int c = i % number_of_classes;
+				return c == 0 ? -1 : (short)minimal.class_of(dfa.transitions[representative(i / number_of_classes)][classes.representative(c)]);
+			}
+
+			// The class of a character, or 0 if it is not in any interval.
+			static constexpr int char_class(int ch)
+			{
+				int i = dfa.interval_of(ch);
+				return i < 0 || i >= number_of_intervals ? 0 : classes.interval_class[i];
+			}
+
+			static constexpr short accept(int state)
+			{
+				return (short)dfa.accept[representative(state)];
+			}
+
+			static constexpr bool loops(int state, int byte)
+			{
+				return char_class(byte) != 0 && transition(state * number_of_classes + char_class(byte)) == state;
+			}
+
+			// The bytes that a state loops on.
+			static constexpr lexer_run run(int state)
+			{
+				lexer_run result{};
+				int count = 0;
+				for (int b = 0; b < 256; ++b)
+				{
+					if (!loops(state, b)) continue;
+					if (count > 0 && result.hi[count - 1] == b - 1)
+						result.hi[count - 1] = (unsigned char)b;
+					else if (count == lexer_run::max_ranges)
+						return lexer_run{};
+					else
+					{
+						result.lo[count] = result.hi[count] = (unsigned char)b;
+						++count;
+					}
+				}
+				result.count = (unsigned char)count;
+				return result;
+			}
+		};
+
+		template<typename Tokens, typename Skip, int Capacity>
+		constexpr typename lexer_automaton<Tokens, Skip, Capacity>::nfa_type::nfa_type lexer_automaton<Tokens, Skip, Capacity>::nfa;
+
+		template<typename Tokens, typename Skip, int Capacity>
+		constexpr lexer_dfa_builder<typename lexer_automaton<Tokens, Skip, Capacity>::nfa_type, lexer_automaton<Tokens, Skip, Capacity>::capacity> lexer_automaton<Tokens, Skip, Capacity>::dfa;
+
+		template<typename Tokens, typename Skip, int Capacity>
+		constexpr typename lexer_automaton<Tokens, Skip, Capacity>::minimiser_type lexer_automaton<Tokens, Skip, Capacity>::minimal;
+
+		template<typename Tokens, typename Skip, int Capacity>
+		constexpr typename lexer_automaton<Tokens, Skip, Capacity>::class_builder lexer_automaton<Tokens, Skip, Capacity>::classes;
+
+		template<typename Automaton, typename Boundaries, typename States, typename Transitions, typename Bytes = std::make_index_sequence<256>>
+		struct lexer_arrays;
+
+		template<typename Automaton, std::size_t... B, std::size_t... S, std::size_t... T, std::size_t... Bytes>
+		struct lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>
+		{
+			typedef typename std::conditional<(Automaton::number_of_classes <= 256), unsigned char, unsigned short>::type class_type;
+
+			// Terminated so that the arrays are never empty.
+			static constexpr int boundaries[] = { Automaton::dfa.boundaries[B]..., 0 };
+			static constexpr class_type interval_class[] = { (class_type)Automaton::classes.interval_class[B]..., 0 };
+			static constexpr class_type byte_class[] = { (class_type)Automaton::char_class(Bytes)... };
+			static constexpr short accept[] = { Automaton::accept(S)..., -1 };
+			static constexpr short transitions[] = { Automaton::transition(T)..., -1 };
+			static constexpr lexer_run runs[] = { Automaton::run(S)..., lexer_run{} };
+		};
+
+		template<typename Automaton, std::size_t... B, std::size_t... S, std::size_t... T, std::size_t... Bytes>
+		constexpr int lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::boundaries[];
+
+		template<typename Automaton, std::size_t... B, std::size_t... S, std::size_t... T, std::size_t... Bytes>
+		constexpr typename lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::class_type
+			lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::interval_class[];
+
+		template<typename Automaton, std::size_t... B, std::size_t... S, std::size_t... T, std::size_t... Bytes>
+		constexpr typename lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::class_type
+			lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::byte_class[];
+
+		template<typename Automaton, std::size_t... B, std::size_t... S, std::size_t... T, std::size_t... Bytes>
+		constexpr short lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::accept[];
+
+		template<typename Automaton, std::size_t... B, std::size_t... S, std::size_t... T, std::size_t... Bytes>
+		constexpr short lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::transitions[];
+
+		template<typename Automaton, std::size_t... B, std::size_t... S, std::size_t... T, std::size_t... Bytes>
+		constexpr lexer_run lexer_arrays<Automaton, std::index_sequence<B...>, std::index_sequence<S...>, std::index_sequence<T...>, std::index_sequence<Bytes...>>::runs[];
+
+		// A character as an unsigned code unit.
+		template<typename Ch>
+		int code_unit(Ch ch)
+		{
+			return (int)(typename std::make_unsigned<Ch>::type)ch;
+		}
+
+		// Moves to the end of the current token, and updates the offset.
+		// The characters are not read (see line_index for rows and columns).
+		template<typename It>
+		void advance_token(token_position<It>& pos)
+		{
+			pos.tok_start = pos.tok_end;
+			pos.data.offset = (unsigned)(pos.tok_start - pos.stream_start);
+		}
+
+		// Whether an iterator points to contiguous bytes, so can use scan_run.
+		template<typename It>
+		struct contiguous_bytes
+		{
+			typedef typename std::iterator_traits<It>::value_type value_type;
+
+			static const bool value = sizeof(value_type) == 1 && (std::is_pointer<It>::value ||
+				std::is_same<It, std::string::iterator>::value || std::is_same<It, std::string::const_iterator>::value);
+		};
+
+		// The tokens of a grammar, without eof.
+		template<typename Terminals>
+		struct without_eof;
+
+		template<typename... Ts>
+		struct without_eof<typeset<eof, Ts...>>
+		{
+			typedef typeset<Ts...> type;
+		};
+	}
+
+	// The tables of the minimal DFA for a set of tokens.
+	template<typename Tokens, typename Skip = ts_empty, int Capacity = 0>
+	struct lexer_tables : helpers::lexer_arrays<
+		helpers::lexer_automaton<Tokens, Skip, Capacity>,
+		std::make_index_sequence<helpers::lexer_automaton<Tokens, Skip, Capacity>::number_of_boundaries>,
+		std::make_index_sequence<helpers::lexer_automaton<Tokens, Skip, Capacity>::number_of_states>,
+		std::make_index_sequence<helpers::lexer_automaton<Tokens, Skip, Capacity>::number_of_states * helpers::lexer_automaton<Tokens, Skip, Capacity>::number_of_classes>>
+	{
+		typedef helpers::lexer_automaton<Tokens, Skip, Capacity> automaton;
+		typedef helpers::lexer_nfa<Tokens, Skip> nfa;
+
+		static const int number_of_tokens = nfa::number_of_tokens;
+		static const int number_of_states = automaton::number_of_states;
+		static const int number_of_intervals = automaton::number_of_intervals;
+		static const int number_of_classes = automaton::number_of_classes;
+
+		// The class of a character, where ch >= 0.
+		static constexpr int char_class(int ch)
+		{
+			if (ch < 256) return lexer_tables::byte_class[ch];
+
+			// Binary search for the last boundary <= ch
+			int lo = 0, hi = automaton::number_of_boundaries;
+			while (lo < hi)
+			{
+				int mid = (lo + hi) / 2;
+				if (lexer_tables::boundaries[mid] <= ch) lo = mid + 1;
+				else hi = mid;
+			}
+			return lo > 0 && lo <= number_of_intervals ? lexer_tables::interval_class[lo - 1] : 0;
+		}
+
+		// The next state, or -1 if no token can continue with ch.
+		static constexpr int next(int state, int ch)
+		{
+			return lexer_tables::transitions[state * number_of_classes + char_class(ch)];
+		}
+
+		// The size of the tables in bytes.
+		static constexpr std::size_t size()
+		{
+			return sizeof(lexer_tables::boundaries) + sizeof(lexer_tables::interval_class) + sizeof(lexer_tables::byte_class) +
+				sizeof(lexer_tables::accept) + sizeof(lexer_tables::transitions) + sizeof(lexer_tables::runs);
+		}
+
+		// The token (or skipped part) accepted in a state, or -1.
+		static constexpr int accepts(int state)
+		{
+			return lexer_tables::accept[state];
+		}
+
+		// The bytes that a state loops on.
+		static constexpr const lexer_run& run(int state)
+		{
+			return lexer_tables::runs[state];
+		}
+
+		// The kind of a token.
+		static constexpr short kind(int token)
+		{
+			return nfa::kinds[token];
+		}
+	};
+
+	template<typename Tokens, typename Skip = ts_empty, int Capacity = 0>
+	class dfa_tokenizer
+	{
+	public:
+		typedef lexer_tables<Tokens, Skip, Capacity> tables;
+
+		template<typename It>
+		void MoveNext(token_position<It>& pos) const
+		{
+			helpers::no_lexer_memo memo;
+			next_token(pos, memo);
+		}
+
+	protected:
+		template<typename It, typename Memo>
+		static void next_token(token_position<It>& pos, Memo& memo)
+		{
+			for (;;)
+			{
+				helpers::advance_token(pos);
+				if (pos.tok_start == pos.stream_end)
+				{
+					pos.kind = -1;
+					pos.data.length = 0;
+					return;
+				}
+
+				// Copies of the stream, which the compiler can keep in registers across scan_run
+				const It stream_start = pos.stream_start, stream_end = pos.stream_end;
+
+				// Find the longest match
+				int state = 0, token = -1;
+				It p = pos.tok_start, end = pos.tok_start, limit = run_limit(p, stream_end);
+				for (;;)
+				{
+					if (p == limit)
+					{
+						if (p == stream_end || !skip_state_run(state, p, end, memo, stream_start, stream_end)) break;
+						limit = run_limit(p, stream_end);
+						continue;
+					}
+
+					int next = tables::next(state, helpers::code_unit(*p));
+					if (next < 0) break;
+
+					++p;
+					It from = p;
+					state = next;
+					if (tables::accepts(state) >= 0)
+					{
+						token = tables::accepts(state);
+						end = p;
+						memo.accept();
+					}
+					else
+					{
+						std::size_t offset = p - stream_start;
+						memo.visit(state, from - stream_start, offset);
+						if (memo.failed(state, offset)) break;
+					}
+				}
+				memo.fail();
+
+				if (token < 0)
+				{
+					pos.kind = lexer_error;
+					pos.tok_end = std::next(pos.tok_start);
+				}
+				else
+				{
+					pos.tok_end = end;
+					if (token >= tables::number_of_tokens) continue;  // Skipped
+					pos.kind = tables::kind(token);
+				}
+
+				pos.data.length = (unsigned)(pos.tok_end - pos.tok_start);
+				return;
+			}
+		}
+
+	private:
+		// The length of a token before MoveNext looks for runs in it (see lexer_tokens and lexer_long_tokens).
+		static const int long_token = 16;
+
+		// Where MoveNext next looks for a run.
+		template<typename It>
+		static It run_limit(It p, It end)
+		{
+			if constexpr (helpers::contiguous_bytes<It>::value)
+			{
+				if (end - p > long_token) return p + long_token;
+			}
+			return end;
+		}
+
+		// Skips the rest of a run in a state that loops on itself, like the loop in next_token.
+		// Returns false if the memo says the scan has failed.
+		template<typename It, typename Memo>
+		static bool skip_state_run(int state, It& p, It& end, Memo& memo, It stream_start, It stream_end)
+		{
+			It from = p;
+			if (tables::run(state).count)
+				p = skip_run(tables::run(state), p, stream_end);
+			if (p == from) return true;
+
+			if (tables::accepts(state) >= 0)
+			{
+				end = p;
+				return true;
+			}
+			std::size_t offset = p - stream_start;
+			memo.visit(state, from - stream_start + 1, offset);
+			return !memo.failed(state, offset);
+		}
+
+		// Moves p past the bytes in a run.
+		template<typename It>
+		static It skip_run(const lexer_run& run, It p, It end)
+		{
+			if constexpr (helpers::contiguous_bytes<It>::value)
+			{
+				const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&*p);
+				return p + (scan_run(run, bytes, bytes + (end - p)) - bytes);
+			}
+			return p;
+		}
+	};
+
+	// A dfa_tokenizer that takes linear time on any input.
+	template<typename Tokens, typename Skip = ts_empty, int Capacity = 0>
+	class linear_tokenizer : public dfa_tokenizer<Tokens, Skip, Capacity>
+	{
+	public:
+		typedef lexer_tables<Tokens, Skip, Capacity> tables;
+
+		template<typename It>
+		void MoveNext(token_position<It>& pos)
+		{
+			if (pos.tok_end == pos.stream_start)
+				memo.start(pos.stream_end - pos.stream_start, tables::number_of_states);
+			this->next_token(pos, memo);
+		}
+
+	private:
+		lexer_failure_memo memo;
+	};
+
+	// A tokenizer for the tokens of the grammar with start symbol Symbol.
+	// Where several tokens match the same text, the earliest in the grammar wins.
+	template<typename Symbol, typename Skip = ts_empty, int Capacity = 0>
+	using grammar_tokenizer = dfa_tokenizer<typename helpers::without_eof<typename parser_construction<Symbol>::terminals>::type, Skip, Capacity>;
+}
@@ -0,0 +1,141 @@
+#include "slurp.hpp"
+
+using namespace slurp;
+
+namespace
+{
+	// The kind of the longest token at the start of a string, or -1, and its length.
+	template<typename Tables>
+	constexpr int longest(const char* text, int& length)
+	{
+		int state = 0, token = -1;
+		length = 0;
+		for (int i = 0; text[i] && state >= 0; ++i)
+		{
+			state = Tables::next(state, text[i]);
+			if (state >= 0 && Tables::accepts(state) >= 0)
+			{
+				token = Tables::accepts(state);
+				length = i + 1;
+			}
+		}
+		return token < 0 ? -1 : Tables::kind(token);
+	}
+
+	template<typename Tables>
+	constexpr bool matches(const char* text, int kind)
+	{
+		int length = 0;
+		int k = longest<Tables>(text, length);
+		return k == kind && text[length] == 0;
+	}
+}
+
+namespace IntegerTokens
+{
+	typedef Range<'0', '9'> Digit;
+
+	// Digit+, written as a left-recursive rule
+	struct Integer
+	{
+		typedef Rules<Digit, Seq<Integer, Digit>> rule;
+	};
+
+	typedef lexer_tables<typeset<Token<'i', Integer>>> tables;
+
+	static_assert(tables::number_of_states == 2, "The minimal DFA of Digit+ has 2 states");
+	static_assert(tables::number_of_intervals == 1, "");
+	static_assert(tables::number_of_classes == 2, "The digits, and everything else");
+
+	// The state after a digit loops on digits
+	static_assert(tables::run(0).count == 0, "");
+	static_assert(tables::run(1).count == 1 && tables::run(1).lo[0] == '0' && tables::run(1).hi[0] == '9', "");
+
+	static_assert(matches<tables>("0", 'i'), "");
+	static_assert(matches<tables>("1234567890", 'i'), "");
+	static_assert(!matches<tables>("", 'i'), "");
+	static_assert(!matches<tables>("12a", 'i'), "");
+
+	// Digit+ written as a right-recursive rule gives the same DFA
+	struct Integer2
+	{
+		typedef Rules<Digit, Seq<Digit, Integer2>> rule;
+	};
+
+	static_assert(lexer_tables<typeset<Token<'i', Integer2>>>::number_of_states == 2, "");
+}
+
+namespace KeywordTokens
+{
+	typedef Rules<Range<'a', 'z'>, Ch<'_'>> Letter;
+
+	struct Identifier
+	{
+		typedef Rules<Letter, Seq<Identifier, Letter>, Seq<Identifier, Range<'0', '9'>>> rule;
+	};
+
+	typedef Token<'f', Seq<Ch<'f'>, Ch<'o'>, Ch<'r'>>> For;
+	typedef Token<'x', Identifier> Id;
+	typedef Token<'=', Ch<'='>> Equals;
+	typedef Token<'e', Seq<Ch<'='>, Ch<'='>>> Equality;
+
+	// The keyword is listed first, so wins over the identifier
+	typedef lexer_tables<typeset<For, Id, Equals, Equality>> tables;
+
+	static_assert(matches<tables>("for", 'f'), "");
+	static_assert(matches<tables>("fo", 'x'), "");
+	static_assert(matches<tables>("format", 'x'), "Maximal munch");
+	static_assert(matches<tables>("x_1", 'x'), "");
+	static_assert(matches<tables>("=", '='), "");
+	static_assert(matches<tables>("==", 'e'), "Maximal munch");
+	static_assert(!matches<tables>("1x", 'x'), "");
+
+	// Letters other than f, o and r behave the same in every state
+	static_assert(tables::number_of_classes < tables::number_of_intervals, "");
+	static_assert(tables::char_class('a') == tables::char_class('z'), "");
+	static_assert(tables::char_class('a') == tables::char_class('_'), "");
+	static_assert(tables::char_class('a') != tables::char_class('f'), "");
+	static_assert(tables::char_class('a') != tables::char_class('0'), "");
+	static_assert(tables::char_class('!') == 0, "");
+	static_assert(tables::char_class(0x3b1) == 0, "");
+
+	// The identifier state loops on digits, _ and letters
+	constexpr int identifier = tables::next(0, 'x');
+	static_assert(tables::run(identifier).count == 3, "");
+	static_assert(tables::run(identifier).lo[1] == '_' && tables::run(identifier).hi[1] == '_', "");
+	static_assert(tables::run(tables::next(0, 'f')).count == 0, "The prefix of a keyword does not loop");
+
+	// Listed after the identifier, the keyword is never matched
+	typedef lexer_tables<typeset<Id, For>> tables2;
+	static_assert(matches<tables2>("for", 'x'), "");
+
+	// A recursive part such as
+	//   struct Nested { typedef Rules<Ch<'x'>, Seq<Ch<'('>, Nested, Ch<')'>>> rule; };
+	// is not regular, and fails with a static_assert.
+}
+
+namespace SkippedTokens
+{
+	typedef Rules<Ch<' '>, Ch<'\t'>, Ch<'\n'>> Whitespace;
+	typedef Token<'1', Ch<'1'>> One;
+
+	typedef lexer_tables<typeset<One>, typeset<Whitespace>> tables;
+
+	static_assert(tables::number_of_tokens == 1, "");
+	static_assert(matches<tables>(" ", -1), "A skipped part has no kind");
+	static_assert(matches<tables>("1", '1'), "");
+}
+
+namespace WideTokens
+{
+	// Characters above 255 are classified by a search of the intervals
+	typedef lexer_tables<typeset<Token<'g', Range<0x3b1, 0x3c9>>, Token<'a', Range<'a', 'z'>>>> tables;
+
+	static_assert(tables::number_of_classes == 3, "");
+	static_assert(tables::char_class(0x3b1) == tables::char_class(0x3c9), "");
+	static_assert(tables::char_class(0x3b1) != 0, "");
+	static_assert(tables::char_class(0x3b0) == 0, "");
+	static_assert(tables::char_class(0x3ca) == 0, "");
+	static_assert(tables::accepts(tables::next(0, 0x3b5)) == 0, "");
+	static_assert(tables::next(0, 0x100) == -1, "");
+}
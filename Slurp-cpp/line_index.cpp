@@ -0,0 +1,29 @@
+#include "slurp.hpp"
+
+#include <algorithm>
+
+slurp::line_index::line_index(const char* source, std::size_t length, unsigned tab_width) :
+	source(source), length(length), tab_width(std::max(tab_width, 1u))
+{
+	// About one line per 32 characters of source code
+	starts.reserve(length / 32 + 1);
+	starts.push_back(0);
+	scan_newlines(source, source + length, starts);
+}
+
+slurp::source_position slurp::line_index::position(std::size_t offset) const
+{
+	assert(offset <= length);
+	auto line = std::upper_bound(starts.begin(), starts.end(), offset) - 1;
+
+	unsigned column = 1;
+	for (const char* p = source + *line, *end = source + offset; p != end; ++p)
+	{
+		unsigned char ch = (unsigned char)*p;
+		if (ch == '\t')
+			column += tab_width - (column - 1) % tab_width;
+		else if ((ch & 0xc0) != 0x80)
+			++column;  // Not a continuation byte of UTF-8
+	}
+	return source_position((unsigned)(line - starts.begin()) + 1, column);
+}
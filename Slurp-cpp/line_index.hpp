@@ -0,0 +1,59 @@
+/*
+	Rows and columns of positions in a source.
+
+	Tokens only store their offset, since most tokens never need a row and column,
+	and counting them in the tokenizer reads every character again. A line_index
+	finds the start of each line in one pass over the source with scan_newlines,
+	and then the row of an offset is a binary search of the line starts:
+
+		line_index lines(source, length);
+		source_position p = lines.position(token->offset);
+
+	A line ends after a '\n', so a '\r' of "\r\n" is the last column of its line.
+	Columns count the code points of UTF-8, where a tab moves to the column after
+	the next multiple of tab_width, and a tab_width of 1 counts a tab as one column.
+	The source must be valid while the line_index is used.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace slurp
+{
+	// A row and column in a source, from 1.
+	struct source_position
+	{
+		unsigned row, column;
+
+		source_position(unsigned row = 1, unsigned column = 1) : row(row), column(column) {}
+
+		bool operator==(const source_position& other) const { return row == other.row && column == other.column; }
+		bool operator!=(const source_position& other) const { return !(*this == other); }
+	};
+
+	class line_index
+	{
+	public:
+		line_index(const char* source, std::size_t length, unsigned tab_width = 1);
+
+		// The row and column of the character at offset, where offset may be the end of the source.
+		source_position position(std::size_t offset) const;
+
+		// The offset of the first character of a row.
+		std::size_t line_start(unsigned row) const { return starts[row - 1]; }
+
+		// The number of rows, where an empty source, or a source that ends in a newline, ends with an empty row.
+		unsigned number_of_lines() const { return (unsigned)starts.size(); }
+
+	private:
+		const char* source;
+		std::size_t length;
+		unsigned tab_width;
+		std::vector<std::size_t> starts;
+	};
+
+	// Adds the offset after each '\n' in [begin, end) to line_starts, using the instructions of get_lexer_simd().
+	void scan_newlines(const char* begin, const char* end, std::vector<std::size_t>& line_starts);
+}
@@ -0,0 +1,147 @@
+/*
+	A table-driven LR parser.
+
+	lr_parser<Tables, Tokenizer, It>
+
+	runs any LR parser tables over the tokens from a tokenizer, and builds
+	the parse tree in a Stack. Tables provides
+
+	action(state, symbol)  - the lr_action of a state on a terminal or nonterminal
+	rule(r)                - the lr_rule of a rule
+	terminal(kind)         - the terminal of a token kind, or -1
+
+	for example lalr_tables<Symbol> or compressed_tables. The tree is the same as the trees built by
+	recursive_descent and direct_lr.
+
+	The parser does not backtrack, so it runs in time linear in the input, and uses
+	no recursion, so the depth of the input is only limited by memory. The states are
+	held in a contiguous stack that parallels the nodes in the Stack, and this is
+	kept between parses to avoid reallocating it.
+
+	parse_actions(actions, begin, end) instead computes a value with semantic actions
+	(see parse_actions.hpp), where the kind of a rule comes from the tables so is a short.
+*/
+
+#pragma once
+
+#include <vector>
+
+namespace slurp
+{
+	template<typename Tables, typename Tokenizer, typename It>
+	class lr_parser
+	{
+	public:
+		// The options say how the tree is stored, for example with reference_text
+		// the tokens do not copy their text (see Stack).
+		lr_parser(const Tables& tables = Tables(), Tokenizer tokenizer = Tokenizer(), const stack_options& options = stack_options()) :
+			tables(tables), tokenizer(tokenizer), options(options)
+		{
+			states.reserve(64);
+		}
+
+		parse_result parse(It a, It b)
+		{
+			token_position<It> pos(a, b);
+			Stack stack(options);
+			if (run(stack, pos))
+				return stack;
+
+			parse_result error;
+			error.syntaxError = pos.data;
+			return error;
+		}
+
+		// Parses the input, and computes its value with actions instead of building a tree.
+		template<typename Actions>
+		action_result<typename Actions::value_type> parse_actions(Actions& actions, It a, It b)
+		{
+			token_position<It> pos(a, b);
+			action_stack<Actions> stack(actions);
+			bool success = run(stack, pos);
+			return stack.Result(success, pos.data);
+		}
+
+	private:
+		Tables tables;
+		Tokenizer tokenizer;
+		stack_options options;
+
+		// The state stack, which has one more entry than the symbols on the stack.
+		std::vector<int> states;
+
+		// Parses into a Stack or an action_stack, and returns whether the input was accepted.
+		template<typename Output>
+		bool run(Output& stack, token_position<It>& pos)
+		{
+			states.clear();
+			states.push_back(0);
+
+			tokenizer.MoveNext(pos);
+			int terminal = tables.terminal(pos.kind);
+
+			while (terminal >= 0)
+			{
+				lr_action action = tables.action(states.back(), terminal);
+				switch (action.action)
+				{
+				case lr_shift:
+					stack.Shift(pos.kind, pos.data, pos.begin(), pos.end());
+					tokenizer.MoveNext(pos);
+					terminal = tables.terminal(pos.kind);
+					states.push_back(action.state());
+					break;
+				case lr_reduce:
+					reduce(stack, tables.rule(action.rule()), pos);
+					break;
+				case lr_shift_reduce:
+					// The state after the shift is popped by the reduce, so is not needed
+					stack.Shift(pos.kind, pos.data, pos.begin(), pos.end());
+					tokenizer.MoveNext(pos);
+					terminal = tables.terminal(pos.kind);
+					states.push_back(-1);
+					reduce(stack, tables.rule(action.rule()), pos);
+					break;
+				case lr_accept:
+					return true;
+				default:
+					terminal = -1;
+					break;
+				}
+			}
+			return false;
+		}
+
+		template<typename Output>
+		void reduce(Output& stack, const lr_rule& rule, const token_position<It>& pos)
+		{
+			if (rule.node && rule.length == 0)
+				stack.Shift(rule.kind, pos.data, 0);  // A node with no children
+			else if (rule.node)
+				stack.Reduce(rule.kind, rule.length);
+
+			states.resize(states.size() - rule.length);
+			states.push_back(tables.action(states.back(), rule.symbol).state());
+		}
+	};
+
+	// Parses the input using a table-driven LR parser for Grammar.
+	template<typename Grammar, typename Tokenizer, typename It>
+	parse_result lr_parse(Tokenizer tok, It a, It b)
+	{
+		typedef lalr_tables<Grammar> tables;
+		static_assert(tables::conflicts == 0, "The grammar of an LR parser must not have conflicts");
+
+		return lr_parser<tables, Tokenizer, It>(tables(), tok).parse(a, b);
+	}
+
+	// Parses the input using a table-driven LR parser for Grammar, and computes its value with actions.
+	template<typename Grammar, typename Actions, typename Tokenizer, typename It>
+	action_result<typename Actions::value_type> lr_parse_actions(Actions& actions, Tokenizer tok, It a, It b)
+	{
+		typedef lalr_tables<Grammar> tables;
+		static_assert(tables::conflicts == 0, "The grammar of an LR parser must not have conflicts");
+
+		return lr_parser<tables, Tokenizer, It>(tables(), tok).parse_actions(actions, a, b);
+	}
+}
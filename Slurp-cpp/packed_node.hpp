@@ -0,0 +1,150 @@
+#pragma once
+#include "Node.h"
+#include <cstdint>
+
+namespace slurp
+{
+	namespace helpers
+	{
+		/*
+			Variable-length integers that are read backwards from their end, 7 bits per byte,
+			with the most significant bits first. The first byte has the top bit clear and the
+			others have it set, so a varint does not depend on the byte before it.
+		*/
+		inline std::size_t back_varint_size(std::uint32_t value)
+		{
+			std::size_t n = 1;
+			while (value >>= 7) ++n;
+			return n;
+		}
+
+		// Writes a varint at p, and returns the end of it.
+		inline char* write_back_varint(char* p, std::uint32_t value)
+		{
+			if (value < 0x80)
+			{
+				*p = (char)value;
+				return p + 1;
+			}
+
+			std::size_t n = back_varint_size(value);
+			for (std::size_t i = 0; i < n; ++i)
+				*p++ = (char)(((value >> (7 * (n - 1 - i))) & 0x7f) | (i ? 0x80 : 0));
+			return p;
+		}
+
+		// Reads the varint that ends at end, and moves end to the start of it.
+		inline std::uint32_t read_back_varint(const char*& end)
+		{
+			std::uint32_t value = 0;
+			for (int shift = 0;; shift += 7)
+			{
+				unsigned char b = (unsigned char)*--end;
+				value |= std::uint32_t(b & 0x7f) << shift;
+				if (!(b & 0x80)) return value;
+			}
+		}
+	}
+
+	/*
+		A node in the packed encoding of a Stack (see stack_options::encoding).
+
+		As in the fixed layout, the children of a node come before it and a node is found from
+		its end, but the fields of a node are varints (see helpers::read_back_varint), read
+		backwards from the end of the node. The layout of a node with children is
+
+		Child 0
+		...
+		Child n
+		Length of the children in bytes
+		Tag = number of children << 2
+		Kind
+
+		and of a token is
+
+		Offset
+		Length
+		Tag = 1
+		Kind
+
+		so that a node is usually 4 or 5 bytes, and a token 4 to 6 bytes.
+		Tokens never copy their text, which is found in the source as with reference_text.
+
+		A packed_node is a decoded view of a node, so is passed by value.
+	*/
+	class packed_node
+	{
+	public:
+		// Decodes the node that ends at end.
+		explicit packed_node(const char* end) : finish(end)
+		{
+			const char* p = end;
+			Kind = (short)(std::uint16_t)helpers::read_back_varint(p);
+			std::uint32_t tag = helpers::read_back_varint(p);
+			if (tag & 1)
+			{
+				numberOfChildren = 0;
+				token.length = helpers::read_back_varint(p);
+				token.offset = helpers::read_back_varint(p);
+				fields = start = p;
+			}
+			else
+			{
+				numberOfChildren = (unsigned short)(tag >> 2);
+				token = TokenData();
+				std::uint32_t length = helpers::read_back_varint(p);
+				fields = p;
+				start = p - length;
+			}
+		}
+
+		short Kind;
+
+		unsigned short size() const { return numberOfChildren; }
+
+		bool operator==(int kind) const
+		{
+			return Kind == kind;
+		}
+
+		bool IsToken() const { return numberOfChildren == 0; }
+
+		// The bytes of the node and its subtree.
+		const char* begin() const { return start; }
+		const char* end() const { return finish; }
+
+		// The child before this node, which is the last child.
+		// Undefined if IsToken()==true
+		packed_node FirstChild() const { return packed_node(fields); }
+
+		// The previous sibling, as Node::NextChild.
+		packed_node NextChild() const { return packed_node(start); }
+
+		// Takes linear time in the number of children.
+		packed_node operator[](unsigned short index) const
+		{
+			assert(index < size());
+			packed_node c = FirstChild();
+			for (int i = index + 1; i < size(); ++i)
+				c = c.NextChild();
+			return c;
+		}
+
+		// Gets the token data if this is a token (IsToken()==true)
+		const TokenData* GetToken() const { return &token; }
+
+		// The text of the token in the source that was parsed, as Node::Text.
+		template<typename Ch>
+		std::basic_string_view<Ch> Text(const Ch* source) const
+		{
+			return IsToken() ? std::basic_string_view<Ch>(source + token.offset, token.length) : std::basic_string_view<Ch>();
+		}
+
+	private:
+		const char* start;  // The start of the subtree
+		const char* fields;  // The start of the fields of this node, which is the end of its last child
+		const char* finish;
+		unsigned short numberOfChildren;
+		TokenData token;
+	};
+}
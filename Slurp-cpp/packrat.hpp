@@ -0,0 +1,271 @@
+/*
+	Packrat memoisation for recursive_descent.
+
+	recursive_descent tries the alternatives of a symbol in turn, and each alternative
+	parses its symbols again from the same position, so nested alternatives that fail late
+	can take exponential time. recursive_descent_packrat<Grammar>(tokenizer, begin, end)
+	parses in the same way, but the first time that a symbol is parsed at a position, it
+	records the results of the symbol: the positions where it can end, in the order that
+	they are found, and the subtree of the first parse that ends at each. The next time,
+	the subtrees are copied from the memo instead of parsing the symbol again.
+
+	The continuation of a symbol only depends on where the symbol ends, so a later parse
+	that ends at the same position would fail in the same way, and only the first is kept.
+	A parse of a symbol that fails has found all of its results, and it is only then that
+	the results are added to the memo.
+
+	The memo, and the results of the symbols that are being parsed, are bounded by
+	max_memo_bytes. When the memo is full it is flushed, and the results of a symbol that
+	do not fit are not kept, so on large inputs some symbols are parsed again, and the
+	nested alternatives of a subtree that is bigger than the memo can take exponential
+	time again. The tree is the same as from recursive_descent.
+*/
+
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace slurp
+{
+	// The default bound of the memo of a packrat_stack.
+	const std::size_t default_packrat_bytes = std::size_t(1) << 26;
+
+	// How a memo was used in a parse.
+	struct packrat_statistics
+	{
+		// The number of times that a symbol was found in the memo, or was parsed.
+		std::size_t hits, misses;
+
+		// The number of times that the memo was full.
+		std::size_t flushes;
+	};
+
+	namespace helpers
+	{
+		// A unique address for each symbol.
+		template<typename Symbol>
+		struct packrat_symbol
+		{
+			static const char id;
+		};
+
+		template<typename Symbol>
+		const char packrat_symbol<Symbol>::id = 0;
+	}
+
+	/*
+		A Stack with a memo of the results of each symbol at each position in the input.
+		This has the Shift, Reduce, Top and Unwind that recursive_descent uses on a Stack.
+	*/
+	template<typename It>
+	class packrat_stack
+	{
+	public:
+		typedef Stack::size_type size_type;
+
+		packrat_stack(const stack_options& options = stack_options(), std::size_t max_memo_bytes = default_packrat_bytes) :
+			stack(options), max_memo_bytes(max_memo_bytes), memo_bytes(0), recording_bytes(0), statistics()
+		{
+		}
+
+		template<typename I>
+		void Shift(short kind, const TokenData& data, I start, I end)
+		{
+			stack.Shift(kind, data, start, end);
+		}
+
+		void Shift(short kind, const TokenData& data, unsigned length)
+		{
+			stack.Shift(kind, data, length);
+		}
+
+		void Reduce(short kind, unsigned short numberOfChildren)
+		{
+			stack.Reduce(kind, numberOfChildren);
+		}
+
+		size_type Top() const { return stack.Top(); }
+
+		void Unwind(size_type position) { stack.Unwind(position); }
+
+		// The tree that has been parsed.
+		Stack& tree() { return stack; }
+
+		const packrat_statistics& get_statistics() const { return statistics; }
+
+		// Parses Symbol, from the memo if it has been parsed at this position before.
+		template<typename Symbol, typename Tokenizer>
+		bool parse(Tokenizer tok, token_position<It>& pos, const helpers::recursive_continuation<Tokenizer, It, packrat_stack>& next)
+		{
+			key k(&helpers::packrat_symbol<Symbol>::id, offset(pos));
+			auto i = memo.find(k);
+			if (i != memo.end())
+			{
+				++statistics.hits;
+
+				// Keeps the entry if the memo is flushed by next
+				std::shared_ptr<const entry> e = i->second;
+				size_type top = stack.Top();
+				for (const result& r : e->results)
+				{
+					stack.ShiftNode(e->nodes.data() + r.start, r.length);
+					pos = r.end;
+					if (next.call(tok, pos, *this))
+						return true;
+					stack.Unwind(top);
+				}
+				return false;
+			}
+
+			++statistics.misses;
+			auto e = std::make_shared<entry>();
+			recorder<Tokenizer> record(*this, *e, next);
+			if (helpers::recursive_descent<typename Symbol::rule>::parse(tok, pos, *this, record))
+				return true;
+
+			// Every result of the symbol has been found
+			recording_bytes -= e->nodes.size();
+			if (e->complete)
+				add(k, std::move(e));
+			return false;
+		}
+
+	private:
+		Stack stack;
+		// The bytes of the entries in the memo, and of the results of the symbols that are being parsed.
+		std::size_t max_memo_bytes, memo_bytes, recording_bytes;
+		packrat_statistics statistics;
+
+		// A position where a symbol ends, and the subtree of the symbol.
+		struct result
+		{
+			token_position<It> end;
+			std::size_t end_offset, start, length;
+		};
+
+		struct entry
+		{
+			std::vector<result> results;
+			std::vector<char> nodes;
+			bool complete = true;  // false if the subtrees were too big to keep
+		};
+
+		// The symbol and the offset of its first token.
+		typedef std::pair<const char*, std::size_t> key;
+
+		struct key_hash
+		{
+			std::size_t operator()(const key& k) const
+			{
+				return std::hash<const void*>()(k.first) ^ (k.second * 0x9e3779b97f4a7c15ull);
+			}
+		};
+
+		std::unordered_map<key, std::shared_ptr<const entry>, key_hash> memo;
+
+		// The offset of the current token, which is distinct at the end of the input,
+		// where some tokenizers leave tok_start at the last token.
+		static std::size_t offset(const token_position<It>& pos)
+		{
+			return pos.kind == -1 ? std::size_t(-1) : (std::size_t)std::distance(pos.stream_start, pos.tok_start);
+		}
+
+		// Records each new result of a symbol before calling its continuation.
+		template<typename Tokenizer>
+		class recorder : public helpers::recursive_continuation<Tokenizer, It, packrat_stack>
+		{
+		public:
+			recorder(packrat_stack& owner, entry& e, const helpers::recursive_continuation<Tokenizer, It, packrat_stack>& next) :
+				owner(owner), e(e), next(next), top(owner.stack.Top())
+			{
+			}
+
+			bool call(Tokenizer tok, token_position<It>& pos, packrat_stack& stack) const override
+			{
+				std::size_t end = offset(pos);
+				for (const result& r : e.results)
+					if (r.end_offset == end)
+						return false;  // next has already failed from here
+
+				if (e.complete)
+				{
+					std::size_t length = owner.stack.Top() - top;
+					if (owner.reserve(length))
+					{
+						const char* node = owner.stack.Data() + top;
+						e.results.push_back(result{ pos, end, e.nodes.size(), length });
+						e.nodes.insert(e.nodes.end(), node, node + length);
+					}
+					else
+					{
+						// The symbol will not be memoised
+						owner.recording_bytes -= e.nodes.size();
+						e.complete = false;
+						e.nodes = std::vector<char>();
+					}
+				}
+
+				return next.call(tok, pos, stack);
+			}
+
+		private:
+			packrat_stack& owner;
+			entry& e;
+			const helpers::recursive_continuation<Tokenizer, It, packrat_stack>& next;
+			size_type top;
+		};
+
+		void flush()
+		{
+			memo.clear();
+			memo_bytes = 0;
+			++statistics.flushes;
+		}
+
+		// Reserves bytes for a result that is being recorded, and returns false if it does not fit.
+		bool reserve(std::size_t bytes)
+		{
+			if (recording_bytes + bytes > max_memo_bytes)
+				return false;
+			if (memo_bytes + recording_bytes + bytes > max_memo_bytes)
+				flush();
+			recording_bytes += bytes;
+			return true;
+		}
+
+		void add(const key& k, std::shared_ptr<entry> e)
+		{
+			std::size_t bytes = e->nodes.size() + e->results.size() * sizeof(result) + sizeof(entry);
+			if (memo_bytes + recording_bytes + bytes > max_memo_bytes)
+			{
+				if (recording_bytes + bytes > max_memo_bytes)
+					return;
+				flush();
+			}
+			memo_bytes += bytes;
+			memo.insert(std::make_pair(k, std::move(e)));
+		}
+	};
+
+	// Parses the input by recursive descent, with a memo of the results of each symbol at each position.
+	// The options say how the tree is stored (see Stack).
+	template<typename Grammar, typename Tokenizer, typename It>
+	parse_result recursive_descent_packrat(Tokenizer tok, It a, It b, const stack_options& options = stack_options(),
+		std::size_t max_memo_bytes = default_packrat_bytes, packrat_statistics* statistics = nullptr)
+	{
+		token_position<It> pos(a, b);
+		packrat_stack<It> stack(options, max_memo_bytes);
+		tok.MoveNext(pos);
+
+		bool success = helpers::recursive_descent<Grammar>::parse(tok, pos, stack, helpers::recursive_descent_eof<Tokenizer, It, packrat_stack<It>>());
+		if (statistics) *statistics = stack.get_statistics();
+		if (success)
+			return std::move(stack.tree());
+		return parse_result();
+	}
+}
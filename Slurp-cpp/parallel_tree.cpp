@@ -0,0 +1,117 @@
+#include "slurp.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// The pool and queue of the current thread, if it is a worker
+	thread_local const slurp::thread_pool* current_pool = nullptr;
+	thread_local unsigned current_queue = 0;
+}
+
+slurp::thread_pool::thread_pool(unsigned threads) : stopping(false), queued(0)
+{
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned i = 0; i < threads; ++i)
+		queues.push_back(std::make_unique<queue>());
+
+	for (unsigned i = 0; i + 1 < threads; ++i)
+		workers.emplace_back(&thread_pool::work, this, i);
+}
+
+slurp::thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& w : workers)
+		w.join();
+}
+
+void slurp::thread_pool::push(std::function<void()> task)
+{
+	queue& q = *queues[current_pool == this ? current_queue : queues.size() - 1];
+	{
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.tasks.push_back(std::move(task));
+	}
+	queued.fetch_add(1, std::memory_order_release);
+
+	// Taking the lock means that a worker cannot miss the wake up between checking queued and sleeping
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+bool slurp::thread_pool::run_one()
+{
+	std::size_t self = current_pool == this ? current_queue : queues.size() - 1;
+	std::function<void()> task;
+
+	// The newest task of this thread, which is likely to be in its cache
+	{
+		queue& q = *queues[self];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (!q.tasks.empty())
+		{
+			task = std::move(q.tasks.back());
+			q.tasks.pop_back();
+		}
+	}
+
+	// Otherwise steal the oldest task of another thread, which is likely to be the largest
+	for (std::size_t i = 1; !task && i < queues.size(); ++i)
+	{
+		queue& q = *queues[(self + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (!q.tasks.empty())
+		{
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+		}
+	}
+
+	if (!task) return false;
+	queued.fetch_sub(1, std::memory_order_relaxed);
+	task();
+	return true;
+}
+
+void slurp::thread_pool::work(unsigned index)
+{
+	current_pool = this;
+	current_queue = index;
+
+	while (!stopping)
+	{
+		if (run_one()) continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+	}
+}
+
+slurp::task_group::~task_group()
+{
+	while (pending.load(std::memory_order_acquire) > 0)
+		if (!pool.run_one())
+			std::this_thread::yield();
+}
+
+void slurp::task_group::wait()
+{
+	while (pending.load(std::memory_order_acquire) > 0)
+		if (!pool.run_one())
+			std::this_thread::yield();
+
+	if (error)
+	{
+		std::exception_ptr e = error;
+		error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
@@ -0,0 +1,184 @@
+/*
+	Processes the subtrees of a finished parse tree in parallel.
+
+	Every subtree is a contiguous range of bytes that ends at its Node, so separate subtrees
+	can be read by separate threads without locking. parallel_fold splits the tree at the nodes
+	whose subtrees are larger than a threshold (in bytes), folds the smaller subtrees on the
+	threads of a thread_pool, and combines the results of the children of each split node in order:
+
+		thread_pool pool;
+		std::size_t tokens = parallel_fold(pool, result.root(),
+			[](const Node& subtree) { return count_tokens(subtree); },
+			[](const Node& node, std::vector<std::size_t>&& children) { return sum(children); });
+
+	fold is called on a subtree that is not split, which it must process itself, and
+	combine is called on a node that was split, with the results of its children in order.
+	fold and combine are called concurrently, so must be thread-safe.
+	The splitting stops at max_split_depth, so that a deep tree does not nest too many tasks.
+
+	thread_pool is a work-stealing pool: each thread has its own queue of tasks, takes
+	the newest task from its own queue, and takes the oldest task from another queue when
+	its own is empty. A thread that waits for a task_group runs tasks until the group is done,
+	so that tasks can wait for tasks of their own.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace slurp
+{
+	class thread_pool
+	{
+	public:
+		// The number of threads that run tasks, including a thread that waits for them,
+		// or 0 for std::thread::hardware_concurrency().
+		explicit thread_pool(unsigned threads = 0);
+		~thread_pool();
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		unsigned size() const { return (unsigned)workers.size() + 1; }
+
+	private:
+		friend class task_group;
+
+		struct queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		// A queue for each worker, and one for the threads outside the pool
+		std::vector<std::unique_ptr<queue>> queues;
+		std::vector<std::thread> workers;
+
+		std::atomic<bool> stopping;
+		std::atomic<int> queued;
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+
+		void push(std::function<void()> task);
+
+		// Runs a task from the queue of the current thread, or from another queue.
+		// Returns false if there were no tasks.
+		bool run_one();
+
+		void work(unsigned index);
+	};
+
+	// Tasks that are waited for together.
+	class task_group
+	{
+	public:
+		explicit task_group(thread_pool& pool) : pool(pool), pending(0)
+		{
+		}
+
+		// Waits for the tasks, but does not rethrow their exceptions.
+		~task_group();
+
+		task_group(const task_group&) = delete;
+		task_group& operator=(const task_group&) = delete;
+
+		template<typename F>
+		void run(F f)
+		{
+			pending.fetch_add(1, std::memory_order_relaxed);
+			pool.push([this, f]() mutable {
+				try
+				{
+					f();
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error) error = std::current_exception();
+				}
+				pending.fetch_sub(1, std::memory_order_release);
+			});
+		}
+
+		// Runs tasks until the tasks of this group are done, and rethrows the first exception of a task.
+		void wait();
+
+	private:
+		thread_pool& pool;
+		std::atomic<int> pending;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	};
+
+	// The subtrees larger than this are split by default.
+	const std::size_t default_split_bytes = 1 << 20;
+	const int max_split_depth = 64;
+
+	namespace helpers
+	{
+		template<typename T, typename Fold, typename Combine>
+		T fold_subtree(thread_pool& pool, const Node& node, Fold& fold, Combine& combine, std::size_t threshold, int depth)
+		{
+			if (node.IsToken() || node.Length() <= threshold || depth >= max_split_depth)
+				return fold(node);
+
+			std::vector<const Node*> children;
+			children.reserve(node.size());
+			for (const Node& child : node.children())
+				children.push_back(&child);
+
+			// Each large child is a task, and runs of small children are batched into a task
+			std::vector<std::optional<T>> results(children.size());
+			{
+				task_group group(pool);
+				for (std::size_t i = 0; i < children.size();)
+				{
+					std::size_t end = i + 1, bytes = children[i]->Length();
+					if (bytes <= threshold)
+						while (end < children.size() && bytes + children[end]->Length() <= threshold)
+							bytes += children[end++]->Length();
+
+					group.run([&, i, end] {
+						for (std::size_t c = i; c < end; ++c)
+							results[c].emplace(fold_subtree<T>(pool, *children[c], fold, combine, threshold, depth + 1));
+					});
+					i = end;
+				}
+				group.wait();
+			}
+
+			std::vector<T> values;
+			values.reserve(results.size());
+			for (auto& r : results)
+				values.push_back(std::move(*r));
+			return combine(node, std::move(values));
+		}
+	}
+
+	// Folds a tree in parallel. See above.
+	template<typename Fold, typename Combine>
+	auto parallel_fold(thread_pool& pool, const Node& root, Fold fold, Combine combine, std::size_t threshold = default_split_bytes) -> decltype(fold(root))
+	{
+		return helpers::fold_subtree<decltype(fold(root))>(pool, root, fold, combine, threshold, 0);
+	}
+
+	// Calls visit on each subtree that is not split, in parallel, which together contain every token.
+	// The nodes that are split are not visited.
+	template<typename Visit>
+	void parallel_for_each_subtree(thread_pool& pool, const Node& root, Visit visit, std::size_t threshold = default_split_bytes)
+	{
+		parallel_fold(pool, root,
+			[&](const Node& subtree) { visit(subtree); return true; },
+			[](const Node&, std::vector<bool>&&) { return true; },
+			threshold);
+	}
+}
@@ -0,0 +1,165 @@
+/*
+	Parsing with semantic actions, without building a tree.
+
+	When only a value of the input is needed, such as the result of a calculator, building
+	a tree in a Stack and then walking it does the work twice. An action_stack takes the
+	place of the Stack in a parser, and holds one value per symbol instead of a node, where
+	the values are computed by Actions as the input is parsed:
+
+	struct Actions
+	{
+		typedef double value_type;
+
+		// The value of a token.
+		template<typename It>
+		value_type token(short kind, const TokenData& data, It begin, It end);
+
+		// The value of Rule<Kind, Xs...> from the values of its children, of which there are size.
+		// Rule<Kind> has no children.
+		value_type reduce(short kind, const value_type* children, unsigned short size);
+	};
+
+	A pass-through alternative has no action, so its value is the value of its child,
+	in the same way that it does not create a node.
+
+	The kind is passed to reduce() as a rule_kind<Kind> (a std::integral_constant) when the parser
+	knows it at compile time, as in recursive_descent and direct_lr, so a switch on the kind is
+	folded away once reduce() is inlined, or reduce() can be overloaded on rule_kind<Kind>.
+	A table-driven lr_parser passes the kind as a short.
+
+	recursive_descent_actions<Grammar>(actions, tokenizer, begin, end)
+	direct_lr_actions<Grammar>(actions, tokenizer, begin, end)
+	lr_parse_actions<Grammar>(actions, tokenizer, begin, end)
+	lr_parser<Tables, Tokenizer, It>::parse_actions(actions, begin, end)
+
+	return an action_result with the value of the input. recursive_descent backtracks, so it can call
+	actions on alternatives that are later unwound, and its actions should not have side effects.
+	It also keeps the values of the children of each rule until the parse finishes, so that it can
+	unwind a rule, whereas an LR parser only holds the values of the rules that are unfinished.
+	This is the IParseActions of the C# parser, without the virtual calls.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace slurp
+{
+	// The kind of a rule that is known at compile time, which converts to a short.
+	template<short Kind>
+	using rule_kind = std::integral_constant<short, Kind>;
+
+	// The result of a parse with semantic actions.
+	template<typename Value>
+	struct action_result
+	{
+		// true if the parse was successful.
+		bool success;
+
+		// The value of the input, if the parse was successful.
+		Value value;
+
+		// Where the parse failed, from the LR parsers.
+		TokenData syntaxError;
+
+		operator bool() const { return success; }
+	};
+
+	/*
+		The values of the symbols that have been parsed, in the same way as the nodes of a Stack.
+		This has the Shift, Reduce, Top and Unwind that the parsers use on a Stack.
+
+		A Stack only appends, so unwinding it also undoes reductions. An action_stack replaces the
+		children of a rule with its value, so to unwind, it needs backtrack, where the steps since
+		a position are undone and the values of the children are restored.
+	*/
+	template<typename Actions>
+	class action_stack
+	{
+	public:
+		typedef typename Actions::value_type value_type;
+		typedef std::size_t size_type;
+
+		explicit action_stack(Actions& actions, bool backtrack = false) : actions(actions), backtrack(backtrack)
+		{
+			values.reserve(64);
+		}
+
+		template<typename It>
+		void Shift(short kind, const TokenData& data, It start, It end)
+		{
+			values.push_back(actions.token(kind, data, start, end));
+			if (backtrack) steps.push_back(0);
+		}
+
+		// Shifts a rule with no children, where a Stack would shift a node with no text.
+		template<typename Kind>
+		void Shift(Kind kind, const TokenData&, [[maybe_unused]] unsigned length)
+		{
+			assert(length == 0);
+			Reduce(kind, 0);
+		}
+
+		template<typename Kind>
+		void Reduce(Kind kind, unsigned short numberOfChildren)
+		{
+			assert(numberOfChildren <= values.size());
+			size_type start = values.size() - numberOfChildren;
+
+			// The children stay on the stack until the action returns
+			value_type value = actions.reduce(kind, values.data() + start, numberOfChildren);
+			if (backtrack)
+			{
+				steps.push_back(numberOfChildren);
+				std::move(values.begin() + start, values.end(), std::back_inserter(reduced));
+			}
+			values.erase(values.begin() + start, values.end());
+			values.push_back(std::move(value));
+		}
+
+		// The position to unwind to, which is the number of values, or of steps with backtrack.
+		size_type Top() const { return backtrack ? steps.size() : values.size(); }
+
+		// Unwinds the stack to a position previously given by Top(),
+		// which without backtrack must be before only shifts.
+		void Unwind(size_type position)
+		{
+			if (!backtrack)
+			{
+				values.erase(values.begin() + position, values.end());
+				return;
+			}
+
+			for (; steps.size() > position; steps.pop_back())
+			{
+				values.pop_back();
+				std::move(reduced.end() - steps.back(), reduced.end(), std::back_inserter(values));
+				reduced.erase(reduced.end() - steps.back(), reduced.end());
+			}
+		}
+
+		// The result of a parse that has finished, where the value of the input is the only value.
+		action_result<value_type> Result(bool success, const TokenData& position)
+		{
+			assert(!success || values.size() == 1);
+			action_result<value_type> result{ success, value_type(), position };
+			if (success) result.value = std::move(values.back());
+			return result;
+		}
+
+	private:
+		Actions& actions;
+		bool backtrack;
+		std::vector<value_type> values;
+
+		// With backtrack, the number of children of each shift (0) or reduction,
+		// and the values of the children that have been reduced.
+		std::vector<unsigned short> steps;
+		std::vector<value_type> reduced;
+	};
+}
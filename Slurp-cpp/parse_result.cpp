@@ -8,7 +8,7 @@ slurp::parse_result::parse_result()
 {
 }
 
-slurp::parse_result::parse_result(Stack&& stack) : stack(stack)
+slurp::parse_result::parse_result(Stack&& stack) : stack(std::move(stack))
 {
 }
 
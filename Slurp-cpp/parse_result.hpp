@@ -22,6 +22,25 @@ namespace slurp
 		// Undefined if the parse has not completed successfully.
 		const Node& root() const;
 
+		// Gets the root of a parse tree with packed_nodes (see stack_options).
+		packed_node packed_root() const { return stack.PackedRoot(); }
+
+		// The Stack holding the parse tree.
+		const Stack& tree() const { return stack; }
+
+		// Folds the parse tree on the threads of a pool (see parallel_tree.hpp).
+		template<typename Fold, typename Combine>
+		auto parallel_fold(thread_pool& pool, Fold fold, Combine combine, std::size_t threshold = default_split_bytes) const
+		{
+			return slurp::parallel_fold(pool, root(), fold, combine, threshold);
+		}
+
+		template<typename Visit>
+		void parallel_for_each_subtree(thread_pool& pool, Visit visit, std::size_t threshold = default_split_bytes) const
+		{
+			slurp::parallel_for_each_subtree(pool, root(), visit, threshold);
+		}
+
 		// A list of syntax errors !!
 		TokenData syntaxError;
 
@@ -30,6 +49,12 @@ namespace slurp
 		// Constucts a parse result containing a successful parse tree
 		parse_result(Stack&& stack);
 
+		// Moving a parse_result does not copy the tree.
+		parse_result(const parse_result&) = default;
+		parse_result(parse_result&&) = default;
+		parse_result& operator=(const parse_result&) = default;
+		parse_result& operator=(parse_result&&) = default;
+
 		~parse_result();
 	private:
 		Stack stack;
@@ -1,80 +1,39 @@
 
 namespace slurp
 {
-	template<typename S, typename Visited=ts_empty, bool Recursive=ts_contains<S,Visited>::value>
-	struct reachable_symbols;
-
-	template<typename S, typename Visited>
-	struct reachable_symbols<S, Visited, true>
-	{
-		// A recursion guard: if we have looked for
-		// reachable symbols in S already, then we do not
-		// recursively attempt to add S to Visited.
-		typedef Visited type;
-	};
-
-	template<typename S, typename Visited>
-	struct reachable_symbols2;
-
-	template<typename S, typename Visited>
-	struct reachable_symbols<S, Visited, false>
-	{
-		typedef typename ts_concat<S, Visited>::type t;
-		typedef typename reachable_symbols2<typename S::rule, t>::type type;
-	};
-
-	template<int N, typename Visited>
-	struct reachable_symbols2<Rule<N>, Visited>
-	{
-		typedef Visited type;
-	};
-
-
-	template<int N, typename H, typename Visited, typename...Ts>
-	struct reachable_symbols2<Rule<N, H, Ts...>, Visited>
-	{
-		typedef typename reachable_symbols<H,Visited>::type t;
-		typedef typename reachable_symbols2<Rule<N, Ts...>, t>::type type;
-	};
-
-	template<typename Visited>
-	struct reachable_symbols2<Rules<>, Visited>
-	{
-		typedef Visited type;
-	};
-
-	template<int K, typename T, typename Visited>
-	struct reachable_symbols2<Token<K, T>, Visited>
+	namespace helpers
 	{
-		typedef typename ts_insert<Token<K, T>, Visited>::type type;
-	};
-
-	template<typename H, typename Visited, typename...Ts>
-	struct reachable_symbols2<Rules<H, Ts...>, Visited>
-	{
-		typedef typename reachable_symbols2<H, Visited>::type t1;
-		typedef typename reachable_symbols2<Rules<Ts...>, t1>::type type;
-	};
-
-	template<int N, typename T, typename Visited>
-	struct reachable_symbols<Token<N, T>, Visited, false>
-	{
-		typedef typename ts_insert<Token<N, T>, Visited>::type type;
-	};
-
-	struct is_terminal
-	{
-		template<typename S>
-		struct predicate
+		// Whether a symbol is an anonymous Rule<> or Rules<> inside another rule.
+		struct is_anonymous_rule
 		{
-			static const bool value = false;
+			template<typename S>
+			struct predicate
+			{
+				static const bool value = false;
+			};
+
+			template<int Kind, typename... Ts>
+			struct predicate<Rule<Kind, Ts...>>
+			{
+				static const bool value = true;
+			};
+
+			template<typename... Ts>
+			struct predicate<Rules<Ts...>>
+			{
+				static const bool value = true;
+			};
 		};
+	}
 
-		template<int N, typename T>
-		struct predicate<Token<N, T>>
-		{
-			static const bool value = true;
-		};
+	// The named symbols and the tokens that are reachable from S, added to Visited.
+	// This is the search of flat_grammar (see grammar.hpp), without the anonymous rules.
+	template<typename S, typename Visited = ts_empty>
+	struct reachable_symbols
+	{
+		typedef typename helpers::reachable<helpers::list<S>, helpers::list<>>::type symbols;
+		typedef typename helpers::select<symbols, helpers::is_anonymous_rule, false>::type named;
+		typedef typename ts_union<Visited, typename helpers::to_typeset<named>::type>::type type;
 	};
 
 	template<typename S>
@@ -94,9 +53,6 @@ namespace slurp
 
 	// How to expand a closure
 
-
-	typedef Token<-1, void> eof;
-
 	template<typename Symbol>
 	struct parser_construction
 	{
@@ -105,9 +61,16 @@ namespace slurp
 			typedef Rule<-1, Symbol, eof> rule;
 		};
 
-		using symbols = typename reachable_symbols<start>::type;
-		using terminals = typename ts_where<symbols, is_terminal>::type;
-		using nonterminals = typename ts_except<symbols, is_terminal>::type;
+		// The grammar, flattened into arrays of productions.
+		typedef flat_grammar<start> grammar;
+
+		using symbols = typename grammar::symbols;
+		using terminals = typename grammar::terminals;
+		using nonterminals = typename grammar::nonterminals;
+
+		// A set of symbols, represented as bits over symbols.
+		template<typename Ts>
+		using symbol_bits = typename ts_to_bits<symbols, Ts>::type;
 
 		typedef item<start, 0, eof> start_item;
 	};
@@ -24,7 +24,7 @@ namespace slurp
 		template<typename Symbol, typename Target>
 		struct front_recursive
 		{
-			static const bool value = front_recursive<typename Symbol::rules, Target>::value;
+			static const bool value = front_recursive<typename Symbol::rule, Target>::value;
 		};
 
 		template<typename Target>
@@ -61,7 +61,9 @@ namespace slurp
 		template<int Kind, typename T, typename Target, typename...Ts>
 		struct front_recursive<Rule<Kind, T, Ts...>, Target>
 		{
-			static const bool value = front_recursive<T, Target>::value || is_empty<T>::value && front_recursive<Rule<Kind, Ts...>, Target>::value;
+			// Only look past T if it is empty, so that recursion later in the rule terminates
+			static const bool value = front_recursive<T, Target>::value ||
+				std::conditional<is_empty<T>::value, front_recursive<Rule<Kind, Ts...>, Target>, std::false_type>::type::value;
 		};
 	}
 
@@ -72,12 +74,15 @@ namespace slurp
 		static const bool value = helpers::front_recursive<typename Symbol::rule, Symbol>::value;
 	};
 
+	template<typename It>
+	class packrat_stack;
+
 	namespace helpers
 	{
-		template<typename Tokenizer, typename It>
+		template<typename Tokenizer, typename It, typename Output = Stack>
 		struct recursive_continuation
 		{
-			virtual bool call(Tokenizer tok, token_position<It>& pos, Stack& stack) const = 0;
+			virtual bool call(Tokenizer tok, token_position<It>& pos, Output& stack) const = 0;
 		};
 
 		template<typename Tokenizer, typename It>
@@ -167,7 +172,7 @@ namespace slurp
 
 			parse_result result()
 			{
-				return stack;
+				return std::move(stack);
 			}
 		};
 
@@ -176,12 +181,19 @@ namespace slurp
 		{
 			static_assert(!slurp::front_recursive<Symbol>::value, "Symbol in recursive descent parser is front-recursive");
 
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer tok, token_position<It>& pos, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer tok, token_position<It>& pos, Output& stack, const recursive_continuation<Tokenizer, It, Output>& next)
 			{
 				return recursive_descent<typename Symbol::rule>::parse(tok, pos, stack, next);
 			}
 
+			// The results of a symbol are memoised in a packrat_stack (see packrat.hpp).
+			template<typename Tokenizer, typename It>
+			static bool parse(Tokenizer tok, token_position<It>& pos, packrat_stack<It>& stack, const recursive_continuation<Tokenizer, It, packrat_stack<It>>& next)
+			{
+				return stack.template parse<Symbol>(tok, pos, next);
+			}
+
 			template<typename Tokenizer, typename It>
 			static void parse2(recursive_stack<Tokenizer, It>& stack)
 			{
@@ -193,8 +205,8 @@ namespace slurp
 		template<int Kind, typename T>
 		struct recursive_descent<Token<Kind, T>>
 		{
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer tok, token_position<It>& pos, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer tok, token_position<It>& pos, Output& stack, const recursive_continuation<Tokenizer, It, Output>& next)
 			{
 				if (pos.kind == Kind)
 				{
@@ -221,10 +233,10 @@ namespace slurp
 		template<int Kind>
 		struct recursive_descent<Rule<Kind>>
 		{
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer tok, token_position<It>& pos, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer tok, token_position<It>& pos, Output& stack, const recursive_continuation<Tokenizer, It, Output>& next)
 			{
-				stack.Shift(Kind, t.data, 0);  // A node with no children
+				stack.Shift(rule_kind<Kind>(), pos.data, 0);  // A node with no children
 				return next.call(tok, pos, stack);
 			}
 
@@ -238,8 +250,8 @@ namespace slurp
 		template<>
 		struct recursive_descent<Rules<>>
 		{
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer, token_position<It>& t, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer, token_position<It>&, Output&, const recursive_continuation<Tokenizer, It, Output>&)
 			{
 				return false;
 			}
@@ -253,8 +265,8 @@ namespace slurp
 		template<typename H, typename... Ts>
 		struct recursive_descent<Rules<H, Ts...>>
 		{
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer tok, token_position<It>& pos, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer tok, token_position<It>& pos, Output& stack, const recursive_continuation<Tokenizer, It, Output>& next)
 			{
 				auto save1 = pos;
 				auto save2 = stack.Top();
@@ -284,11 +296,11 @@ namespace slurp
 		template<int Node, int Children>
 		struct recursive_descent_rule<Node, Children>
 		{
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer tok, token_position<It>& pos, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer tok, token_position<It>& pos, Output& stack, const recursive_continuation<Tokenizer, It, Output>& next)
 			{
 				// Successful reduction - there are Children items on the stack
-				stack.Reduce(Node, Children);
+				stack.Reduce(rule_kind<Node>(), Children);
 				return next.call(tok, pos, stack);
 			}
 
@@ -303,24 +315,24 @@ namespace slurp
 		struct recursive_descent_rule<Node, Children, H, Ts...>
 		{
 
-			template<typename Tokenizer, typename It>
-			class recursive_call : public recursive_continuation<Tokenizer, It>
+			template<typename Tokenizer, typename It, typename Output>
+			class recursive_call : public recursive_continuation<Tokenizer, It, Output>
 			{
 			public:
-				recursive_call(const recursive_continuation<Tokenizer, It>& next) : m_next(next) { }
+				recursive_call(const recursive_continuation<Tokenizer, It, Output>& next) : m_next(next) { }
 
-				const recursive_continuation<Tokenizer, It>& m_next;
+				const recursive_continuation<Tokenizer, It, Output>& m_next;
 
-				bool call(Tokenizer tok, token_position<It>& pos, Stack& stack) const
+				bool call(Tokenizer tok, token_position<It>& pos, Output& stack) const
 				{
 					return recursive_descent_rule<Node, Children + 1, Ts...>::parse(tok, pos, stack, m_next);
 				};
 			};
 
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer tok, token_position<It>& pos, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer tok, token_position<It>& pos, Output& stack, const recursive_continuation<Tokenizer, It, Output>& next)
 			{
-				return recursive_descent<H>::parse(tok, pos, stack, recursive_call<Tokenizer, It>(next));
+				return recursive_descent<H>::parse(tok, pos, stack, recursive_call<Tokenizer, It, Output>(next));
 			}
 
 			template<typename Tokenizer, typename It>
@@ -336,8 +348,8 @@ namespace slurp
 		template<int Node, typename...Ts>
 		struct recursive_descent<Rule<Node, Ts...>>
 		{
-			template<typename Tokenizer, typename It>
-			static bool parse(Tokenizer tok, token_position<It>& pos, Stack& stack, const recursive_continuation<Tokenizer, It>& next)
+			template<typename Tokenizer, typename It, typename Output>
+			static bool parse(Tokenizer tok, token_position<It>& pos, Output& stack, const recursive_continuation<Tokenizer, It, Output>& next)
 			{
 				return recursive_descent_rule<Node, 0, Ts...>::parse(tok, pos, stack, next);
 			}
@@ -349,11 +361,11 @@ namespace slurp
 			}
 		};
 
-		template<typename Tokenizer, typename It>
-		class recursive_descent_eof : public recursive_continuation<Tokenizer, It>
+		template<typename Tokenizer, typename It, typename Output = Stack>
+		class recursive_descent_eof : public recursive_continuation<Tokenizer, It, Output>
 		{
 		public:
-			bool call(Tokenizer tok, token_position<It>& pos, Stack& stack) const override
+			bool call(Tokenizer, token_position<It>& pos, Output&) const override
 			{
 				return pos.kind == -1;
 			}
@@ -373,6 +385,18 @@ namespace slurp
 		return parse_result();
 	}
 
+	// Parses the input by recursive descent, and computes its value with actions (see parse_actions.hpp).
+	template<typename Grammar, typename Actions, typename Tokenizer, typename It>
+	action_result<typename Actions::value_type> recursive_descent_actions(Actions& actions, Tokenizer tok, It a, It b)
+	{
+		token_position<It> pos(a, b);
+		action_stack<Actions> stack(actions, true);
+		tok.MoveNext(pos);
+
+		bool success = helpers::recursive_descent<Grammar>::parse(tok, pos, stack, helpers::recursive_descent_eof<Tokenizer, It, action_stack<Actions>>());
+		return stack.Result(success, TokenData());
+	}
+
 	template<typename Grammar, typename Tokenizer, typename It> parse_result recursive_descent2(Tokenizer tok, It a, It b)
 	{
 		helpers::recursive_stack<Tokenizer, It> stack(helpers::recursive_descent<Grammar>::parse2, tok, token_position<It>(a,b));
@@ -384,6 +408,6 @@ namespace slurp
 	template<typename Grammar, typename It>
 	parser<It> recursive_descent_parser()
 	{
-		return recursive_descent_parser_fn<Grammar, It>;
+		return parser<It>(nullptr);
 	}
 }
@@ -0,0 +1,500 @@
+#include "slurp.hpp"
+
+#include <map>
+#include <algorithm>
+
+namespace
+{
+	// A set of bits whose size is only known at runtime.
+	class dynamic_bitset
+	{
+	public:
+		dynamic_bitset(int size = 0) : words((size + 63) / 64) {}
+
+		bool contains(int i) const
+		{
+			return (words[i / 64] >> (i % 64)) & 1;
+		}
+
+		void insert(int i)
+		{
+			words[i / 64] |= std::uint64_t(1) << (i % 64);
+		}
+
+		// Returns true if this set changed.
+		bool insert_all(const dynamic_bitset& other)
+		{
+			bool changed = false;
+			for (std::size_t w = 0; w < words.size(); ++w)
+			{
+				std::uint64_t next = words[w] | other.words[w];
+				changed = changed || next != words[w];
+				words[w] = next;
+			}
+			return changed;
+		}
+
+		bool empty() const
+		{
+			for (std::uint64_t w : words)
+				if (w) return false;
+			return true;
+		}
+
+		bool operator<(const dynamic_bitset& other) const
+		{
+			return words < other.words;
+		}
+
+	private:
+		std::vector<std::uint64_t> words;
+	};
+
+	// The LALR(1) construction of lalr_builder, over a runtime_flat_grammar.
+	class lalr_construction
+	{
+	public:
+		explicit lalr_construction(const slurp::runtime_flat_grammar& g) : g(g)
+		{
+			number_of_items = (int)g.rhs.size() + g.number_of_productions();
+			make_items();
+			make_sets();
+			make_states();
+			propagate_lookaheads();
+		}
+
+		const slurp::runtime_flat_grammar& g;
+		int number_of_items;
+
+		std::vector<int> production, next, first_production;
+		std::vector<dynamic_bitset> initial;
+
+		std::vector<bool> nullable;
+		std::vector<dynamic_bitset> first;
+
+		// The sorted items in the closure of each state.
+		std::vector<std::vector<int>> closure;
+		std::vector<std::vector<int>> transitions;
+
+		// The lookaheads of closure[state][i].
+		std::vector<std::vector<dynamic_bitset>> lookaheads;
+
+		int first_item(int p) const
+		{
+			return g.productions[p].rhs + p;
+		}
+
+		bool accepts(int item) const
+		{
+			return next[item] == 0 && g.productions[production[item]].lhs == g.root;
+		}
+
+		int index_in_state(int state, int item) const
+		{
+			const std::vector<int>& items = closure[state];
+			return int(std::lower_bound(items.begin(), items.end(), item) - items.begin());
+		}
+
+	private:
+		void make_items()
+		{
+			production.resize(number_of_items);
+			next.resize(number_of_items);
+			for (int p = 0; p < g.number_of_productions(); ++p)
+			{
+				const slurp::production& prod = g.productions[p];
+				for (int d = 0; d <= prod.length; ++d)
+				{
+					production[first_item(p) + d] = p;
+					next[first_item(p) + d] = d < prod.length ? g.rhs[prod.rhs + d] : -1;
+				}
+			}
+
+			first_production.resize(g.number_of_symbols + 1);
+			for (int s = 0, p = 0; s <= g.number_of_symbols; ++s)
+			{
+				while (p < g.number_of_productions() && g.productions[p].lhs < s)
+					++p;
+				first_production[s] = p;
+			}
+
+			initial.assign(g.number_of_symbols, dynamic_bitset(number_of_items));
+			for (int p = 0; p < g.number_of_productions(); ++p)
+				initial[g.productions[p].lhs].insert(first_item(p));
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (int p = 0; p < g.number_of_productions(); ++p)
+				{
+					int n = next[first_item(p)];
+					if (n >= g.number_of_terminals)
+						changed = initial[g.productions[p].lhs].insert_all(initial[n]) || changed;
+				}
+			}
+		}
+
+		void make_sets()
+		{
+			nullable.assign(g.number_of_symbols, false);
+			first.assign(g.number_of_symbols, dynamic_bitset(g.number_of_terminals));
+			for (int t = 0; t < g.number_of_terminals; ++t)
+				first[t].insert(t);
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (const slurp::production& p : g.productions)
+				{
+					changed = first[p.lhs].insert_all(first_of(p.rhs, p.rhs + p.length)) || changed;
+					if (!nullable[p.lhs] && nullable_of(p.rhs, p.rhs + p.length))
+						changed = nullable[p.lhs] = true;
+				}
+			}
+		}
+
+		void make_states()
+		{
+			std::map<dynamic_bitset, int> states;
+			std::vector<dynamic_bitset> kernels;
+
+			dynamic_bitset start(number_of_items);
+			for (int p = first_production[g.root]; p < first_production[g.root + 1]; ++p)
+				start.insert(first_item(p));
+			states[start] = 0;
+			kernels.push_back(start);
+
+			for (std::size_t s = 0; s < kernels.size(); ++s)
+			{
+				dynamic_bitset c = kernels[s];
+				for (int i = 0; i < number_of_items; ++i)
+					if (kernels[s].contains(i) && next[i] >= g.number_of_terminals)
+						c.insert_all(initial[next[i]]);
+
+				std::vector<int> items;
+				for (int i = 0; i < number_of_items; ++i)
+					if (c.contains(i)) items.push_back(i);
+
+				// The parser accepts instead of shifting the eof at the end of the root.
+				std::vector<dynamic_bitset> gotos(g.number_of_symbols, dynamic_bitset(number_of_items));
+				for (int i : items)
+					if (next[i] >= 0 && !accepts(i))
+						gotos[next[i]].insert(i + 1);
+
+				std::vector<int> row(g.number_of_symbols, -1);
+				for (int x = 0; x < g.number_of_symbols; ++x)
+				{
+					if (gotos[x].empty()) continue;
+					auto found = states.insert(std::make_pair(gotos[x], (int)kernels.size()));
+					if (found.second)
+						kernels.push_back(gotos[x]);
+					row[x] = found.first->second;
+				}
+
+				closure.push_back(std::move(items));
+				transitions.push_back(std::move(row));
+			}
+		}
+
+		void propagate_lookaheads()
+		{
+			int number_of_states = (int)closure.size();
+
+			std::vector<dynamic_bitset> rest_first(number_of_items, dynamic_bitset(g.number_of_terminals));
+			std::vector<bool> rest_nullable(number_of_items);
+			for (int i = 0; i < number_of_items; ++i)
+			{
+				if (next[i] >= 0)
+				{
+					const slurp::production& p = g.productions[production[i]];
+					int begin = p.rhs + i - first_item(production[i]) + 1, end = p.rhs + p.length;
+					rest_first[i] = first_of(begin, end);
+					rest_nullable[i] = nullable_of(begin, end);
+				}
+			}
+
+			lookaheads.resize(number_of_states);
+			for (int s = 0; s < number_of_states; ++s)
+				lookaheads[s].assign(closure[s].size(), dynamic_bitset(g.number_of_terminals));
+
+			for (std::size_t i = 0; i < closure[0].size(); ++i)
+				if (g.productions[production[closure[0][i]]].lhs == g.root)
+					lookaheads[0][i].insert(0);
+
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (int s = 0; s < number_of_states; ++s)
+				{
+					for (std::size_t j = 0; j < closure[s].size(); ++j)
+					{
+						int i = closure[s][j], x = next[i];
+						if (x < 0 || accepts(i)) continue;
+
+						// Lookaheads are carried over the transition
+						int target = transitions[s][x];
+						changed = lookaheads[target][index_in_state(target, i + 1)].insert_all(lookaheads[s][j]) || changed;
+
+						// Lookaheads of the items added by the closure
+						if (x >= g.number_of_terminals)
+						{
+							dynamic_bitset la = rest_first[i];
+							if (rest_nullable[i]) la.insert_all(lookaheads[s][j]);
+
+							for (int p = first_production[x]; p < first_production[x + 1]; ++p)
+								changed = lookaheads[s][index_in_state(s, first_item(p))].insert_all(la) || changed;
+						}
+					}
+				}
+			}
+		}
+
+		bool nullable_of(int begin, int end) const
+		{
+			for (int i = begin; i < end; ++i)
+				if (!nullable[g.rhs[i]]) return false;
+			return true;
+		}
+
+		dynamic_bitset first_of(int begin, int end) const
+		{
+			dynamic_bitset result(g.number_of_terminals);
+			for (int i = begin; i < end; ++i)
+			{
+				result.insert_all(first[g.rhs[i]]);
+				if (!nullable[g.rhs[i]]) break;
+			}
+			return result;
+		}
+	};
+
+	void hash_value(std::uint64_t& hash, std::int64_t value)
+	{
+		// FNV-1a
+		for (int b = 0; b < 8; ++b, value >>= 8)
+		{
+			hash ^= std::uint64_t(value & 0xff);
+			hash *= 0x100000001b3ull;
+		}
+	}
+}
+
+slurp::runtime_grammar::symbol slurp::runtime_grammar::add(element_type type, short kind, std::vector<symbol> children)
+{
+	elements.push_back(element{ type, kind, std::move(children) });
+	return (symbol)elements.size() - 1;
+}
+
+slurp::runtime_grammar::symbol slurp::runtime_grammar::token(short kind)
+{
+	for (std::size_t s = 0; s < elements.size(); ++s)
+		if (elements[s].type == token_element && elements[s].kind == kind)
+			return (symbol)s;
+	return add(token_element, kind, {});
+}
+
+slurp::runtime_grammar::symbol slurp::runtime_grammar::rule(short kind, std::initializer_list<symbol> body)
+{
+	return add(rule_element, kind, body);
+}
+
+slurp::runtime_grammar::symbol slurp::runtime_grammar::rule(short kind, const std::vector<symbol>& body)
+{
+	return add(rule_element, kind, body);
+}
+
+slurp::runtime_grammar::symbol slurp::runtime_grammar::rules(std::initializer_list<symbol> alternatives)
+{
+	return add(rules_element, 0, alternatives);
+}
+
+slurp::runtime_grammar::symbol slurp::runtime_grammar::rules(const std::vector<symbol>& alternatives)
+{
+	return add(rules_element, 0, alternatives);
+}
+
+slurp::runtime_grammar::symbol slurp::runtime_grammar::declare()
+{
+	return add(named_element, 0, {});
+}
+
+void slurp::runtime_grammar::define(symbol s, symbol rule)
+{
+	assert(elements[s].type == named_element && elements[s].children.empty());
+	elements[s].children.push_back(rule);
+}
+
+const std::vector<slurp::runtime_grammar::symbol>& slurp::runtime_grammar::alternatives(symbol s) const
+{
+	// The rule of a named symbol
+	if (elements[s].type == named_element)
+	{
+		assert(!elements[s].children.empty() && "Symbol has not been defined");
+		s = elements[s].children[0];
+	}
+
+	static const std::vector<symbol> none;
+	if (elements[s].type == rules_element)
+		return elements[s].children;
+
+	// A single alternative is stored as the symbol itself
+	return none;
+}
+
+slurp::runtime_flat_grammar slurp::runtime_grammar::flatten(symbol start) const
+{
+	// The augmented start symbol is Rule<-1, start, eof>
+	runtime_grammar g = *this;
+	symbol eof = g.token(-1);
+	symbol root = g.rule(-1, { start, eof });
+
+	// The alternatives of a nonterminal, as in symbol_rule and body_productions.
+	auto alternatives_of = [&](symbol s) {
+		std::vector<symbol> result = g.alternatives(s);
+		if (result.empty())
+			result.push_back(g.elements[s].type == named_element ? g.elements[s].children[0] : s);
+		return result;
+	};
+
+	// The symbols of an alternative, as in alternative_symbols
+	auto alternative_symbols = [&](symbol a) {
+		return g.elements[a].type == rule_element ? g.elements[a].children : std::vector<symbol>{ a };
+	};
+
+	// Breadth-first search for reachable symbols
+	std::vector<symbol> reachable = { root };
+	std::vector<bool> visited(g.elements.size());
+	visited[root] = true;
+	for (std::size_t i = 0; i < reachable.size(); ++i)
+	{
+		symbol s = reachable[i];
+		if (g.elements[s].type == token_element) continue;
+		for (symbol a : alternatives_of(s))
+			for (symbol x : alternative_symbols(a))
+				if (!visited[x])
+				{
+					visited[x] = true;
+					reachable.push_back(x);
+				}
+	}
+
+	std::vector<symbol> symbols = { eof };
+	for (symbol s : reachable)
+		if (g.elements[s].type == token_element && s != eof)
+			symbols.push_back(s);
+
+	runtime_flat_grammar result;
+	result.number_of_terminals = (int)symbols.size();
+	for (symbol s : reachable)
+		if (g.elements[s].type != token_element)
+			symbols.push_back(s);
+	result.number_of_symbols = (int)symbols.size();
+	result.root = result.number_of_terminals;
+
+	std::vector<int> ordinal(g.elements.size(), -1);
+	for (std::size_t i = 0; i < symbols.size(); ++i)
+		ordinal[symbols[i]] = (int)i;
+
+	for (int t = 0; t < result.number_of_terminals; ++t)
+		result.kinds.push_back(g.elements[symbols[t]].kind);
+
+	for (int n = result.number_of_terminals; n < result.number_of_symbols; ++n)
+	{
+		for (symbol a : alternatives_of(symbols[n]))
+		{
+			bool node = g.elements[a].type == rule_element;
+			std::vector<symbol> body = alternative_symbols(a);
+			result.productions.push_back(production{ n, (int)result.rhs.size(), (int)body.size(), node ? g.elements[a].kind : (short)0, node });
+			for (symbol x : body)
+				result.rhs.push_back(ordinal[x]);
+		}
+	}
+
+	return result;
+}
+
+std::uint64_t slurp::runtime_flat_grammar::hash() const
+{
+	std::uint64_t result = 0xcbf29ce484222325ull;
+	hash_value(result, number_of_symbols);
+	hash_value(result, number_of_terminals);
+	for (short k : kinds)
+		hash_value(result, k);
+	for (const production& p : productions)
+	{
+		hash_value(result, p.lhs);
+		hash_value(result, p.length);
+		hash_value(result, p.kind);
+		hash_value(result, p.node);
+	}
+	for (int s : rhs)
+		hash_value(result, s);
+	return result;
+}
+
+slurp::runtime_tables::runtime_tables(const runtime_flat_grammar& g) :
+	number_of_symbols(g.number_of_symbols), number_of_terminals(g.number_of_terminals),
+	conflicts(0), conflict_state(-1), conflict_symbol(-1),
+	grammar_hash(g.hash())
+{
+	lalr_construction lalr(g);
+	number_of_states = (int)lalr.closure.size();
+	number_of_rules = g.number_of_productions();
+
+	actions.assign(number_of_states * number_of_symbols, lr_action{ lr_error, 0 });
+
+	// As lalr_builder::set_action
+	auto set_action = [&](int s, int x, lr_action a) {
+		lr_action& current = actions[s * number_of_symbols + x];
+		if (current.action == lr_error || current == a)
+		{
+			current = a;
+			return;
+		}
+
+		if (conflicts++ == 0)
+		{
+			conflict_state = s;
+			conflict_symbol = x;
+		}
+
+		if (current.action == lr_reduce && (a.action != lr_reduce || a.value < current.value))
+			current = a;
+	};
+
+	for (int s = 0; s < number_of_states; ++s)
+	{
+		for (std::size_t j = 0; j < lalr.closure[s].size(); ++j)
+		{
+			int i = lalr.closure[s][j], x = lalr.next[i], p = lalr.production[i];
+			if (x < 0)
+			{
+				for (int t = 0; t < number_of_terminals; ++t)
+					if (lalr.lookaheads[s][j].contains(t))
+						set_action(s, t, lr_action{ lr_reduce, p });
+			}
+			else if (lalr.accepts(i))
+				set_action(s, x, lr_action{ lr_accept, 0 });
+			else if (x < number_of_terminals)
+				set_action(s, x, lr_action{ lr_shift, lalr.transitions[s][x] });
+		}
+
+		for (int x = number_of_terminals; x < number_of_symbols; ++x)
+			if (lalr.transitions[s][x] >= 0)
+				set_action(s, x, lr_action{ lr_goto, lalr.transitions[s][x] });
+	}
+
+	for (const production& p : g.productions)
+		rules.push_back(lr_rule{ p.length, p.lhs, p.kind, p.node });
+
+	min_kind = *std::min_element(g.kinds.begin(), g.kinds.end());
+	max_kind = *std::max_element(g.kinds.begin(), g.kinds.end());
+	terminals.assign(max_kind - min_kind + 1, -1);
+	for (int t = 0; t < number_of_terminals; ++t)
+		terminals[g.kinds[t] - min_kind] = (short)t;
+}
+
+slurp::lr_table_view slurp::runtime_tables::view() const
+{
+	return lr_table_view{ actions.data(), rules.data(), terminals.data(), number_of_symbols, min_kind, (int)terminals.size() };
+}
@@ -0,0 +1,141 @@
+/*
+	Grammars and LR parser tables that are constructed at runtime.
+
+	runtime_grammar mirrors the compile-time grammar types:
+
+	Token<Kind, ...>     g.token(kind)
+	Rule<Kind, Xs...>    g.rule(kind, { xs... })
+	Rules<Xs...>         g.rules({ xs... })
+	struct S { rule }    S = g.declare(), then g.define(S, rule)
+
+	For example
+
+	runtime_grammar g;
+	auto digit = g.token('d');
+	auto integer = g.declare();
+	g.define(integer, g.rules({ digit, g.rule('i', { digit, integer }) }));
+
+	The grammar is flattened (runtime_flat_grammar) in the same way as flat_grammar,
+	and runtime_tables builds the same LALR(1) tables as lalr_tables, so an lr_parser
+	using runtime tables builds the same trees as a parser generated from types.
+
+	lr_table_view is a small copyable view of a set of tables that can be used
+	with lr_parser, and can point to tables in memory or in a mapped file (table_file.hpp).
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace slurp
+{
+	// The flattened productions of a runtime_grammar.
+	// Symbols are numbered as in flat_grammar: terminals (eof first), then nonterminals (root first).
+	struct runtime_flat_grammar
+	{
+		int number_of_symbols, number_of_terminals;
+		int root;
+
+		std::vector<short> kinds;  // The token kind of each terminal
+		std::vector<production> productions;  // Grouped by their left hand side
+		std::vector<int> rhs;
+
+		int number_of_productions() const { return (int)productions.size(); }
+
+		// A hash of the flattened grammar, used to identify the parser tables.
+		std::uint64_t hash() const;
+	};
+
+	class runtime_grammar
+	{
+	public:
+		typedef int symbol;
+
+		// A terminal with the given token kind.
+		// Tokens of the same kind are the same symbol.
+		symbol token(short kind);
+
+		// A rule that creates a node of the given kind, like Rule<Kind, Body...>.
+		symbol rule(short kind, std::initializer_list<symbol> body);
+		symbol rule(short kind, const std::vector<symbol>& body);
+
+		// A choice between alternatives, like Rules<Alternatives...>.
+		symbol rules(std::initializer_list<symbol> alternatives);
+		symbol rules(const std::vector<symbol>& alternatives);
+
+		// A named symbol (like a class with a rule) that is defined later.
+		// This is needed for recursive grammars.
+		symbol declare();
+		void define(symbol s, symbol rule);
+
+		// Flattens the grammar reachable from the start symbol.
+		runtime_flat_grammar flatten(symbol start) const;
+
+	private:
+		enum element_type { token_element, rule_element, rules_element, named_element };
+
+		struct element
+		{
+			element_type type;
+			short kind;
+			std::vector<symbol> children;
+		};
+
+		std::vector<element> elements;
+
+		symbol add(element_type type, short kind, std::vector<symbol> children);
+		const std::vector<symbol>& alternatives(symbol s) const;
+	};
+
+	// A view of LR parser tables, which can be used as the Tables of an lr_parser.
+	struct lr_table_view
+	{
+		const lr_action* actions;  // number_of_states rows of number_of_symbols
+		const lr_rule* rules;
+		const short* terminals;  // The terminal of each kind in [min_kind, min_kind + kind_range)
+		int number_of_symbols, min_kind, kind_range;
+
+		lr_action action(int state, int symbol) const
+		{
+			return actions[state * number_of_symbols + symbol];
+		}
+
+		const lr_rule& rule(int r) const
+		{
+			return rules[r];
+		}
+
+		int terminal(int kind) const
+		{
+			return kind < min_kind || kind >= min_kind + kind_range ? -1 : terminals[kind - min_kind];
+		}
+	};
+
+	// LALR(1) parser tables that are built at runtime.
+	class runtime_tables
+	{
+	public:
+		explicit runtime_tables(const runtime_flat_grammar& grammar);
+
+		int number_of_symbols, number_of_terminals, number_of_states, number_of_rules;
+
+		// The number of conflicts, and the state and symbol of the first conflict (or -1).
+		int conflicts, conflict_state, conflict_symbol;
+
+		// The hash of the grammar that the tables were built from.
+		std::uint64_t grammar_hash;
+
+		int min_kind, max_kind;
+		std::vector<lr_action> actions;
+		std::vector<lr_rule> rules;
+		std::vector<short> terminals;
+
+		lr_table_view view() const;
+
+		lr_action action(int state, int symbol) const { return view().action(state, symbol); }
+		const lr_rule& rule(int r) const { return rules[r]; }
+		int terminal(int kind) const { return view().terminal(kind); }
+	};
+}
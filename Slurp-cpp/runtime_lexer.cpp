@@ -0,0 +1,286 @@
+#include "slurp.hpp"
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+	// Builds the NFA of the parts of a runtime_lexer, in the same way as lex_part.
+	class nfa_builder
+	{
+	public:
+		explicit nfa_builder(slurp::runtime_lexer::nfa& nfa) : nfa(nfa) {}
+
+		int add_state()
+		{
+			nfa.edges.emplace_back();
+			nfa.epsilons.emplace_back();
+			nfa.accept.push_back(-1);
+			return (int)nfa.accept.size() - 1;
+		}
+
+		void epsilon(int from, int to)
+		{
+			nfa.epsilons[from].push_back(to);
+		}
+
+		void range(int from, int to, int lo, int hi)
+		{
+			nfa.edges[from].push_back(slurp::runtime_lexer::nfa::edge{ lo, hi, to });
+		}
+
+	private:
+		slurp::runtime_lexer::nfa& nfa;
+	};
+}
+
+slurp::runtime_lexer::part slurp::runtime_lexer::add(node n)
+{
+	nodes.push_back(n);
+	return (part)nodes.size() - 1;
+}
+
+slurp::runtime_lexer::part slurp::runtime_lexer::ch(int c)
+{
+	return range(c, c);
+}
+
+slurp::runtime_lexer::part slurp::runtime_lexer::range(int lo, int hi)
+{
+	assert(lo <= hi);
+	return add(node{ node_range, lo, hi, {} });
+}
+
+slurp::runtime_lexer::part slurp::runtime_lexer::seq(std::initializer_list<part> parts)
+{
+	return add(node{ node_seq, 0, 0, parts });
+}
+
+slurp::runtime_lexer::part slurp::runtime_lexer::rules(std::initializer_list<part> parts)
+{
+	return add(node{ node_rules, 0, 0, parts });
+}
+
+slurp::runtime_lexer::part slurp::runtime_lexer::star(part p)
+{
+	return add(node{ node_star, 0, 0, { p } });
+}
+
+slurp::runtime_lexer::part slurp::runtime_lexer::plus(part p)
+{
+	return seq({ p, star(p) });
+}
+
+void slurp::runtime_lexer::token(short kind, part p)
+{
+	assert(kind >= 0);
+	tokens.push_back(std::make_pair(kind, p));
+}
+
+void slurp::runtime_lexer::skip(part p)
+{
+	tokens.push_back(std::make_pair(short(-1), p));
+}
+
+std::shared_ptr<const slurp::runtime_lexer::nfa> slurp::runtime_lexer::compile() const
+{
+	auto result = std::make_shared<nfa>();
+	nfa_builder builder(*result);
+
+	// Returns the end state of a part built from a state
+	auto build = [&](part p, int from, auto& build) -> int {
+		const node& n = nodes[p];
+		switch (n.type)
+		{
+		case node_range:
+		{
+			int to = builder.add_state();
+			builder.range(from, to, n.lo, n.hi);
+			return to;
+		}
+		case node_seq:
+			for (part c : n.children)
+				from = build(c, from, build);
+			return from;
+		case node_rules:
+		{
+			int join = builder.add_state();
+			for (part c : n.children)
+				builder.epsilon(build(c, from, build), join);
+			return join;
+		}
+		default:
+		{
+			int loop = builder.add_state();
+			builder.epsilon(from, loop);
+			builder.epsilon(build(n.children[0], loop, build), loop);
+			return loop;
+		}
+		}
+	};
+
+	result->start = builder.add_state();
+	for (std::size_t t = 0; t < tokens.size(); ++t)
+	{
+		int start = builder.add_state();
+		builder.epsilon(result->start, start);
+		int end = build(tokens[t].second, start, build);
+		if (result->accept[end] < 0) result->accept[end] = (int)t;
+		result->kinds.push_back(tokens[t].first);
+	}
+
+	// The intervals between the bounds of the edges
+	std::vector<const nfa::edge*> edges;
+	for (auto& es : result->edges)
+		for (auto& e : es)
+		{
+			edges.push_back(&e);
+			result->boundaries.push_back(e.lo);
+			result->boundaries.push_back(e.hi + 1);
+		}
+	std::sort(result->boundaries.begin(), result->boundaries.end());
+	result->boundaries.erase(std::unique(result->boundaries.begin(), result->boundaries.end()), result->boundaries.end());
+
+	// Intervals that are in the same edges are in the same class
+	std::map<std::vector<int>, int> classes;
+	classes[std::vector<int>()] = 0;
+	result->class_representative.push_back(-1);
+	for (std::size_t i = 0; i + 1 < result->boundaries.size(); ++i)
+	{
+		int ch = result->boundaries[i];
+		std::vector<int> signature;
+		for (std::size_t e = 0; e < edges.size(); ++e)
+			if (edges[e]->lo <= ch && ch <= edges[e]->hi)
+				signature.push_back((int)e);
+
+		auto c = classes.insert(std::make_pair(signature, (int)classes.size()));
+		if (c.second) result->class_representative.push_back(ch);
+		result->interval_class.push_back(c.first->second);
+	}
+	result->number_of_classes = (int)classes.size();
+
+	for (int b = 0; b < 256; ++b)
+		result->byte_class[b] = (unsigned short)result->char_class(b);
+
+	return result;
+}
+
+int slurp::runtime_lexer::nfa::char_class(int ch) const
+{
+	auto i = std::upper_bound(boundaries.begin(), boundaries.end(), ch) - boundaries.begin() - 1;
+	return i < 0 || i >= (int)interval_class.size() ? 0 : interval_class[i];
+}
+
+slurp::lazy_tokenizer::lazy_tokenizer(const runtime_lexer& lexer, int max_states) :
+	nfa(lexer.compile()), max_states(std::max(max_states, 2)), closure_generation(0)
+{
+	closure_marks.assign(nfa->accept.size(), 0u);
+	flush();
+	number_of_flushes = 0;
+}
+
+std::size_t slurp::lazy_tokenizer::set_hash::operator()(const std::vector<int>& set) const
+{
+	// FNV-1a
+	std::size_t h = 14695981039346656037ull;
+	for (int s : set)
+		h = (h ^ (std::size_t)s) * 1099511628211ull;
+	return h;
+}
+
+void slurp::lazy_tokenizer::flush()
+{
+	transitions.clear();
+	accept.clear();
+	sets.clear();
+	states.clear();
+	++number_of_flushes;
+
+	std::vector<int> start = { nfa->start };
+	close(start);
+	add_state(start);
+}
+
+void slurp::lazy_tokenizer::next_generation()
+{
+	if (++closure_generation == 0)
+	{
+		std::fill(closure_marks.begin(), closure_marks.end(), 0);
+		closure_generation = 1;
+	}
+}
+
+void slurp::lazy_tokenizer::close(std::vector<int>& set)
+{
+	next_generation();
+
+	for (int s : set)
+		closure_marks[s] = closure_generation;
+
+	for (std::size_t i = 0; i < set.size(); ++i)
+		for (int t : nfa->epsilons[set[i]])
+			if (closure_marks[t] != closure_generation)
+			{
+				closure_marks[t] = closure_generation;
+				set.push_back(t);
+			}
+
+	std::sort(set.begin(), set.end());
+}
+
+int slurp::lazy_tokenizer::add_state(std::vector<int>& set)
+{
+	int token = -1;
+	for (int s : set)
+		if (nfa->accept[s] >= 0 && (token < 0 || nfa->accept[s] < token))
+			token = nfa->accept[s];
+
+	int state = (int)sets.size();
+	accept.push_back(token);
+	transitions.resize(transitions.size() + nfa->number_of_classes, unknown);
+	states.insert(std::make_pair(set, state));
+	sets.push_back(std::move(set));
+	return state;
+}
+
+int slurp::lazy_tokenizer::add_transition(int state, int cls)
+{
+	int ch = nfa->class_representative[cls];
+
+	std::vector<int> next;
+	if (cls != 0)
+	{
+		next_generation();
+		for (int s : sets[state])
+			for (const auto& e : nfa->edges[s])
+				if (e.lo <= ch && ch <= e.hi && closure_marks[e.to] != closure_generation)
+				{
+					closure_marks[e.to] = closure_generation;
+					next.push_back(e.to);
+				}
+	}
+
+	if (next.empty())
+	{
+		transitions[state * nfa->number_of_classes + cls] = -1;
+		return -1;
+	}
+
+	close(next);
+	auto i = states.find(next);
+	int result;
+	if (i != states.end())
+		result = i->second;
+	else if ((int)sets.size() < max_states)
+		result = add_state(next);
+	else
+	{
+		// The table is full, so start again with the start state and the new state
+		flush();
+		i = states.find(next);
+		return i != states.end() ? i->second : add_state(next);
+	}
+
+	transitions[state * nfa->number_of_classes + cls] = result;
+	return result;
+}
@@ -0,0 +1,193 @@
+/*
+	Tokenizers for tokens that are defined at runtime.
+
+	runtime_lexer mirrors the compile-time token parts of lexer.hpp:
+
+	Ch<C>                 lx.ch(c)
+	Range<C1, C2>         lx.range(c1, c2)
+	Seq<Ps...>            lx.seq({ ps... })
+	Rules<Ps...>          lx.rules({ ps... })
+	Integer (Digit+)      lx.plus(digit), or lx.star(p) for zero or more
+	Token<Kind, P>        lx.token(kind, p)
+	Skip                  lx.skip(p)
+
+	and compiles the tokens into an NFA, with the characters partitioned into classes
+	that the NFA does not distinguish.
+
+	lazy_tokenizer is a tokenizer (with MoveNext) for a runtime_lexer, which builds the
+	states of the DFA on demand: a transition is only computed from the NFA the first time
+	that it is taken, and then cached in a table with a row per state and a column per class.
+	This avoids building every state of a large set of tokens (such as keywords) up front,
+	and once the input has visited the states it needs, each character is a single table
+	lookup, as in a dfa_tokenizer. The table is bounded: when it is full, it is flushed and
+	the states are derived again.
+
+	The tokens have the same maximal munch semantics as dfa_tokenizer, where the earliest
+	token wins a tie, and an unmatched character is a token of kind lexer_error.
+*/
+
+#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace slurp
+{
+	class runtime_lexer
+	{
+	public:
+		typedef int part;
+
+		part ch(int c);
+		part range(int lo, int hi);
+		part seq(std::initializer_list<part> parts);
+		part rules(std::initializer_list<part> parts);
+
+		// Zero or more p.
+		part star(part p);
+
+		// One or more p.
+		part plus(part p);
+
+		// Adds a token, where earlier tokens win over later ones.
+		void token(short kind, part p);
+
+		// Adds a part that is matched but not returned as a token, such as whitespace.
+		void skip(part p);
+
+		// The compiled NFA of all of the tokens.
+		struct nfa
+		{
+			struct edge
+			{
+				int lo, hi, to;
+			};
+
+			int start;
+			std::vector<std::vector<edge>> edges;  // The character edges of each state
+			std::vector<std::vector<int>> epsilons;  // The epsilon edges of each state
+			std::vector<int> accept;  // The token (or skipped part) accepted in each state, or -1
+			std::vector<short> kinds;  // The kind of each token, or -1 for a skipped part
+
+			// The characters are partitioned into the intervals [boundaries[i], boundaries[i+1]),
+			// and classes of intervals, where class 0 is the characters that are in no token.
+			std::vector<int> boundaries, interval_class, class_representative;
+			unsigned short byte_class[256];
+			int number_of_classes;
+
+			int char_class(int ch) const;
+		};
+
+		std::shared_ptr<const nfa> compile() const;
+
+	private:
+		enum node_type { node_range, node_seq, node_rules, node_star };
+
+		struct node
+		{
+			node_type type;
+			int lo, hi;
+			std::vector<part> children;
+		};
+
+		std::vector<node> nodes;
+		std::vector<std::pair<short, part>> tokens;  // The kind (-1 to skip) and part of each token
+
+		part add(node n);
+	};
+
+	class lazy_tokenizer
+	{
+	public:
+		// max_states bounds the size of the state table.
+		explicit lazy_tokenizer(const runtime_lexer& lexer, int max_states = 4096);
+
+		template<typename It>
+		void MoveNext(token_position<It>& pos)
+		{
+			for (;;)
+			{
+				helpers::advance_token(pos);
+				if (pos.tok_start == pos.stream_end)
+				{
+					pos.kind = -1;
+					pos.data.length = 0;
+					return;
+				}
+
+				// Find the longest match
+				int state = 0, token = -1;
+				It end = pos.tok_start;
+				for (It p = pos.tok_start; p != pos.stream_end; ++p)
+				{
+					int c = helpers::code_unit(*p);
+					int cls = c < 256 ? nfa->byte_class[c] : nfa->char_class(c);
+					int next = transitions[state * nfa->number_of_classes + cls];
+					if (next == unknown) next = add_transition(state, cls);
+					if (next < 0) break;
+
+					state = next;
+					if (accept[state] >= 0)
+					{
+						token = accept[state];
+						end = std::next(p);
+					}
+				}
+
+				if (token < 0)
+				{
+					pos.kind = lexer_error;
+					pos.tok_end = std::next(pos.tok_start);
+				}
+				else
+				{
+					pos.tok_end = end;
+					if (nfa->kinds[token] < 0) continue;  // Skipped
+					pos.kind = nfa->kinds[token];
+				}
+
+				pos.data.length = (unsigned)(pos.tok_end - pos.tok_start);
+				return;
+			}
+		}
+
+		// The number of DFA states that have been built since the last flush.
+		int number_of_states() const { return (int)sets.size(); }
+
+		// The number of times that the state table has been full.
+		int flushes() const { return number_of_flushes; }
+
+	private:
+		static constexpr int unknown = -2;
+
+		std::shared_ptr<const runtime_lexer::nfa> nfa;
+		int max_states, number_of_flushes;
+
+		// The state table, with a row per DFA state and a column per class,
+		// where each entry is the next state, -1 for no transition, or unknown.
+		std::vector<int> transitions;
+		std::vector<int> accept;
+
+		// The NFA states of each DFA state, and the DFA state of each set.
+		std::vector<std::vector<int>> sets;
+
+		struct set_hash
+		{
+			std::size_t operator()(const std::vector<int>& set) const;
+		};
+		std::unordered_map<std::vector<int>, int, set_hash> states;
+
+		// Marks the NFA states in a set, where a new generation clears the marks.
+		std::vector<unsigned> closure_marks;
+		unsigned closure_generation;
+
+		void next_generation();
+
+		int add_transition(int state, int cls);
+		int add_state(std::vector<int>& set);
+		void close(std::vector<int>& set);
+		void flush();
+	};
+}
@@ -7,16 +7,34 @@
 #include <cassert>
 
 #include "typeset.h"
+#include "typeset_bits.h"
 #include "Node.h"
 #include "Stack.hpp"
+#include "compact_tree.hpp"
+#include "tree_cursor.hpp"
+#include "parallel_tree.hpp"
 
 #include "Rules.hpp"
+#include "grammar.hpp"
 #include "is_empty.hpp"
 #include "first.hpp"
 #include "follows.hpp"
 #include "closure.hpp"
 #include "parser_construction.hpp"
+#include "lalr.hpp"
 
 #include "tokenizer.hpp"
+#include "lexer.hpp"
+#include "line_index.hpp"
+#include "chunked_tokenizer.hpp"
+#include "runtime_lexer.hpp"
 #include "parse_result.hpp"
+#include "parse_actions.hpp"
 #include "recursive_descent.hpp"
+#include "packrat.hpp"
+#include "direct_lr.hpp"
+#include "lr_parser.hpp"
+#include "runtime_grammar.hpp"
+#include "table_file.hpp"
+#include "tree_file.hpp"
+#include "compressed_tables.hpp"
@@ -0,0 +1,331 @@
+#include "slurp.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char table_file_magic[8] = { 'S', 'L', 'U', 'R', 'P', 'L', 'R', 0 };
+
+	std::size_t actions_offset()
+	{
+		return sizeof(slurp::table_file_header);
+	}
+
+	std::size_t rules_offset(const slurp::table_file_header& h)
+	{
+		return actions_offset() + std::size_t(h.number_of_states) * h.number_of_symbols * sizeof(slurp::lr_action);
+	}
+
+	std::size_t terminals_offset(const slurp::table_file_header& h)
+	{
+		return rules_offset(h) + std::size_t(h.number_of_rules) * sizeof(slurp::lr_rule);
+	}
+
+	// Adds count items of size bytes to total, or returns false if that would overflow.
+	bool add_size(std::size_t& total, std::uint64_t count, std::size_t size)
+	{
+		if (count > (std::numeric_limits<std::size_t>::max() - total) / size) return false;
+		total += (std::size_t)count * size;
+		return true;
+	}
+
+	// Computes the size of the file from the counts in its header,
+	// or returns false if the counts are invalid or the size would overflow.
+	bool file_size(const slurp::table_file_header& h, std::size_t& size)
+	{
+		if (h.number_of_states <= 0 || h.number_of_terminals <= 0 || h.number_of_terminals > h.number_of_symbols ||
+			h.number_of_rules < 0 || h.kind_range < 0 || std::int64_t(h.min_kind) + h.kind_range > std::numeric_limits<int>::max())
+			return false;
+
+		// The counts are less than 2^31, so their product fits in 64 bits
+		size = actions_offset();
+		return add_size(size, std::uint64_t(h.number_of_states) * std::uint64_t(h.number_of_symbols), sizeof(slurp::lr_action)) &&
+			add_size(size, std::uint64_t(h.number_of_rules), sizeof(slurp::lr_rule)) &&
+			add_size(size, std::uint64_t(h.kind_range), sizeof(short));
+	}
+
+	/*
+		Checks that the parser cannot read outside the tables: every action and rule is in range,
+		and a reduction never pops more states than are on the stack. The fewest symbols on the stack
+		in each state are found by a breadth-first search of the shifts and gotos from state 0,
+		and the states that the search does not reach are never used.
+	*/
+	bool valid_tables(const slurp::lr_table_view& tables, const slurp::table_file_header& h)
+	{
+		using namespace slurp;
+		int states = h.number_of_states, symbols = h.number_of_symbols, terminals = h.number_of_terminals, rules = h.number_of_rules;
+
+		for (int r = 0; r < rules; ++r)
+		{
+			const lr_rule& rule = tables.rule(r);
+			if (rule.length < 0 || rule.length > Node::max_children || (!rule.node && rule.length != 1) ||
+				rule.symbol < terminals || rule.symbol >= symbols)
+				return false;
+		}
+
+		for (int k = 0; k < h.kind_range; ++k)
+			if (tables.terminals[k] >= terminals) return false;
+
+		std::vector<int> depth(states, -1), queue = { 0 };
+		depth[0] = 0;
+		for (std::size_t i = 0; i < queue.size(); ++i)
+		{
+			int s = queue[i];
+			for (int x = 0; x < symbols; ++x)
+			{
+				lr_action a = tables.action(s, x);
+				bool terminal = x < terminals;
+				switch (a.action)
+				{
+				case lr_error:
+				case lr_accept:
+					// The value of an error is read as the state of a missing goto
+					if (a.value < 0 || a.value >= states || (a.action == lr_accept && !terminal)) return false;
+					continue;
+				case lr_shift:
+				case lr_goto:
+					if (a.value < 0 || a.value >= states || terminal != (a.action == lr_shift)) return false;
+					if (depth[a.value] < 0)
+					{
+						depth[a.value] = depth[s] + 1;
+						queue.push_back(a.value);
+					}
+					continue;
+				case lr_reduce:
+					if (!terminal || a.value < 0 || a.value >= rules || tables.rule(a.value).length > depth[s]) return false;
+					continue;
+				case lr_shift_reduce:
+					if (!terminal || a.value < 0 || a.value >= rules || tables.rule(a.value).length < 1 || tables.rule(a.value).length > depth[s] + 1) return false;
+					continue;
+				default:
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+std::vector<char> slurp::table_file_image(const runtime_tables& tables)
+{
+	table_file_header h = {};
+	std::memcpy(h.magic, table_file_magic, sizeof h.magic);
+	h.version = table_file_header::current_version;
+	h.byte_order = table_file_header::byte_order_mark;
+	h.header_size = sizeof(table_file_header);
+	h.action_size = sizeof(lr_action);
+	h.rule_size = sizeof(lr_rule);
+	h.grammar_hash = tables.grammar_hash;
+	h.number_of_states = tables.number_of_states;
+	h.number_of_symbols = tables.number_of_symbols;
+	h.number_of_terminals = tables.number_of_terminals;
+	h.number_of_rules = tables.number_of_rules;
+	h.min_kind = tables.min_kind;
+	h.kind_range = (std::int32_t)tables.terminals.size();
+	h.conflicts = tables.conflicts;
+
+	std::size_t size = 0;
+	file_size(h, size);
+	std::vector<char> image(size);
+	std::memcpy(&image[0], &h, sizeof h);
+	std::memcpy(&image[actions_offset()], tables.actions.data(), tables.actions.size() * sizeof(lr_action));
+	std::memcpy(&image[rules_offset(h)], tables.rules.data(), tables.rules.size() * sizeof(lr_rule));
+	std::memcpy(&image[terminals_offset(h)], tables.terminals.data(), tables.terminals.size() * sizeof(short));
+	return image;
+}
+
+bool slurp::write_table_file(const runtime_tables& tables, const std::string& path)
+{
+	std::vector<char> image = table_file_image(tables);
+
+	// Write to a temporary file and rename it, so that other processes never see a partial file.
+#ifdef _WIN32
+	std::string temp = path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+#else
+	std::string temp = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+
+	std::FILE* file = std::fopen(temp.c_str(), "wb");
+	if (!file) return false;
+	bool ok = std::fwrite(image.data(), 1, image.size(), file) == image.size();
+	ok = std::fclose(file) == 0 && ok;
+
+#ifdef _WIN32
+	ok = ok && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+
+	if (!ok) std::remove(temp.c_str());
+	return ok;
+}
+
+slurp::mapped_tables::mapped_tables() : data(nullptr), size(0), mapping(nullptr)
+{
+}
+
+slurp::mapped_tables::mapped_tables(mapped_tables&& other) : mapped_tables()
+{
+	*this = std::move(other);
+}
+
+slurp::mapped_tables& slurp::mapped_tables::operator=(mapped_tables&& other)
+{
+	if (this != &other)
+	{
+		close();
+		data = other.data;
+		size = other.size;
+		image = std::move(other.image);
+		mapping = other.mapping;
+		other.data = nullptr;
+		other.size = 0;
+		other.mapping = nullptr;
+	}
+	return *this;
+}
+
+slurp::mapped_tables::~mapped_tables()
+{
+	close();
+}
+
+bool slurp::mapped_tables::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER length;
+	HANDLE m = GetFileSizeEx(file, &length) && length.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	CloseHandle(file);
+	if (!m) return false;
+
+	const void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(m);
+		return false;
+	}
+	mapping = m;
+	size = (std::size_t)length.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	void* view = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if (view == MAP_FAILED) return false;
+
+	mapping = view;
+	size = (std::size_t)st.st_size;
+#endif
+
+	data = (const char*)view;
+	return validate();
+}
+
+bool slurp::mapped_tables::assign(std::vector<char> tables)
+{
+	close();
+	image = std::move(tables);
+	data = image.data();
+	size = image.size();
+	return validate();
+}
+
+void slurp::mapped_tables::close()
+{
+	if (mapping)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)mapping);
+#else
+		munmap(mapping, size);
+#endif
+	}
+
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	image.clear();
+}
+
+bool slurp::mapped_tables::validate()
+{
+	std::size_t expected = 0;
+	bool valid = size >= sizeof(table_file_header);
+	if (valid)
+	{
+		const table_file_header& h = header();
+		valid = std::memcmp(h.magic, table_file_magic, sizeof h.magic) == 0 &&
+			h.version == table_file_header::current_version &&
+			h.byte_order == table_file_header::byte_order_mark &&
+			h.header_size == sizeof(table_file_header) &&
+			h.action_size == sizeof(lr_action) &&
+			h.rule_size == sizeof(lr_rule) &&
+			file_size(h, expected) && expected == size &&
+			valid_tables(view(), h);
+	}
+
+	if (!valid) close();
+	return valid;
+}
+
+slurp::mapped_tables::operator bool() const
+{
+	return data != nullptr;
+}
+
+bool slurp::mapped_tables::mapped() const
+{
+	return mapping != nullptr;
+}
+
+const slurp::table_file_header& slurp::mapped_tables::header() const
+{
+	return *(const table_file_header*)data;
+}
+
+slurp::lr_table_view slurp::mapped_tables::view() const
+{
+	const table_file_header& h = header();
+	return lr_table_view{
+		(const lr_action*)(data + actions_offset()),
+		(const lr_rule*)(data + rules_offset(h)),
+		(const short*)(data + terminals_offset(h)),
+		h.number_of_symbols, h.min_kind, h.kind_range };
+}
+
+slurp::mapped_tables slurp::load_tables(const runtime_grammar& grammar, runtime_grammar::symbol start, const std::string& path, bool* rebuilt)
+{
+	runtime_flat_grammar flat = grammar.flatten(start);
+
+	mapped_tables result;
+	bool build = !result.open(path) || result.header().grammar_hash != flat.hash();
+	if (rebuilt) *rebuilt = build;
+
+	if (build)
+	{
+		runtime_tables tables(flat);
+		if (!write_table_file(tables, path) || !result.open(path))
+			result.assign(table_file_image(tables));
+	}
+
+	return result;
+}
@@ -0,0 +1,102 @@
+/*
+	A binary file format for LR parser tables, which is memory mapped and used in place.
+
+	The file is a table_file_header, followed by the actions, rules and terminals arrays
+	of an lr_table_view. The header records the format version, the byte order and the sizes
+	of the structures (so that a file from an incompatible build is rejected), and the hash
+	of the grammar. A file is only used if every action and rule in it is in range, and no
+	reduction pops more states than the parser can have, so a corrupt file is rejected
+	instead of making the parser read outside the tables.
+
+	write_table_file(tables, path)
+
+	writes the tables to a file, and
+
+	mapped_tables tables;
+	tables.open(path)
+
+	maps a file read-only, so that processes that open the same file share one copy
+	of the tables. tables.view() can then be used with lr_parser.
+
+	load_tables(grammar, start, path)
+
+	uses the tables in the file if they were built from the same grammar, and otherwise
+	builds the tables and replaces the file.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace slurp
+{
+	struct table_file_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;  // byte_order_mark, as written by the machine that wrote the file
+		std::uint32_t header_size, action_size, rule_size;
+		std::int32_t conflicts;
+		std::uint64_t grammar_hash;
+		std::int32_t number_of_states, number_of_symbols, number_of_terminals, number_of_rules;
+		std::int32_t min_kind, kind_range;
+
+		static const std::uint32_t current_version = 2;
+		static const std::uint32_t byte_order_mark = 0x01020304;
+	};
+
+	// Serialises parser tables into the table file format.
+	std::vector<char> table_file_image(const runtime_tables& tables);
+
+	// Writes the tables to a file, atomically replacing any existing file.
+	// Returns false if the file could not be written.
+	bool write_table_file(const runtime_tables& tables, const std::string& path);
+
+	// Parser tables in the table file format, either memory mapped or held in memory.
+	class mapped_tables
+	{
+	public:
+		mapped_tables();
+		mapped_tables(mapped_tables&& other);
+		mapped_tables& operator=(mapped_tables&& other);
+		~mapped_tables();
+
+		mapped_tables(const mapped_tables&) = delete;
+		mapped_tables& operator=(const mapped_tables&) = delete;
+
+		// Maps a table file read-only.
+		// Returns false if the file could not be opened or is not a valid table file.
+		bool open(const std::string& path);
+
+		// Uses tables from memory (in the table file format).
+		bool assign(std::vector<char> image);
+
+		void close();
+
+		// true if the tables are valid.
+		operator bool() const;
+
+		// true if the tables are mapped from a file.
+		bool mapped() const;
+
+		const table_file_header& header() const;
+
+		lr_table_view view() const;
+
+	private:
+		const char* data;
+		std::size_t size;
+		std::vector<char> image;
+		void* mapping;
+
+		bool validate();
+	};
+
+	// Loads the tables for a grammar from a table file, rebuilding the file if
+	// it is missing or was built from a different grammar.
+	// If the file cannot be written, the tables are returned in memory.
+	// rebuilt (if given) is set to whether the tables were built.
+	mapped_tables load_tables(const runtime_grammar& grammar, runtime_grammar::symbol start, const std::string& path, bool* rebuilt = nullptr);
+}
@@ -10,8 +10,11 @@ namespace slurp
 		{
 		}
 
-		token_position(It stream_start, It stream_end) : tok_end(stream_start), stream_end(stream_end)
-		{ 
+		token_position(It stream_start, It stream_end) :
+			tok_start(stream_start), tok_end(stream_start), stream_start(stream_start), stream_end(stream_end), kind(-1)
+		{
+			data.offset = 0;
+			data.length = 0;
 		}
 
 		typedef typename std::iterator_traits<It>::difference_type difference_type;
@@ -23,7 +26,7 @@ namespace slurp
 
 		operator bool() const
 		{
-			return tok_start != strean_end;
+			return tok_start != stream_end;
 		}
 
 		// An iterator over the characters in the token.
@@ -43,10 +46,11 @@ namespace slurp
 		// Not all tokenizers populate this data.
 		TokenData data;
 
-		It tok_start, tok_end, stream_end;
+		It tok_start, tok_end, stream_start, stream_end;
 		
 		// The kind of the token
 		// -1 for end of stream / error
+		// lexer_error for a character that does not start a token
 		short kind;
 
 		bool operator==(const token_position<It>& other) const
@@ -61,56 +65,8 @@ namespace slurp
 	};
 
 
-
-
-	template<typename Tokens, int Symbol>
-	struct advance;
-
-	template<int Symbol>
-	struct advance<ts_empty, Symbol>
-	{
-		typedef ts_empty type;
-	};
-
-	template<int Symbol, typename H, typename...Ts>
-	struct advance<typeset<H, Ts...>, Symbol>
-	{
-		typedef typename advance<H, Symbol>::type t1;
-		typedef typename advance<typeset<Ts...>, Symbol>::type t2;
-		typedef typename ts_concat<t1, t2>::type type;
-	};
-
-	template<int Symbol, int Kind, typename T>
-	struct advance<Token<Kind, T>, Symbol>
-	{
-		typedef Token<Kind, typename advance<T, Kind>::type> type;
-	};
-
-	struct accept;
-	struct reject;
-
-	template<int C>
-	struct advance<Ch<C>, C>
-	{
-		typedef accept type;
-	};
-
-	template<int C1, int C2>
-	struct advance<Ch<C2>, C1>
-	{
-		typedef reject type;
-	};
-
-
-	template<typename It, typename Tokens>
-	void yylex(token_position<It>& it)
-	{
-		switch (*it.tok_end)
-		{
-		case 0: return yylex<It, typename advance<Tokens, 0>::type>(it);
-		}
-	}
-
+	// The kind of a token that a lexer could not match.
+	const short lexer_error = -2;
 
 	// A tokenizer that turns characters into tokens.
 	// This is used mainly for tests, or if you want the
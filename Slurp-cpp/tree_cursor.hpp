@@ -0,0 +1,174 @@
+#pragma once
+#include "Node.h"
+
+namespace slurp
+{
+	/*
+		Walks a tree without recursion, so that it works on trees of any depth,
+		such as the tree of a long input to a right-recursive grammar.
+
+		The cursor visits each node twice: when it enters the node (in preorder), and when it
+		leaves it (in postorder), after its children:
+
+			tree_cursor cursor(root);
+			while (cursor.MoveNext())
+			{
+				if (cursor.entering())
+					... // cursor.node() at cursor.depth()
+				else
+					...
+			}
+
+		SkipChildren() after entering a node prunes its subtree, so that the next step leaves the node.
+
+		The cursor keeps the path from the root, and the children of the nodes on the path that
+		have not yet been visited, in vectors that are reused when the cursor is reset, so once a
+		cursor has walked a tree it can walk trees of the same shape without allocating.
+	*/
+	class tree_cursor
+	{
+	public:
+		tree_cursor() : current(nullptr), enter(false), skip(false), started(false)
+		{
+		}
+
+		explicit tree_cursor(const Node& root) : tree_cursor()
+		{
+			reset(root);
+		}
+
+		// Starts again from root, keeping the memory of the previous walk.
+		void reset(const Node& root)
+		{
+			path.clear();
+			pending.clear();
+			path.push_back(frame{ &root, 0 });
+			current = &root;
+			enter = true;
+			skip = false;
+			started = false;
+		}
+
+		// Moves to the next node, or returns false at the end of the walk.
+		bool MoveNext()
+		{
+			if (!started)
+			{
+				started = true;
+				return current != nullptr;
+			}
+			if (path.empty()) return false;
+
+			if (enter)
+			{
+				// The last child is found first, so is pushed first
+				if (!skip && !current->IsToken())
+				{
+					const Node* c = current->FirstChild();
+					for (int i = 0; i < current->size(); ++i, c = c->NextChild())
+						pending.push_back(c);
+				}
+				skip = false;
+			}
+			else
+			{
+				path.pop_back();
+				if (path.empty())
+				{
+					current = nullptr;
+					return false;
+				}
+			}
+
+			if (pending.size() > path.back().pending)
+			{
+				current = pending.back();
+				pending.pop_back();
+				path.push_back(frame{ current, pending.size() });
+				enter = true;
+			}
+			else
+			{
+				current = path.back().node;
+				enter = false;
+			}
+			return true;
+		}
+
+		const Node& node() const { return *current; }
+
+		// Whether the cursor is entering the node, or otherwise leaving it.
+		bool entering() const { return enter; }
+
+		// The depth of the node, where the root has depth 0.
+		std::size_t depth() const { return path.size() - 1; }
+
+		// Does not visit the children of the node being entered.
+		void SkipChildren()
+		{
+			assert(enter);
+			skip = true;
+		}
+
+		// The nodes from the root to the current node.
+		std::size_t path_size() const { return path.size(); }
+		const Node& path_node(std::size_t i) const { return *path[i].node; }
+
+	private:
+		struct frame
+		{
+			const Node* node;
+			std::size_t pending;  // The size of pending when the node was entered
+		};
+
+		std::vector<frame> path;
+		std::vector<const Node*> pending;
+		const Node* current;
+		bool enter, skip, started;
+	};
+
+	enum walk_action { walk_children, skip_children, stop_walk };
+
+	/*
+		Calls enter(node, depth) on each node in preorder, which returns a walk_action,
+		and leave(node, depth) on each node in postorder, unless the walk was stopped.
+		Returns false if enter stopped the walk.
+		The cursor is reused, so that repeated walks do not allocate.
+	*/
+	template<typename Enter, typename Leave>
+	bool walk_tree(tree_cursor& cursor, const Node& root, Enter enter, Leave leave)
+	{
+		cursor.reset(root);
+		while (cursor.MoveNext())
+		{
+			if (!cursor.entering())
+				leave(cursor.node(), cursor.depth());
+			else
+				switch (enter(cursor.node(), cursor.depth()))
+				{
+				case walk_children:
+					break;
+				case skip_children:
+					cursor.SkipChildren();
+					break;
+				case stop_walk:
+					return false;
+				}
+		}
+		return true;
+	}
+
+	template<typename Enter, typename Leave>
+	bool walk_tree(const Node& root, Enter enter, Leave leave)
+	{
+		tree_cursor cursor;
+		return walk_tree(cursor, root, enter, leave);
+	}
+
+	// Calls enter(node, depth) on each node in preorder.
+	template<typename Enter>
+	bool walk_tree(const Node& root, Enter enter)
+	{
+		return walk_tree(root, enter, [](const Node&, std::size_t) {});
+	}
+}
@@ -0,0 +1,302 @@
+#include "slurp.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char tree_file_magic[8] = { 'S', 'L', 'U', 'R', 'P', 'T', 'R', 0 };
+
+	// Maps a whole file copy-on-write, or returns nullptr.
+	void* map_file(const std::string& path, std::size_t& size)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+		LARGE_INTEGER length;
+		HANDLE m = GetFileSizeEx(file, &length) && length.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+		CloseHandle(file);
+		if (!m) return nullptr;
+
+		// The view keeps the mapping open
+		void* view = MapViewOfFile(m, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(m);
+		size = (std::size_t)length.QuadPart;
+		return view;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return nullptr;
+
+		struct stat st;
+		void* view = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (view == MAP_FAILED) return nullptr;
+
+		size = (std::size_t)st.st_size;
+		return view;
+#endif
+	}
+
+	void unmap_file(void* view, std::size_t size)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap(view, size);
+#endif
+	}
+
+	// The bytes [start, finish) of a node and its subtree, which are still to be checked.
+	typedef std::pair<const char*, const char*> subtree;
+
+	// Whether the text of a token is in the input.
+	bool valid_token(const slurp::TokenData& token, std::uint64_t input_length)
+	{
+		return std::uint64_t(token.offset) + token.length <= input_length;
+	}
+
+	// Whether every node of a tree of fixed_nodes in [begin, end) is inside its parent,
+	// so that Node never reads outside the tree. Each subtree is checked once, without recursion.
+	bool valid_fixed_tree(const char* begin, const char* end, std::uint64_t input_length)
+	{
+		using slurp::Node;
+		std::vector<subtree> pending = { subtree(begin, end) };
+		while (!pending.empty())
+		{
+			const char* start = pending.back().first, * finish = pending.back().second;
+			pending.pop_back();
+
+			std::size_t length = finish - start;
+			if (length < sizeof(Node) || (finish - begin) % alignof(Node)) return false;
+			const Node& node = *((const Node*)finish - 1);
+			if (node.Length() != length) return false;
+
+			if (node.IsToken())
+			{
+				// The TokenData, then any text, which ends with a 0
+				if (length < sizeof(Node) + sizeof(slurp::TokenData)) return false;
+				std::size_t text = length - sizeof(Node) - sizeof(slurp::TokenData);
+				if (text % sizeof(wchar_t) || (text && node.WText()[text / sizeof(wchar_t) - 1] != 0)) return false;
+				if (!valid_token(*node.GetToken(), input_length)) return false;
+				continue;
+			}
+
+			// The children are before the child table, and fill the rest of the node
+			std::size_t table = node.HasChildTable() ? node.size() * sizeof(unsigned) : 0;
+			if (node.size() == 0 || table > length - sizeof(Node)) return false;
+			const unsigned* offsets = (const unsigned*)&node - node.size();
+			const char* child_end = (const char*)&node - table;
+			for (int i = node.size() - 1; i >= 0; --i)
+			{
+				if (std::size_t(child_end - start) < sizeof(Node)) return false;
+				const Node& child = *((const Node*)child_end - 1);
+				if (child.Length() < sizeof(Node) || child.Length() % alignof(Node) || child.Length() > std::size_t(child_end - start)) return false;
+				if (table && offsets[i] != std::size_t((const char*)&node - (const char*)&child)) return false;
+				pending.push_back(subtree(child_end - child.Length(), child_end));
+				child_end -= child.Length();
+			}
+			if (child_end != start) return false;
+		}
+		return true;
+	}
+
+	// Reads the varint that ends at end, as helpers::read_back_varint, without reading before begin.
+	bool read_back_varint(const char* begin, const char*& end, std::uint32_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			if (end == begin) return false;
+			unsigned char b = (unsigned char)*--end;
+			value |= std::uint32_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) return true;
+		}
+		return false;
+	}
+
+	// Reads the fields of a packed node that ends at end, as packed_node, and gets the start of its subtree,
+	// which must not be before begin.
+	bool read_packed_node(const char* begin, const char* end, std::uint32_t& tag, slurp::TokenData& token, const char*& fields, const char*& start)
+	{
+		std::uint32_t kind, length;
+		const char* p = end;
+		if (!read_back_varint(begin, p, kind) || !read_back_varint(begin, p, tag)) return false;
+		if (tag & 1)
+		{
+			if (tag != 1 || !read_back_varint(begin, p, token.length) || !read_back_varint(begin, p, token.offset)) return false;
+			fields = start = p;
+			return true;
+		}
+
+		std::uint32_t children = tag >> 2;
+		if ((tag & 3) || children == 0 || children > slurp::Node::max_children || !read_back_varint(begin, p, length)) return false;
+		if (length > std::size_t(p - begin)) return false;
+		fields = p;
+		start = p - length;
+		return true;
+	}
+
+	// Whether every node of a tree of packed_nodes in [begin, end) is inside its parent, as valid_fixed_tree.
+	bool valid_packed_tree(const char* begin, const char* end, std::uint64_t input_length)
+	{
+		std::vector<subtree> pending = { subtree(begin, end) };
+		while (!pending.empty())
+		{
+			const char* start = pending.back().first, * finish = pending.back().second, * fields, * s;
+			pending.pop_back();
+
+			std::uint32_t tag;
+			slurp::TokenData token;
+			if (!read_packed_node(start, finish, tag, token, fields, s) || s != start) return false;
+			if (tag & 1)
+			{
+				if (!valid_token(token, input_length)) return false;
+				continue;
+			}
+
+			// The children fill the node up to its fields
+			const char* child_end = fields;
+			for (std::uint32_t i = 0; i < tag >> 2; ++i)
+			{
+				std::uint32_t child_tag;
+				const char* child_fields, * child_start;
+				if (!read_packed_node(start, child_end, child_tag, token, child_fields, child_start)) return false;
+				pending.push_back(subtree(child_start, child_end));
+				child_end = child_start;
+			}
+			if (child_end != start) return false;
+		}
+		return true;
+	}
+}
+
+std::uint64_t slurp::content_hash(const void* data, std::size_t length)
+{
+	// FNV-1a over 8-byte words, with the tail and the length mixed in at the end
+	const unsigned char* p = (const unsigned char*)data;
+	std::uint64_t hash = 0xcbf29ce484222325ull;
+	for (; length >= 8; p += 8, length -= 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, p, 8);
+		hash = (hash ^ word) * 0x100000001b3ull;
+		hash ^= hash >> 29;
+	}
+
+	std::uint64_t tail = 0;
+	if (length) std::memcpy(&tail, p, length);
+	hash = (hash ^ tail) * 0x100000001b3ull;
+	hash = (hash ^ length) * 0x100000001b3ull;
+	return hash ^ (hash >> 32);
+}
+
+bool slurp::write_tree_file(const parse_result& result, const std::string& path, std::uint64_t grammar_fingerprint, std::uint64_t input_hash, std::uint64_t input_length)
+{
+	if (!result) return false;
+	const Stack& tree = result.tree();
+
+	tree_file_header h = {};
+	std::memcpy(h.magic, tree_file_magic, sizeof h.magic);
+	h.version = tree_file_header::current_version;
+	h.byte_order = tree_file_header::byte_order_mark;
+	h.header_size = sizeof(tree_file_header);
+	h.node_size = sizeof(Node);
+	h.token_size = sizeof(TokenData);
+	h.text_size = sizeof(wchar_t);
+	h.text = tree.text_mode();
+	h.child_table = tree.get_options().child_table;
+	h.encoding = tree.get_options().encoding;
+	h.grammar_fingerprint = grammar_fingerprint;
+	h.input_hash = input_hash;
+	h.input_length = input_length;
+	h.tree_size = tree.Top();
+
+	// Write to a temporary file and rename it, as write_table_file.
+#ifdef _WIN32
+	std::string temp = path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+#else
+	std::string temp = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+
+	std::FILE* file = std::fopen(temp.c_str(), "wb");
+	if (!file) return false;
+	bool ok = std::fwrite(&h, sizeof h, 1, file) == 1 &&
+		std::fwrite(tree.Data(), 1, tree.Top(), file) == tree.Top();
+	ok = std::fclose(file) == 0 && ok;
+
+#ifdef _WIN32
+	ok = ok && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+
+	if (!ok) std::remove(temp.c_str());
+	return ok;
+}
+
+slurp::parse_result slurp::open_tree_file(const std::string& path, std::uint64_t grammar_fingerprint, std::uint64_t input_hash, std::uint64_t input_length)
+{
+	std::size_t size = 0;
+	void* view = map_file(path, size);
+	if (!view) return parse_result();
+
+	const tree_file_header& h = *(const tree_file_header*)view;
+	bool valid = size >= sizeof(tree_file_header) &&
+		std::memcmp(h.magic, tree_file_magic, sizeof h.magic) == 0 &&
+		h.version == tree_file_header::current_version &&
+		h.byte_order == tree_file_header::byte_order_mark &&
+		h.header_size == sizeof(tree_file_header) &&
+		h.node_size == sizeof(Node) &&
+		h.token_size == sizeof(TokenData) &&
+		h.text_size == sizeof(wchar_t) &&
+		(h.text == copy_text || h.text == reference_text) &&
+		h.child_table <= 1 &&
+		(h.encoding == fixed_nodes || (h.encoding == packed_nodes && h.text == reference_text && !h.child_table)) &&
+		h.grammar_fingerprint == grammar_fingerprint &&
+		h.input_hash == input_hash &&
+		h.input_length == input_length &&
+		h.tree_size >= (h.encoding == fixed_nodes ? sizeof(Node) : 1) &&
+		h.tree_size == size - sizeof(tree_file_header);
+
+	// Walking the tree must stay inside the file
+	const char* end = (const char*)view + size;
+	if (valid && h.encoding == fixed_nodes)
+		valid = valid_fixed_tree(end - h.tree_size, end, input_length);
+	else if (valid)
+		valid = valid_packed_tree(end - h.tree_size, end, input_length);
+
+	if (!valid)
+	{
+		unmap_file(view, size);
+		return parse_result();
+	}
+
+	stack_options options((token_text)h.text);
+	options.child_table = h.child_table;
+	options.encoding = (node_encoding)h.encoding;
+	return parse_result(Stack(stack_buffer(view, size, sizeof(tree_file_header), (std::size_t)h.tree_size), options));
+}
+
+slurp::tree_cache::tree_cache(const std::string& directory, std::uint64_t grammar_fingerprint) :
+	directory(directory), fingerprint(grammar_fingerprint)
+{
+}
+
+std::string slurp::tree_cache::path(std::uint64_t input_hash) const
+{
+	char name[32];
+	std::snprintf(name, sizeof name, "%016llx.tree", (unsigned long long)input_hash);
+	return directory + "/" + name;
+}
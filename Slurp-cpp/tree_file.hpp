@@ -0,0 +1,119 @@
+/*
+	A file format for parse trees, which is memory mapped and used in place.
+
+	The nodes in a Stack only refer to each other by relative offsets, so the bytes of a
+	Stack can be written to a file and mapped again without deserialising them.
+	The file is a tree_file_header, followed by the bytes of the Stack. The header records
+	the format version, the byte order and the sizes of the structures in the tree (so that
+	a file from an incompatible build is rejected), the stack_options that the tree was
+	built with, a fingerprint of the grammar, and the hash and length of the input.
+
+	write_tree_file(result, path, fingerprint, input_hash, input_length)
+
+	writes the tree of a successful parse to a file, and
+
+	open_tree_file(path, fingerprint, input_hash, input_length)
+
+	maps a file as a parse_result, which fails if the file is missing or invalid, or is from
+	a different grammar or input. Before it is used, every node is checked to be inside its
+	parent and every token to be inside the input, so a corrupt file cannot make a walk of the
+	tree read outside it. The file is mapped copy-on-write, so the tree can still be modified.
+
+	tree_cache cache(directory, fingerprint);
+	parse_result result = cache.parse(input, length, [&] { return parser.parse(...); });
+
+	uses the tree file for the hash of the input if there is one, and otherwise parses the
+	input and writes the tree file for next time. The hash is a fast 64-bit hash, not a
+	cryptographic one, so it is easy to make two inputs of the same length with the same hash.
+	Only use a tree_cache for trusted inputs, since the tree of one input would be returned
+	for the other.
+
+	A tree with reference_text tokens still needs the input for the token text.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace slurp
+{
+	struct tree_file_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;  // byte_order_mark, as written by the machine that wrote the file
+		std::uint32_t header_size, node_size, token_size, text_size;
+		std::uint32_t text;  // The token_text of the Stack
+		std::uint32_t child_table;  // Whether the Stack has child tables
+		std::uint32_t encoding;  // The node_encoding of the Stack
+		std::uint32_t reserved;  // 0
+		std::uint64_t grammar_fingerprint;
+		std::uint64_t input_hash, input_length;
+		std::uint64_t tree_size;  // The number of bytes of the Stack after the header
+
+		static const std::uint32_t current_version = 3;
+		static const std::uint32_t byte_order_mark = 0x01020304;
+	};
+
+	// A fast (not cryptographic) hash of the contents of an input.
+	std::uint64_t content_hash(const void* data, std::size_t length);
+
+	// A fingerprint of compile-time parser tables (such as lalr_tables), which changes
+	// if the grammar changes the shape of the tree.
+	template<typename Tables>
+	std::uint64_t tables_fingerprint()
+	{
+		std::vector<std::int32_t> values = { Tables::number_of_symbols, Tables::number_of_rules };
+		for (int r = 0; r < Tables::number_of_rules; ++r)
+		{
+			const lr_rule& rule = Tables::rule(r);
+			values.insert(values.end(), { rule.length, rule.symbol, rule.kind, rule.node });
+		}
+		return content_hash(values.data(), values.size() * sizeof(std::int32_t));
+	}
+
+	// Writes the tree of a successful parse to a file, atomically replacing any existing file.
+	// Returns false if the parse failed, or the file could not be written.
+	bool write_tree_file(const parse_result& result, const std::string& path, std::uint64_t grammar_fingerprint, std::uint64_t input_hash, std::uint64_t input_length);
+
+	// Maps a tree file copy-on-write, as a Stack with the options that it was written with.
+	// Returns a failed parse_result if the file could not be opened, is not a valid tree file,
+	// or has a different grammar_fingerprint, input_hash or input_length.
+	parse_result open_tree_file(const std::string& path, std::uint64_t grammar_fingerprint, std::uint64_t input_hash, std::uint64_t input_length);
+
+	// A directory of tree files, named by the hash of their input.
+	class tree_cache
+	{
+	public:
+		// The directory must exist.
+		tree_cache(const std::string& directory, std::uint64_t grammar_fingerprint);
+
+		// Gets the tree of the input from the cache, or otherwise calls parse() and
+		// caches the result if it succeeds. The input must be trusted (see above).
+		// hit (if given) is set to whether the tree was in the cache.
+		template<typename Parse>
+		parse_result parse(const void* input, std::size_t length, Parse parse, bool* hit = nullptr) const
+		{
+			std::uint64_t hash = content_hash(input, length);
+			std::string file = path(hash);
+			parse_result result = open_tree_file(file, fingerprint, hash, length);
+			if (hit) *hit = bool(result);
+
+			if (!result)
+			{
+				result = parse();
+				if (result) write_tree_file(result, file, fingerprint, hash, length);
+			}
+			return result;
+		}
+
+		// The file of the tree of an input with the given hash.
+		std::string path(std::uint64_t input_hash) const;
+
+	private:
+		std::string directory;
+		std::uint64_t fingerprint;
+	};
+}
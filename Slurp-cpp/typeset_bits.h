@@ -0,0 +1,351 @@
+/*
+A bitset-backed representation of type sets.
+
+Each type in a "universe" (a typeset<> of all of the types that could
+appear in the set) is given an ordinal - its position in the universe.
+A set is then represented as a sequence of 64-bit words:
+
+ts_bits<Universe, Words...>
+
+Converting to and from the list representation:
+
+ts_to_bits<Universe, Ts>::type
+ts_from_bits<Bits>::type
+
+The ordinal of a type in a universe (-1 if it is not present):
+
+ts_index<T, Universe>::value
+
+ts_insert, ts_contains, ts_union, ts_subset, ts_equal, ts_size, ts_where
+and ts_except all work on ts_bits, and are O(1) or O(words) rather than
+linear or quadratic in the size of the set.
+
+The same bits are available at runtime (and in constant expressions) as bitset<N>.
+*/
+
+#pragma once
+
+#include <utility>
+#include "typeset.h"
+
+namespace slurp
+{
+	// A fixed-size set of bits that can be used in constant expressions.
+	template<int N>
+	struct bitset
+	{
+		typedef unsigned long long word_type;
+
+		static const int size = N;
+		static const int number_of_words = N > 0 ? (N + 63) / 64 : 1;
+
+		word_type words[number_of_words];
+
+		constexpr bitset() : words{} {}
+
+		constexpr bool contains(int i) const
+		{
+			return (words[i / 64] >> (i % 64)) & 1;
+		}
+
+		constexpr void insert(int i)
+		{
+			words[i / 64] |= word_type(1) << (i % 64);
+		}
+
+		constexpr void erase(int i)
+		{
+			words[i / 64] &= ~(word_type(1) << (i % 64));
+		}
+
+		// Adds all of the bits in other to this set.
+		// Returns true if this set changed.
+		constexpr bool insert_all(const bitset& other)
+		{
+			bool changed = false;
+			for (int w = 0; w < number_of_words; ++w)
+			{
+				word_type next = words[w] | other.words[w];
+				changed = changed || next != words[w];
+				words[w] = next;
+			}
+			return changed;
+		}
+
+		constexpr bool subset(const bitset& other) const
+		{
+			for (int w = 0; w < number_of_words; ++w)
+				if (words[w] & ~other.words[w]) return false;
+			return true;
+		}
+
+		constexpr bool empty() const
+		{
+			for (int w = 0; w < number_of_words; ++w)
+				if (words[w]) return false;
+			return true;
+		}
+
+		constexpr int count() const
+		{
+			int result = 0;
+			for (int w = 0; w < number_of_words; ++w)
+				for (word_type b = words[w]; b; b &= b - 1)
+					++result;
+			return result;
+		}
+
+		constexpr bool operator==(const bitset& other) const
+		{
+			for (int w = 0; w < number_of_words; ++w)
+				if (words[w] != other.words[w]) return false;
+			return true;
+		}
+
+		constexpr bool operator!=(const bitset& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	template<typename Universe, unsigned long long... Words>
+	class ts_bits {};
+
+	namespace helpers
+	{
+		template<typename T, typename... Ts>
+		constexpr int index_of()
+		{
+			const bool matches[] = { false, std::is_same<T, Ts>::value... };
+			for (int i = 1; i <= (int)sizeof...(Ts); ++i)
+				if (matches[i]) return i - 1;
+			return -1;
+		}
+
+		constexpr int number_of_words(int bits)
+		{
+			return bits > 0 ? (bits + 63) / 64 : 1;
+		}
+
+		constexpr unsigned long long bit_in_word(int word, int index)
+		{
+			return index >= 0 && index / 64 == word ? 1ull << (index % 64) : 0;
+		}
+
+		template<unsigned long long... Words>
+		constexpr bool test_bit(int index)
+		{
+			const unsigned long long words[] = { 0, Words... };
+			return index >= 0 && index / 64 < (int)sizeof...(Words) && ((words[1 + index / 64] >> (index % 64)) & 1);
+		}
+
+		template<unsigned long long... Words>
+		constexpr int popcount()
+		{
+			const unsigned long long words[] = { 0, Words... };
+			int result = 0;
+			for (unsigned long long w : words)
+				for (; w; w &= w - 1)
+					++result;
+			return result;
+		}
+
+		template<unsigned long long... Words>
+		constexpr bool all_zero()
+		{
+			const bool zero[] = { true, (Words == 0)... };
+			for (bool z : zero)
+				if (!z) return false;
+			return true;
+		}
+
+		// A word of the set of indexes given in Indexes.
+		template<int... Indexes>
+		constexpr unsigned long long word_of(int word)
+		{
+			const int indexes[] = { -1, Indexes... };
+			unsigned long long result = 0;
+			for (int i : indexes)
+				result |= bit_in_word(word, i);
+			return result;
+		}
+
+		template<typename Bits, typename T, typename Sequence>
+		struct ts_insert_bits;
+
+		template<typename Universe, unsigned long long... Words, int Index, std::size_t... W>
+		struct ts_insert_bits<ts_bits<Universe, Words...>, std::integral_constant<int, Index>, std::index_sequence<W...>>
+		{
+			typedef ts_bits<Universe, (Words | bit_in_word(W, Index))...> type;
+		};
+
+		// The word W of the elements of Universe (with bits Words) that satisfy Predicate (or do not satisfy it if Except).
+		template<typename Universe, typename Predicate, bool Except>
+		struct ts_where_bits;
+
+		template<typename... Ts, typename Predicate, bool Except>
+		struct ts_where_bits<typeset<Ts...>, Predicate, Except>
+		{
+			template<unsigned long long... Words>
+			static constexpr unsigned long long word(int w)
+			{
+				const bool keep[] = { false, Predicate::template predicate<Ts>::value... };
+				unsigned long long result = 0;
+				for (int i = w * 64; i < (int)sizeof...(Ts) && i < w * 64 + 64; ++i)
+					if (keep[i + 1] != Except && test_bit<Words...>(i))
+						result |= 1ull << (i % 64);
+				return result;
+			}
+		};
+
+		template<typename Bits, typename Predicate, bool Except, typename Sequence>
+		struct ts_filter_bits;
+
+		template<typename Universe, unsigned long long... Words, typename Predicate, bool Except, std::size_t... W>
+		struct ts_filter_bits<ts_bits<Universe, Words...>, Predicate, Except, std::index_sequence<W...>>
+		{
+			typedef ts_bits<Universe, ts_where_bits<Universe, Predicate, Except>::template word<Words...>(W)...> type;
+		};
+
+		template<typename Bits>
+		struct in_bits
+		{
+			template<typename T>
+			struct predicate
+			{
+				static const bool value = ts_contains<T, Bits>::value;
+			};
+		};
+	}
+
+	// The ordinal of T in Universe, or -1 if T is not in Universe.
+	template<typename T, typename Universe>
+	struct ts_index;
+
+	template<typename T, typename... Ts>
+	struct ts_index<T, typeset<Ts...>>
+	{
+		static const int value = helpers::index_of<T, Ts...>();
+	};
+
+	// Converts a typeset<> into a ts_bits<> over the given universe.
+	template<typename Universe, typename Ts>
+	struct ts_to_bits;
+
+	template<typename... Us, typename... Ts>
+	struct ts_to_bits<typeset<Us...>, typeset<Ts...>>
+	{
+		static_assert(helpers::all_zero<(ts_index<Ts, typeset<Us...>>::value < 0)...>(), "Type is not in the universe of the typeset");
+
+		template<std::size_t... W>
+		static ts_bits<typeset<Us...>, helpers::word_of<ts_index<Ts, typeset<Us...>>::value...>(W)...> make(std::index_sequence<W...>);
+
+		typedef decltype(make(std::make_index_sequence<helpers::number_of_words(sizeof...(Us))>())) type;
+	};
+
+	template<typename Universe, typename Universe2, unsigned long long... Words>
+	struct ts_to_bits<Universe, ts_bits<Universe2, Words...>>
+	{
+		static_assert(std::is_same<Universe, Universe2>::value, "Typesets have different universes");
+		typedef ts_bits<Universe, Words...> type;
+	};
+
+	// Converts a ts_bits<> into a typeset<>, in the order of the universe.
+	template<typename Bits>
+	struct ts_from_bits;
+
+	template<typename Universe, unsigned long long... Words>
+	struct ts_from_bits<ts_bits<Universe, Words...>>
+	{
+		typedef typename ts_where<Universe, helpers::in_bits<ts_bits<Universe, Words...>>>::type type;
+	};
+
+	// The bitset<> value of a ts_bits<>.
+	template<typename Bits>
+	struct ts_bitset;
+
+	template<typename... Us, unsigned long long... Words>
+	struct ts_bitset<ts_bits<typeset<Us...>, Words...>>
+	{
+		typedef bitset<sizeof...(Us)> type;
+
+		static constexpr type value()
+		{
+			type result;
+			const unsigned long long words[] = { Words... };
+			for (int w = 0; w < type::number_of_words; ++w)
+				result.words[w] = words[w];
+			return result;
+		}
+	};
+
+	template<typename T, typename Universe, unsigned long long... Words>
+	struct ts_insert<T, ts_bits<Universe, Words...>>
+	{
+		static_assert(ts_index<T, Universe>::value >= 0, "Type is not in the universe of the typeset");
+
+		typedef typename helpers::ts_insert_bits<ts_bits<Universe, Words...>,
+			std::integral_constant<int, ts_index<T, Universe>::value>,
+			std::make_index_sequence<sizeof...(Words)>>::type type;
+	};
+
+	template<typename T, typename Universe, unsigned long long... Words>
+	struct ts_contains<T, ts_bits<Universe, Words...>>
+	{
+		static const bool value = helpers::test_bit<Words...>(ts_index<T, Universe>::value);
+	};
+
+	template<typename Universe, unsigned long long... Words1, unsigned long long... Words2>
+	struct ts_union<ts_bits<Universe, Words1...>, ts_bits<Universe, Words2...>>
+	{
+		typedef ts_bits<Universe, (Words1 | Words2)...> type;
+	};
+
+	template<typename Universe, unsigned long long... Words, typename... Ts>
+	struct ts_union<ts_bits<Universe, Words...>, typeset<Ts...>>
+	{
+		typedef typename ts_union<typeset<Ts...>, ts_bits<Universe, Words...>>::type type;
+	};
+
+	template<typename Universe, unsigned long long... Words1, unsigned long long... Words2>
+	struct ts_subset<ts_bits<Universe, Words1...>, ts_bits<Universe, Words2...>>
+	{
+		static const bool value = helpers::all_zero<(Words1 & ~Words2)...>();
+	};
+
+	template<typename Universe, unsigned long long... Words, typename Ts2>
+	struct ts_subset<ts_bits<Universe, Words...>, Ts2>
+	{
+		static const bool value = ts_subset<typename ts_from_bits<ts_bits<Universe, Words...>>::type, Ts2>::value;
+	};
+
+	template<typename Universe, unsigned long long... Words1, unsigned long long... Words2>
+	struct ts_equal<ts_bits<Universe, Words1...>, ts_bits<Universe, Words2...>>
+	{
+		static const bool value = helpers::all_zero<(Words1 ^ Words2)...>();
+	};
+
+	template<typename Universe, unsigned long long... Words>
+	struct ts_size<ts_bits<Universe, Words...>>
+	{
+		static const int value = helpers::popcount<Words...>();
+	};
+
+	template<typename Universe, unsigned long long... Words, typename Predicate>
+	struct ts_where<ts_bits<Universe, Words...>, Predicate>
+	{
+		typedef typename helpers::ts_filter_bits<ts_bits<Universe, Words...>, Predicate, false,
+			std::make_index_sequence<sizeof...(Words)>>::type type;
+	};
+
+	template<typename Universe, unsigned long long... Words, typename Predicate>
+	struct ts_except<ts_bits<Universe, Words...>, Predicate>
+	{
+		typedef typename helpers::ts_filter_bits<ts_bits<Universe, Words...>, Predicate, true,
+			std::make_index_sequence<sizeof...(Words)>>::type type;
+	};
+
+	// The empty set over a universe.
+	template<typename Universe>
+	using ts_bits_empty = typename ts_to_bits<Universe, ts_empty>::type;
+}
@@ -1,4 +1,5 @@
 #include "typeset.h"
+#include "typeset_bits.h"
 
 using namespace slurp;
 
@@ -23,3 +24,78 @@ namespace
 typedef ts_insert<int, ts_empty>::type i;
 typedef ts_insert<int, i>::type i;
 
+
+// Bitset representation
+namespace
+{
+	typedef typeset<int, float, char, double> universe;
+	typedef ts_bits_empty<universe> bs_empty;
+	typedef ts_to_bits<universe, ts1>::type bs1;
+	typedef ts_to_bits<universe, ts2>::type bs2;
+	typedef ts_to_bits<universe, typeset<char>>::type bs3;
+
+	static_assert(ts_index<float, universe>::value == 1, "");
+	static_assert(ts_index<long, universe>::value == -1, "");
+
+	static_assert(ts_size<bs_empty>::value == 0, "");
+	static_assert(!ts_contains<int, bs_empty>::value, "");
+	static_assert(ts_contains<int, ts_insert<int, bs_empty>::type>::value, "");
+	static_assert(!ts_contains<long, bs1>::value, "");
+	static_assert(std::is_same<bs1, bs2>::value, "");
+	static_assert(std::is_same<ts_insert<int, bs1>::type, bs1>::value, "");
+
+	typedef ts_union<bs1, bs3>::type bs4;
+	static_assert(ts_size<bs4>::value == 3, "");
+	static_assert(ts_contains<char, bs4>::value, "");
+	static_assert(!ts_contains<double, bs4>::value, "");
+	static_assert(ts_subset<bs1, bs4>::value, "");
+	static_assert(!ts_subset<bs4, bs1>::value, "");
+	static_assert(ts_equal<bs1, bs1>::value, "");
+	static_assert(!ts_equal<bs1, bs4>::value, "");
+	static_assert(ts_equal<bs4, ts_union<bs3, bs1>::type>::value, "");
+	static_assert(!ts_equal<bs_empty, bs3>::value, "");
+
+	// Mixing representations
+	static_assert(ts_equal<bs1, ts2>::value, "");
+	static_assert(ts_equal<ts2, bs1>::value, "");
+	static_assert(ts_subset<ts_empty, bs1>::value, "");
+	static_assert(std::is_same<ts_union<typeset<char>, bs1>::type, bs4>::value, "");
+	static_assert(std::is_same<ts_union<bs1, typeset<char>>::type, bs4>::value, "");
+	static_assert(std::is_same<ts_from_bits<bs4>::type, typeset<int, float, char>>::value, "");
+
+	struct is_integral
+	{
+		template<typename T>
+		struct predicate
+		{
+			static const bool value = std::is_integral<T>::value;
+		};
+	};
+
+	static_assert(std::is_same<ts_where<bs4, is_integral>::type, ts_to_bits<universe, typeset<int, char>>::type>::value, "");
+	static_assert(std::is_same<ts_except<bs4, is_integral>::type, ts_to_bits<universe, typeset<float>>::type>::value, "");
+
+	static_assert(ts_bitset<bs4>::value().count() == 3, "");
+	static_assert(ts_bitset<bs4>::value().contains(2), "");
+	static_assert(!ts_bitset<bs4>::value().contains(3), "");
+
+	// A universe spanning more than one word
+	template<int N> struct sym {};
+
+	template<typename Sequence>
+	struct make_universe;
+
+	template<std::size_t... N>
+	struct make_universe<std::index_sequence<N...>>
+	{
+		typedef typeset<sym<N>...> type;
+	};
+
+	typedef make_universe<std::make_index_sequence<150>>::type large_universe;
+	typedef ts_to_bits<large_universe, typeset<sym<0>, sym<63>, sym<64>, sym<149>>>::type large1;
+	static_assert(ts_size<large1>::value == 4, "");
+	static_assert(ts_contains<sym<64>, large1>::value, "");
+	static_assert(ts_contains<sym<149>, large1>::value, "");
+	static_assert(!ts_contains<sym<65>, large1>::value, "");
+	static_assert(ts_contains<sym<100>, ts_insert<sym<100>, large1>::type>::value, "");
+}